@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "commands.hxx"
+#include "pgn.hxx"
+#include "search.hxx"
+
+namespace cli {
+namespace {
+// mates are turned into centipawns beyond anything the evaluation reaches so that scores stay comparable
+constexpr int MATE_SCORE = 10000;
+// a move that leaves the mover this far ahead is not marked, whatever it threw away
+constexpr int DECISIVE_SCORE = 500;
+constexpr size_t GAMES_PER_THREAD = 16;
+
+struct Counters
+{
+    std::atomic<uint64_t> games{0};
+    std::atomic<uint64_t> plies{0};
+    std::atomic<uint64_t> nodes{0};
+};
+
+// evaluation of a position from white's point of view
+struct Eval
+{
+    int cp{0};
+    bool is_mate{false};
+    int mate{0}; // moves to mate, negative when black mates, 0 once the game is over
+};
+
+Eval evaluate(engine::Search &search, db::Board &board, const engine::SearchLimits &limits, Counters &counters)
+{
+    static const std::atomic<bool> stop{false};
+    const int sign = board.get_position().stm == db::WHITE ? 1 : -1;
+    Eval eval;
+    // finished games are scored directly, the search has nothing to report for them
+    if (board.generate_moves().empty()) {
+        eval.is_mate = board.is_check();
+        eval.cp = eval.is_mate ? -sign * MATE_SCORE : 0;
+        return eval;
+    }
+    // with the game so far, so that the search sees repetitions of earlier positions
+    search.set_position(board.get_position(), board.history());
+    engine::SearchInfo info = search.go(limits, stop);
+    counters.nodes.fetch_add(info.nodes, std::memory_order_relaxed);
+    eval.is_mate = info.is_mate;
+    if (info.is_mate) {
+        eval.mate = sign * info.score;
+        eval.cp = eval.mate > 0 ? MATE_SCORE - eval.mate : -MATE_SCORE - eval.mate;
+    } else {
+        eval.cp = std::clamp(sign * info.score, -MATE_SCORE + 1000, MATE_SCORE - 1000);
+    }
+    return eval;
+}
+
+std::string eval_comment(const Eval &eval)
+{
+    if (eval.is_mate)
+        return eval.mate == 0 ? std::string() : "[%eval #" + std::to_string(eval.mate) + "]";
+    char text[32];
+    std::snprintf(text, sizeof(text), "[%%eval %.2f]", eval.cp / 100.0);
+    return text;
+}
+
+uint8_t mistake_nag(int loss, int score_after)
+{
+    if (score_after >= DECISIVE_SCORE)
+        return 0;
+    if (loss >= 300)
+        return 4; // ??
+    if (loss >= 100)
+        return 2; // ?
+    if (loss >= 50)
+        return 6; // ?!
+    return 0;
+}
+
+void annotate_game(db::PgnGame &pgn, engine::Search &search, const engine::SearchLimits &limits, Counters &counters)
+{
+    db::Game &game = pgn.game;
+    db::Board board;
+    board.set_fen(game.start_fen());
+
+    std::vector<std::pair<db::MoveId, db::Move>> mainline;
+    for (auto node = game.get_moves().begin() + 1; node != game.get_moves().end(); ++node) {
+        if (node->variation_level == 0)
+            mainline.emplace_back(node->move_id, node->move);
+    }
+
+    Eval before = evaluate(search, board, limits, counters);
+    for (const auto &[id, move] : mainline) {
+        // a forced move is never a mistake, only the search depth changed between the two positions
+        const bool forced = board.generate_moves().size() == 1;
+        board.do_move(move);
+        Eval after = evaluate(search, board, limits, counters);
+        counters.plies.fetch_add(1, std::memory_order_relaxed);
+
+        const int sign = move.color == db::WHITE ? 1 : -1;
+        const size_t node_index = game.find_move(id);
+        const db::MoveNode &node = game.get_moves()[node_index];
+        if (node.nags.empty() && !forced) {
+            if (uint8_t nag = mistake_nag(sign * (before.cp - after.cp), sign * after.cp))
+                game.add_nag(id, nag);
+        }
+        std::string comment = eval_comment(after);
+        if (!node.comment.empty())
+            comment = comment.empty() ? node.comment : comment + " " + node.comment;
+        game.set_comment(id, std::move(comment));
+        before = after;
+    }
+    counters.games.fetch_add(1, std::memory_order_relaxed);
+}
+
+void report(const Counters &counters, std::chrono::steady_clock::time_point start, bool final)
+{
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    seconds = std::max(seconds, 1e-3);
+    const uint64_t plies = counters.plies.load(std::memory_order_relaxed);
+    const uint64_t nodes = counters.nodes.load(std::memory_order_relaxed);
+    std::fprintf(stderr, "\rgames %llu  plies %llu  %.0f plies/s  %.0f knps  %.0fs%s",
+                 (unsigned long long)counters.games.load(std::memory_order_relaxed), (unsigned long long)plies,
+                 plies / seconds, nodes / seconds / 1000, seconds, final ? "\n" : "");
+}
+} // namespace
+
+int annotate(const Options &options)
+{
+    if (options.positional().size() != 2)
+        throw std::invalid_argument("expected an input and an output file");
+
+    engine::SearchLimits limits;
+    limits.nodes = uint64_t(options.integer("nodes", 0));
+    limits.depth = int(options.integer("depth", limits.nodes ? engine::MAX_PLY : 8));
+    const size_t threads =
+        size_t(std::max<int64_t>(1, options.integer("threads", std::max(1u, std::thread::hardware_concurrency()))));
+    const size_t hash_mb = size_t(std::max<int64_t>(1, options.integer("hash", 64)));
+    engine::TranspositionTable tt(hash_mb, options.has("huge-pages"));
+
+    std::ifstream in_file;
+    std::ofstream out_file;
+    const std::string in_path = options.positional(0, "-");
+    const std::string out_path = options.positional(1, "-");
+    if (in_path != "-") {
+        in_file.open(in_path);
+        if (!in_file)
+            throw std::runtime_error("cannot open " + in_path);
+    }
+    if (out_path != "-") {
+        out_file.open(out_path);
+        if (!out_file)
+            throw std::runtime_error("cannot open " + out_path);
+    }
+    std::istream &in = in_path == "-" ? std::cin : in_file;
+    std::ostream &out = out_path == "-" ? std::cout : out_file;
+
+    std::unique_ptr<engine::nnue::Network> network;
+    if (options.has("nnue"))
+        network = engine::nnue::Network::load(options.value("nnue"));
+    engine::tb::Tablebases tablebases;
+    if (options.has("tb") && tablebases.add_directory(options.value("tb")) == 0)
+        throw std::runtime_error("no tables in " + options.value("tb"));
+
+    std::vector<std::unique_ptr<engine::Search>> searches;
+    for (size_t i = 0; i < threads; ++i) {
+        searches.push_back(std::make_unique<engine::Search>());
+        searches.back()->set_transposition_table(&tt);
+        searches.back()->set_network(network.get());
+        searches.back()->set_tablebases(&tablebases);
+    }
+
+    Counters counters;
+    const auto start = std::chrono::steady_clock::now();
+    std::mutex progress_mutex;
+    std::condition_variable progress_cv;
+    bool done = false;
+    std::thread progress([&] {
+        std::unique_lock lock(progress_mutex);
+        while (!progress_cv.wait_for(lock, std::chrono::seconds(1), [&] { return done; }))
+            report(counters, start, false);
+    });
+
+    // games are the unit of parallel work: every worker annotates whole games with its own board and search while
+    // the transposition table is shared. Batches are written back in input order.
+    db::PgnReader reader(in);
+    std::vector<db::PgnGame> batch(threads * GAMES_PER_THREAD);
+    for (;;) {
+        size_t count = 0;
+        while (count < batch.size() && reader.read(batch[count]))
+            ++count;
+        if (count == 0)
+            break;
+
+        tt.new_search();
+        std::atomic<size_t> next{0};
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < std::min(threads, count); ++t) {
+            workers.emplace_back([&, t] {
+                for (size_t i = next++; i < count; i = next++)
+                    annotate_game(batch[i], *searches[t], limits, counters);
+            });
+        }
+        for (auto &worker : workers)
+            worker.join();
+        for (size_t i = 0; i < count; ++i)
+            db::write_pgn(out, batch[i]);
+        out.flush();
+    }
+
+    {
+        std::lock_guard lock(progress_mutex);
+        done = true;
+    }
+    progress_cv.notify_one();
+    progress.join();
+    report(counters, start, true);
+    if (reader.skipped())
+        std::cerr << reader.skipped() << " unreadable games skipped\n";
+    return 0;
+}
+
+} // namespace cli
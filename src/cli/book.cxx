@@ -0,0 +1,106 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "book.hxx"
+#include "commands.hxx"
+#include "pgn.hxx"
+
+namespace cli {
+namespace {
+// --keys, or the Random64 table next to the book
+db::polyglot::Keys keys_option(const Options &options, const std::string &book_path)
+{
+    if (!options.has("keys"))
+        return db::polyglot::default_keys(book_path);
+    const std::optional<db::polyglot::Keys> keys = db::polyglot::load_keys(options.value("keys"));
+    if (!keys)
+        throw std::invalid_argument(options.value("keys") + " does not hold 781 hexadecimal keys");
+    if (!db::polyglot::is_random64(*keys))
+        std::fprintf(stderr, "warning: %s is not the Polyglot Random64 table (the start position does not hash to "
+                     "%016llx), other programs cannot read books built with it\n",
+                     options.value("keys").c_str(), (unsigned long long)db::polyglot::START_KEY);
+    return *keys;
+}
+} // namespace
+
+int book_build(const Options &options)
+{
+    if (!options.has("out") || options.positional().empty())
+        throw std::invalid_argument("expected an output file and the PGN files to read");
+    const size_t plies = size_t(std::max<int64_t>(1, options.integer("plies", 40)));
+    const uint32_t min_games = uint32_t(std::max<int64_t>(1, options.integer("min-games", 1)));
+
+    const auto start = std::chrono::steady_clock::now();
+    db::polyglot::BookBuilder builder(keys_option(options, options.value("out")));
+    size_t games = 0, skipped = 0;
+    for (const auto &path : options.positional()) {
+        std::ifstream file;
+        if (path != "-") {
+            file.open(path);
+            if (!file)
+                throw std::runtime_error("cannot open " + path);
+        }
+        db::PgnReader reader(path == "-" ? std::cin : file);
+        for (db::PgnGame game; reader.read(game); ++games)
+            builder.add_game(game, plies);
+        skipped += reader.skipped();
+    }
+    const size_t entries = builder.write(options.value("out"), min_games);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%zu games (%zu unreadable skipped), %zu positions, %zu entries written in %.1f s\n", games, skipped,
+                builder.positions(), entries, seconds);
+    return 0;
+}
+
+int book_probe(const Options &options)
+{
+    if (!options.has("book"))
+        throw std::invalid_argument("expected a book with --book");
+    const db::polyglot::Keys keys = keys_option(options, options.value("book"));
+    db::polyglot::Book book;
+    book.set_keys(keys);
+    if (!book.open(options.value("book")))
+        throw std::runtime_error("cannot open " + options.value("book") + " as a Polyglot book");
+    std::printf("%zu entries\n", book.size());
+    if (!book.has_start_position())
+        std::fprintf(stderr, "warning: the start position is not in the book, it may need the Random64 table (%s next "
+                     "to the book or --keys)\n", db::polyglot::KEYS_FILE);
+
+    std::vector<std::string> fens = options.positional();
+    if (fens.empty()) {
+        for (std::string line; std::getline(std::cin, line);) {
+            if (!line.empty())
+                fens.push_back(line);
+        }
+    }
+
+    db::Board board;
+    for (const auto &fen : fens) {
+        if (!board.set_fen(fen)) {
+            std::printf("%s: invalid fen\n", fen.c_str());
+            continue;
+        }
+        const auto begin = std::chrono::steady_clock::now();
+        std::vector<db::polyglot::BookMove> moves = book.moves(board, board.get_position());
+        const double micros =
+            std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+        unsigned total = 0;
+        for (const auto &move : moves)
+            total += move.weight;
+        std::printf("%s: key %016llx, %zu moves (%.1f us)\n", fen.c_str(),
+                    (unsigned long long)db::polyglot::key(board.get_position(), keys), moves.size(), micros);
+        for (auto &move : moves) {
+            board.prepare_for_print(move.move);
+            std::printf("    %-8s %6u %5.1f%%\n", move.move.to_san().c_str(), unsigned(move.weight),
+                        total ? 100.0 * move.weight / total : 0.0);
+        }
+    }
+    return 0;
+}
+
+} // namespace cli
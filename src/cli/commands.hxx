@@ -0,0 +1,21 @@
+#pragma once
+#include "options.hxx"
+
+// Subcommands of chesscli, each returns the process exit code.
+namespace cli {
+int annotate(const Options &options);
+int tt_stress(const Options &options);
+int smp_bench(const Options &options);
+int see(const Options &options);
+int perft(const Options &options);
+int eval_bench(const Options &options);
+int nnue_bench(const Options &options);
+int tb_probe(const Options &options);
+int tb_gen(const Options &options);
+int book_build(const Options &options);
+int book_probe(const Options &options);
+int fen_batch(const Options &options);
+int datagen(const Options &options);
+int tune(const Options &options);
+int match(const Options &options);
+} // namespace cli
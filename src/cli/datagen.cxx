@@ -0,0 +1,400 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "commands.hxx"
+#include "pgn.hxx"
+#include "search.hxx"
+#include "trainingdata.hxx"
+
+namespace cli {
+namespace {
+const std::string START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+// self-play games running longer are drawn
+constexpr int MAX_GAME_PLIES = 400;
+// a score this large for ADJUDICATION_PLIES plies in a row ends the game
+constexpr int WIN_ADJUDICATION_SCORE = 1500;
+constexpr int ADJUDICATION_PLIES = 4;
+constexpr size_t GAMES_PER_THREAD = 16;
+
+struct Settings
+{
+    engine::SearchLimits limits;
+    size_t hash_mb{16};
+    int random_plies{8};
+    int min_ply{8};
+    double sample{1.0};
+    uint64_t target{0}; // positions to write, 0 for the whole input in replay mode
+};
+
+struct Counters
+{
+    std::atomic<uint64_t> games{0};
+    std::atomic<uint64_t> positions{0};
+    std::atomic<uint64_t> nodes{0};
+};
+
+// Collects the records of finished games and writes them in chunks of chunk_size, every chunk shuffled on its own.
+// Chunk files are numbered on from the ones already in the directory.
+class ChunkWriter
+{
+public:
+    ChunkWriter(std::string directory, size_t chunk_size, uint64_t seed)
+        : m_directory(std::move(directory))
+        , m_chunk_size(chunk_size)
+        , m_next_index(0)
+        , m_random(seed)
+    {
+        std::filesystem::create_directories(m_directory);
+        while (std::filesystem::exists(path(m_next_index)))
+            ++m_next_index;
+    }
+
+    void add(const std::vector<engine::TrainingRecord> &records)
+    {
+        std::vector<engine::TrainingRecord> full;
+        size_t index;
+        {
+            std::lock_guard lock(m_mutex);
+            m_pending.insert(m_pending.end(), records.begin(), records.end());
+            if (m_pending.size() < m_chunk_size)
+                return;
+            full.assign(m_pending.begin(), m_pending.begin() + ptrdiff_t(m_chunk_size));
+            m_pending.erase(m_pending.begin(), m_pending.begin() + ptrdiff_t(m_chunk_size));
+            index = m_next_index++;
+            std::shuffle(full.begin(), full.end(), m_random);
+        }
+        engine::write_training_chunk(path(index), full);
+    }
+
+    // writes what is left as a last, smaller chunk
+    void finish()
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_pending.empty())
+            return;
+        std::shuffle(m_pending.begin(), m_pending.end(), m_random);
+        engine::write_training_chunk(path(m_next_index++), m_pending);
+        m_pending.clear();
+    }
+
+private:
+    [[nodiscard]] std::string path(size_t index) const
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "chunk_%05zu.bin", index);
+        return (std::filesystem::path(m_directory) / name).string();
+    }
+
+    std::string m_directory;
+    size_t m_chunk_size;
+    size_t m_next_index;
+    std::mt19937_64 m_random;
+    std::mutex m_mutex;
+    std::vector<engine::TrainingRecord> m_pending;
+};
+
+// One thread's search, with a table of its own so that the scores of different games do not leak into each other.
+class Scorer
+{
+public:
+    Scorer(const Settings &settings, uint64_t seed)
+        : m_settings(settings)
+        , m_tt(settings.hash_mb)
+        , m_random(seed)
+    {
+        m_search.set_transposition_table(&m_tt);
+    }
+
+    // searches the board's position, repetitions of the game's earlier positions included
+    engine::SearchInfo search(const db::Board &board, Counters &counters)
+    {
+        static const std::atomic<bool> stop{false};
+        m_tt.new_search();
+        m_search.set_position(board.get_position(), board.history());
+        engine::SearchInfo info = m_search.go(m_settings.limits, stop);
+        counters.nodes.fetch_add(info.nodes, std::memory_order_relaxed);
+        return info;
+    }
+
+    void new_game() { m_tt.clear(); }
+    bool sampled()
+    {
+        return m_settings.sample >= 1.0 || std::uniform_real_distribution<>(0, 1)(m_random) < m_settings.sample;
+    }
+    std::mt19937_64 &random() { return m_random; }
+
+private:
+    const Settings &m_settings;
+    engine::TranspositionTable m_tt;
+    engine::Search m_search;
+    std::mt19937_64 m_random;
+};
+
+// quiet positions only: the side to move is not in check, the best move neither captures nor promotes and the score
+// is not a mate. The evaluation cannot be expected to see tactics.
+bool is_quiet(db::Board &board, const engine::SearchInfo &info)
+{
+    if (board.is_check() || info.is_mate || info.pv.empty())
+        return false;
+    const db::Move &best = info.pv.front();
+    return best.captured == db::PIECE_NONE && best.promoted == db::PIECE_NONE && !best.is_enpassant;
+}
+
+engine::TrainingRecord make_record(const db::Position &position, const engine::SearchInfo &info, int ply)
+{
+    engine::TrainingRecord record;
+    record.position = db::PackedPosition::pack(position);
+    record.score = int16_t(std::clamp(info.score, -engine::VALUE_TB_WIN, engine::VALUE_TB_WIN));
+    record.ply = uint16_t(std::min(ply, int(UINT16_MAX)));
+    return record;
+}
+
+// the result from white's point of view once the game is decided without a search: 1, 0 or -1, nullopt while it goes
+// on
+std::optional<int> game_over(db::Board &board)
+{
+    if (board.generate_moves().empty())
+        return board.is_check() ? (board.get_position().stm == db::WHITE ? -1 : 1) : 0;
+    if (board.is_fifty_move_draw() || board.is_repetition(2) || board.is_insufficient_material())
+        return 0;
+    return std::nullopt;
+}
+
+// Plays one game against itself from the start position or an opening line, after random_plies random moves.
+// Returns the records of the game labelled with its result.
+std::vector<engine::TrainingRecord> play_game(db::Board &board, Scorer &scorer, const Settings &settings,
+                                             const std::vector<std::string> &openings, Counters &counters)
+{
+    std::vector<engine::TrainingRecord> records;
+    for (;;) {
+        const std::string &fen =
+            openings.empty() ? START_FEN : openings[std::uniform_int_distribution<size_t>(0, openings.size() - 1)(
+                                               scorer.random())];
+        if (!board.set_fen(fen))
+            throw std::runtime_error("invalid opening " + fen);
+        bool alive = true;
+        for (int ply = 0; ply < settings.random_plies && alive; ++ply) {
+            const std::vector<db::Move> moves = board.generate_moves();
+            alive = !moves.empty();
+            if (alive)
+                board.do_move(moves[std::uniform_int_distribution<size_t>(0, moves.size() - 1)(scorer.random())]);
+        }
+        // openings that are already over are drawn again
+        if (alive && !board.generate_moves().empty())
+            break;
+    }
+    scorer.new_game();
+
+    std::optional<int> result;
+    int decisive_plies = 0;
+    for (int ply = 0; !result; ++ply) {
+        if ((result = game_over(board)))
+            break;
+        if (ply >= MAX_GAME_PLIES) {
+            result = 0;
+            break;
+        }
+
+        const engine::SearchInfo info = scorer.search(board, counters);
+        const int white_score = board.get_position().stm == db::WHITE ? info.score : -info.score;
+        if (ply >= settings.min_ply && is_quiet(board, info) && scorer.sampled())
+            records.push_back(make_record(board.get_position(), info, ply));
+
+        // both sides agree on the winner for a few plies, or a mate is on the board
+        if (info.is_mate) {
+            result = white_score > 0 ? 1 : -1;
+            break;
+        }
+        decisive_plies = std::abs(info.score) >= WIN_ADJUDICATION_SCORE ? decisive_plies + 1 : 0;
+        if (decisive_plies >= ADJUDICATION_PLIES) {
+            result = white_score > 0 ? 1 : -1;
+            break;
+        }
+        if (info.pv.empty()) {
+            result = 0;
+            break;
+        }
+        board.do_move(info.pv.front());
+    }
+
+    for (auto &record : records) {
+        const bool white = record.position.stm == db::WHITE;
+        record.result = int8_t(white ? *result : -*result);
+    }
+    return records;
+}
+
+// Scores the mainline positions of a game from a collection and labels them with its result, games without one are
+// skipped.
+std::vector<engine::TrainingRecord> replay_game(const db::PgnGame &game, db::Board &board, Scorer &scorer,
+                                               const Settings &settings, Counters &counters)
+{
+    std::vector<engine::TrainingRecord> records;
+    const int result = game.result == "1-0" ? 1 : game.result == "0-1" ? -1 : game.result == "1/2-1/2" ? 0 : 2;
+    if (result == 2)
+        return records;
+    board.set_fen(game.game.start_fen());
+    scorer.new_game();
+    int ply = 0;
+    for (auto node = game.game.get_moves().begin() + 1; node != game.game.get_moves().end(); ++node) {
+        if (node->variation_level != 0)
+            continue;
+        if (ply >= settings.min_ply && scorer.sampled() && !board.is_check()) {
+            const engine::SearchInfo info = scorer.search(board, counters);
+            if (is_quiet(board, info)) {
+                records.push_back(make_record(board.get_position(), info, ply));
+                records.back().result = int8_t(board.get_position().stm == db::WHITE ? result : -result);
+            }
+        }
+        board.do_move(node->move);
+        ++ply;
+    }
+    return records;
+}
+
+void report(const Counters &counters, std::chrono::steady_clock::time_point start, bool final)
+{
+    const double seconds =
+        std::max(1e-3, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    const uint64_t positions = counters.positions.load(std::memory_order_relaxed);
+    std::fprintf(stderr, "\rgames %llu  positions %llu  %.0f positions/h  %.0f knps  %.0fs%s",
+                 (unsigned long long)counters.games.load(std::memory_order_relaxed), (unsigned long long)positions,
+                 positions / seconds * 3600, counters.nodes.load(std::memory_order_relaxed) / seconds / 1000, seconds,
+                 final ? "\n" : "");
+}
+
+std::vector<std::string> read_openings(const std::string &path)
+{
+    std::ifstream in(path);
+    if (!in)
+        throw std::runtime_error("cannot open " + path);
+    std::vector<std::string> openings;
+    db::Board board;
+    db::Position position;
+    for (std::string line; std::getline(in, line);) {
+        // EPD lines keep only their four fields, the clocks start over
+        std::string_view operations;
+        if (board.parse_fen(line, position, &operations) != db::FenError::NONE || board.validate(position) !=
+                                                                                        db::FenError::NONE)
+            continue;
+        char fen[db::MAX_FEN_LENGTH];
+        position.half_move_clock = 0;
+        position.full_move = 1;
+        openings.emplace_back(fen, db::Board::write_fen(position, fen));
+    }
+    if (openings.empty())
+        throw std::runtime_error("no positions in " + path);
+    return openings;
+}
+} // namespace
+
+int datagen(const Options &options)
+{
+    if (!options.has("out"))
+        throw std::invalid_argument("expected an output directory with --out");
+    Settings settings;
+    // a fixed node count keeps the cost per position even, a depth limit alone searches without one
+    settings.limits.nodes = uint64_t(std::max<int64_t>(0, options.integer("nodes", options.has("depth") ? 0 : 5000)));
+    settings.limits.depth = int(std::clamp<int64_t>(options.integer("depth", engine::MAX_PLY), 1, engine::MAX_PLY));
+    settings.hash_mb = size_t(std::max<int64_t>(1, options.integer("hash", 16)));
+    settings.random_plies = int(std::max<int64_t>(0, options.integer("random-plies", 8)));
+    settings.min_ply = int(std::max<int64_t>(0, options.integer("min-ply", 8)));
+    settings.sample = std::clamp(options.real("sample", 1.0), 0.0, 1.0);
+    const bool replay = !options.positional().empty();
+    settings.target = uint64_t(std::max<int64_t>(0, options.integer("positions", replay ? 0 : 1000000)));
+    const size_t threads =
+        size_t(std::max<int64_t>(1, options.integer("threads", std::max(1u, std::thread::hardware_concurrency()))));
+    const size_t chunk_size = size_t(std::max<int64_t>(1, options.integer("chunk", 1 << 20)));
+    const uint64_t seed = uint64_t(options.integer("seed", int64_t(std::random_device{}())));
+    const std::vector<std::string> openings =
+        options.has("openings") ? read_openings(options.value("openings")) : std::vector<std::string>{};
+
+    ChunkWriter writer(options.value("out"), chunk_size, seed);
+    Counters counters;
+    const auto done = [&] {
+        return settings.target && counters.positions.load(std::memory_order_relaxed) >= settings.target;
+    };
+    const auto store = [&](const std::vector<engine::TrainingRecord> &records) {
+        counters.games.fetch_add(1, std::memory_order_relaxed);
+        counters.positions.fetch_add(records.size(), std::memory_order_relaxed);
+        writer.add(records);
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    std::mutex progress_mutex;
+    std::condition_variable progress_cv;
+    bool finished = false;
+    std::thread progress([&] {
+        std::unique_lock lock(progress_mutex);
+        while (!progress_cv.wait_for(lock, std::chrono::seconds(1), [&] { return finished; }))
+            report(counters, start, false);
+    });
+
+    std::vector<std::unique_ptr<Scorer>> scorers;
+    for (size_t t = 0; t < threads; ++t)
+        scorers.push_back(std::make_unique<Scorer>(settings, seed + t + 1));
+    std::vector<std::thread> workers;
+    if (!replay) {
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                db::Board board;
+                while (!done())
+                    store(play_game(board, *scorers[t], settings, openings, counters));
+            });
+        }
+        for (auto &worker : workers)
+            worker.join();
+    } else {
+        // games of the collection are the unit of work, read in batches like annotate does
+        for (const auto &path : options.positional()) {
+            std::ifstream file(path);
+            if (!file)
+                throw std::runtime_error("cannot open " + path);
+            db::PgnReader reader(file);
+            std::vector<db::PgnGame> batch(threads * GAMES_PER_THREAD);
+            while (!done()) {
+                size_t count = 0;
+                while (count < batch.size() && reader.read(batch[count]))
+                    ++count;
+                if (count == 0)
+                    break;
+                std::atomic<size_t> next{0};
+                workers.clear();
+                for (size_t t = 0; t < std::min(threads, count); ++t) {
+                    workers.emplace_back([&, t] {
+                        db::Board board;
+                        for (size_t i = next++; i < count && !done(); i = next++)
+                            store(replay_game(batch[i], board, *scorers[t], settings, counters));
+                    });
+                }
+                for (auto &worker : workers)
+                    worker.join();
+            }
+        }
+    }
+    writer.finish();
+
+    {
+        std::lock_guard lock(progress_mutex);
+        finished = true;
+    }
+    progress_cv.notify_one();
+    progress.join();
+    report(counters, start, true);
+    return 0;
+}
+
+} // namespace cli
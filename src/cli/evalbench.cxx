@@ -0,0 +1,79 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "commands.hxx"
+#include "evaluate.hxx"
+
+namespace cli {
+namespace {
+const char *const start_positions[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP3PPP/R2QKB1R w KQ - 0 8",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+};
+
+template<typename Evaluate>
+double time_ns(const std::vector<db::Position> &positions, int rounds, Evaluate evaluate, int64_t &checksum)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        for (const auto &position : positions)
+            checksum += evaluate(position);
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+           (double(rounds) * positions.size());
+}
+} // namespace
+
+int eval_bench(const Options &options)
+{
+    // a set that stays in cache like the positions along a search path do, larger sets measure memory instead
+    const size_t count = size_t(std::max<int64_t>(1, options.integer("positions", 2000)));
+    const int rounds = int(std::max<int64_t>(1, options.integer("rounds", 500)));
+
+    // random games from a few start positions, every position on the way is kept. Taking the moves back again checks
+    // that undo_move restores the sums exactly.
+    std::mt19937_64 random(1);
+    std::vector<db::Position> positions;
+    positions.reserve(count);
+    size_t mismatches = 0;
+    db::Board board;
+    while (positions.size() < count) {
+        for (const char *fen : start_positions) {
+            board.set_fen(fen);
+            const db::Position start = board.get_position();
+            std::vector<db::Move> played;
+            for (int ply = 0; ply < 100 && positions.size() < count; ++ply) {
+                std::vector<db::Move> moves = board.generate_moves();
+                if (moves.empty())
+                    break;
+                played.push_back(moves[random() % moves.size()]);
+                board.do_move(played.back());
+                positions.push_back(board.get_position());
+            }
+            while (!played.empty()) {
+                board.undo_move(played.back());
+                played.pop_back();
+            }
+            const db::Position &undone = board.get_position();
+            mismatches += undone.psqt_mg != start.psqt_mg || undone.psqt_eg != start.psqt_eg ||
+                          undone.phase != start.phase;
+        }
+    }
+    for (const auto &position : positions)
+        mismatches += engine::evaluate(position) != engine::evaluate_from_scratch(position);
+
+    int64_t checksum = 0;
+    const double incremental = time_ns(positions, rounds, engine::evaluate, checksum);
+    const double scratch = time_ns(positions, rounds, engine::evaluate_from_scratch, checksum);
+    std::printf("%zu positions, %zu mismatches\n", positions.size(), mismatches);
+    std::printf("incremental   %6.2f ns per evaluation\n", incremental);
+    std::printf("from scratch  %6.2f ns per evaluation (%.1fx)\n", scratch, scratch / incremental);
+    std::printf("checksum %lld\n", (long long)checksum);
+    return mismatches == 0 ? 0 : 1;
+}
+
+} // namespace cli
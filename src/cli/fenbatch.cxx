@@ -0,0 +1,239 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "bitboard.hxx"
+#include "commands.hxx"
+#include "packedposition.hxx"
+
+namespace cli {
+namespace {
+constexpr size_t CHUNK_SIZE = 1 << 20;
+constexpr size_t CHUNKS_PER_THREAD = 4;
+constexpr size_t REPORTED_ERRORS = 10;
+
+enum class Output
+{
+    FEN,
+    EPD,
+    KEY,
+    PACKED,
+};
+
+// the whole input, memory mapped when it is a regular file
+class Input
+{
+public:
+    explicit Input(const std::string &path)
+    {
+        if (path == "-") {
+            m_owned.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+            m_text = m_owned;
+            return;
+        }
+#ifdef __unix__
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("cannot open " + path);
+        struct stat status;
+        const bool regular = fstat(fd, &status) == 0 && S_ISREG(status.st_mode);
+        if (regular && status.st_size > 0) {
+            void *map = mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+                // read once front to back
+                madvise(map, size_t(status.st_size), MADV_SEQUENTIAL);
+                m_mapping = map;
+                m_text = std::string_view(static_cast<const char *>(map), size_t(status.st_size));
+            }
+        }
+        ::close(fd);
+        if (m_mapping || (regular && status.st_size == 0))
+            return;
+#endif
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            throw std::runtime_error("cannot open " + path);
+        m_owned.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        m_text = m_owned;
+    }
+
+    ~Input()
+    {
+#ifdef __unix__
+        if (m_mapping)
+            munmap(m_mapping, m_text.size());
+#endif
+    }
+
+    Input(const Input &) = delete;
+    Input &operator=(const Input &) = delete;
+
+    [[nodiscard]] std::string_view text() const { return m_text; }
+
+private:
+    std::string m_owned;
+    std::string_view m_text;
+    void *m_mapping{nullptr};
+};
+
+struct Chunk
+{
+    std::string_view text;
+    std::string output;
+    size_t lines{0};
+    size_t invalid{0};
+    // line within the chunk and the reason of the first rejected lines
+    std::vector<std::pair<size_t, db::FenError>> errors;
+};
+
+void process(db::Board &board, Chunk &chunk, Output output)
+{
+    chunk.output.clear();
+    chunk.output.reserve(chunk.text.size() + chunk.text.size() / 4);
+    chunk.lines = chunk.invalid = 0;
+    chunk.errors.clear();
+    db::Position position;
+    char buffer[db::MAX_FEN_LENGTH];
+    for (size_t begin = 0; begin < chunk.text.size();) {
+        size_t end = chunk.text.find('\n', begin);
+        if (end == std::string_view::npos)
+            end = chunk.text.size();
+        std::string_view line = chunk.text.substr(begin, end - begin);
+        begin = end + 1;
+        ++chunk.lines;
+        const size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string_view::npos)
+            continue;
+        line.remove_prefix(first);
+
+        // only EPD output keeps operations, anything after the fields of a FEN is an error otherwise
+        std::string_view operations;
+        db::FenError error = board.parse_fen(line, position, output == Output::EPD ? &operations : nullptr);
+        if (error == db::FenError::NONE)
+            error = board.validate(position);
+        if (error != db::FenError::NONE) {
+            ++chunk.invalid;
+            if (chunk.errors.size() < REPORTED_ERRORS)
+                chunk.errors.emplace_back(chunk.lines, error);
+            continue;
+        }
+        switch (output) {
+            case Output::FEN:
+                chunk.output.append(buffer, db::Board::write_fen(position, buffer));
+                break;
+            case Output::EPD:
+                chunk.output.append(buffer, db::Board::write_fen(position, buffer, true));
+                if (!operations.empty()) {
+                    chunk.output.push_back(' ');
+                    chunk.output.append(operations);
+                }
+                break;
+            case Output::KEY: {
+                static constexpr char hex[] = "0123456789abcdef";
+                const uint64_t key = position.key();
+                for (int shift = 60; shift >= 0; shift -= 4)
+                    chunk.output.push_back(hex[key >> shift & 15]);
+                break;
+            }
+            case Output::PACKED: {
+                // fixed size records without line breaks
+                const db::PackedPosition packed = db::PackedPosition::pack(position);
+                chunk.output.append(reinterpret_cast<const char *>(&packed), sizeof(packed));
+                continue;
+            }
+        }
+        chunk.output.push_back('\n');
+    }
+}
+} // namespace
+
+int fen_batch(const Options &options)
+{
+    if (options.positional().size() != 2)
+        throw std::invalid_argument("expected an input and an output file");
+    const std::string to = options.value("to", "fen");
+    if (to != "fen" && to != "epd" && to != "key" && to != "packed")
+        throw std::invalid_argument("--to takes fen, epd, key or packed");
+    const Output output = to == "fen"   ? Output::FEN
+                          : to == "epd" ? Output::EPD
+                          : to == "key" ? Output::KEY
+                                        : Output::PACKED;
+    const size_t threads =
+        size_t(std::max<int64_t>(1, options.integer("threads", std::max(1u, std::thread::hardware_concurrency()))));
+
+    const Input input(options.positional()[0]);
+    std::ofstream file;
+    const std::string out_path = options.positional()[1];
+    if (out_path != "-") {
+        file.open(out_path, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("cannot write " + out_path);
+    }
+    std::ostream &out = out_path == "-" ? std::cout : file;
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<db::Board> boards(threads);
+    std::vector<Chunk> batch(threads * CHUNKS_PER_THREAD);
+    const std::string_view text = input.text();
+    size_t offset = 0, lines = 0, invalid = 0, reported = 0;
+    // chunks end at a line break, workers take whole chunks and the batch is written in input order
+    while (offset < text.size()) {
+        size_t count = 0;
+        for (; count < batch.size() && offset < text.size(); ++count) {
+            size_t end = offset + CHUNK_SIZE;
+            if (end >= text.size()) {
+                end = text.size();
+            } else {
+                end = text.find('\n', end);
+                end = end == std::string_view::npos ? text.size() : end + 1;
+            }
+            batch[count].text = text.substr(offset, end - offset);
+            offset = end;
+        }
+
+        std::atomic<size_t> next{0};
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < std::min(threads, count); ++t) {
+            workers.emplace_back([&, t] {
+                for (size_t i = next++; i < count; i = next++)
+                    process(boards[t], batch[i], output);
+            });
+        }
+        for (auto &worker : workers)
+            worker.join();
+
+        for (size_t i = 0; i < count; ++i) {
+            out.write(batch[i].output.data(), std::streamsize(batch[i].output.size()));
+            for (const auto &[line, error] : batch[i].errors) {
+                if (reported++ < REPORTED_ERRORS)
+                    std::cerr << "line " << lines + line << ": " << db::fen_error_text(error) << "\n";
+            }
+            lines += batch[i].lines;
+            invalid += batch[i].invalid;
+        }
+    }
+    out.flush();
+
+    const double seconds =
+        std::max(1e-6, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    std::fprintf(stderr, "%zu lines, %zu invalid, %.2f s, %.2f M lines/s\n", lines, invalid, seconds,
+                 lines / seconds / 1e6);
+    return 0;
+}
+
+} // namespace cli
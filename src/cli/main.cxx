@@ -0,0 +1,102 @@
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <set>
+#include <string>
+
+#include "commands.hxx"
+
+namespace {
+struct Command
+{
+    const char *name;
+    int (*run)(const cli::Options &);
+    std::set<std::string> flags;
+    const char *usage;
+};
+
+const Command commands[] = {
+    {"annotate", cli::annotate, {"huge-pages"},
+     "annotate [--depth N] [--nodes N] [--threads N] [--hash MB] [--huge-pages] [--nnue FILE] [--tb DIR]\n"
+     "         <in.pgn|-> <out.pgn|->\n"
+     "    evaluates every mainline position and marks mistakes with NAGs"},
+    {"tt-stress", cli::tt_stress, {"huge-pages"},
+     "tt-stress [--threads N] [--seconds N] [--hash MB] [--huge-pages]\n"
+     "    hammers the transposition table from all threads and checks that no torn entry is returned"},
+    {"smp-bench", cli::smp_bench, {},
+     "smp-bench [--depth N] [--threads 1,2,4,8,16] [--hash MB]\n"
+     "    time to depth of the parallel search over a fixed set of positions for every thread count"},
+    {"see", cli::see, {}, "see\n    checks static exchange evaluation against a fixed set of known values"},
+    {"perft", cli::perft, {},
+     "perft [--depth N] [--check N]\n"
+     "    counts the leaves of the standard, Kiwipete and Chess960 test positions to depth N (4, at most 5) against\n"
+     "    their known counts, and checks the undo, FEN, packed and UCI round trips of every move to depth N (2)"},
+    {"eval-bench", cli::eval_bench, {},
+     "eval-bench [--positions N] [--rounds N]\n"
+     "    compares the incremental evaluation with summing up the board on positions from random games"},
+    {"nnue-bench", cli::nnue_bench, {},
+     "nnue-bench [--net FILE] [--save FILE] [--positions N]\n"
+     "    network inference throughput, incremental against refreshed accumulators (random weights without --net)"},
+    {"tb-probe", cli::tb_probe, {"moves"},
+     "tb-probe --tb DIR [--moves] [FEN...]\n"
+     "    looks up positions (one FEN per line on stdin without arguments) in the endgame tables (.ctb files and\n"
+     "    Syzygy .rtbw/.rtbz files)"},
+    {"tb-gen", cli::tb_gen, {},
+     "tb-gen --out DIR [--threads N] [--check N] MATERIAL...\n"
+     "    generates endgame tables like KRPvKR and the smaller ones they depend on, --check compares N random\n"
+     "    positions of every new table with their moves"},
+    {"book-build", cli::book_build, {},
+     "book-build --out FILE [--plies N] [--min-games N] [--keys FILE] <in.pgn|->...\n"
+     "    builds a Polyglot book from the first N plies (40) of every game, weighting moves by their results"},
+    {"book-probe", cli::book_probe, {},
+     "book-probe --book FILE [--keys FILE] [FEN...]\n"
+     "    lists the book moves of positions (one FEN per line on stdin without arguments). Books built by other\n"
+     "    programs need the Polyglot Random64 table, from --keys or random64.txt next to the book"},
+    {"fen-batch", cli::fen_batch, {},
+     "fen-batch [--to fen|epd|key|packed] [--threads N] <in.fen|in.epd|-> <out|->\n"
+     "    validates FEN or EPD lines and writes them normalized, as EPD keeping their operations, as zobrist keys or\n"
+     "    as 32 byte packed positions, invalid lines are dropped and the first ones reported. Only --to epd accepts\n"
+     "    operations after the fields"},
+    {"datagen", cli::datagen, {},
+     "datagen --out <dir> [--positions N] [--nodes N|--depth N] [--threads N] [--hash MB] [--random-plies N]\n"
+     "        [--min-ply N] [--sample P] [--chunk N] [--openings file.epd] [--seed S] [games.pgn...]\n"
+     "    samples quiet positions with their search score and game result from self-play, or from the mainlines of\n"
+     "    the games given, and writes them to shuffled chunks of 40 byte records"},
+    {"tune", cli::tune, {"mobility"},
+     "tune [--epochs N] [--rate R] [--lambda L] [--scaling K] [--mobility] [--threads N] [--report N] [--out file]\n"
+     "        <chunk.bin|dir>...\n"
+     "    fits the material and piece square values, with --mobility also a mobility weight per piece, to the\n"
+     "    results and with --lambda the scores of datagen chunks and prints them as the tables of psqt.hxx"},
+    {"match", cli::match, {},
+     "match (--tc S[+S] | --movetime MS | --nodes N | --depth N) [--games N] [--concurrency N] [--openings FILE]\n"
+     "      [--plies N] [--seed S] [--sprt ELO0,ELO1] [--alpha A] [--beta B] [--resign CP] [--max-plies N]\n"
+     "      [--hash MB] [--engine-threads N] [--timemargin MS] [--pgn-out FILE] <engine1> <engine2>\n"
+     "    plays games between two UCI engines in parallel, the openings from an EPD or PGN file in pairs with\n"
+     "    colors swapped, adjudicates them by the rules and reports elo with its error, LOS and the SPRT result"},
+};
+
+int usage()
+{
+    std::cerr << "usage: chesscli <command> [options]\n\n";
+    for (const auto &command : commands)
+        std::cerr << "  " << command.usage << "\n";
+    return 2;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+        return usage();
+    for (const auto &command : commands) {
+        if (std::strcmp(argv[1], command.name) != 0)
+            continue;
+        try {
+            return command.run(cli::Options(argc - 2, argv + 2, command.flags));
+        } catch (const std::exception &e) {
+            std::cerr << command.name << ": " << e.what() << "\n";
+            return 1;
+        }
+    }
+    return usage();
+}
@@ -0,0 +1,665 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char **environ;
+#endif
+
+#include "commands.hxx"
+#include "pgn.hxx"
+#include "uci.hxx"
+
+namespace cli {
+namespace {
+using Clock = std::chrono::steady_clock;
+
+const std::string START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+// time an engine gets to answer uci and isready
+constexpr std::chrono::seconds HANDSHAKE_TIMEOUT{10};
+// a resigning score has to stand for this many moves of both engines
+constexpr int RESIGN_MOVES = 4;
+
+// A local executable with its standard input and output connected to pipes. Lines are read with a deadline so that
+// a hanging engine loses on time instead of stalling its game.
+class ChildProcess
+{
+public:
+    explicit ChildProcess(const std::string &path)
+    {
+#ifdef __unix__
+        int input[2], output[2];
+        if (pipe2(input, O_CLOEXEC) != 0)
+            throw std::runtime_error("cannot create a pipe for " + path);
+        if (pipe2(output, O_CLOEXEC) != 0) {
+            close(input[0]);
+            close(input[1]);
+            throw std::runtime_error("cannot create a pipe for " + path);
+        }
+        // posix_spawn rather than fork: other threads are running games and only exec is safe in a forked copy
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, input[0], STDIN_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, output[1], STDOUT_FILENO);
+        char *argv[] = {const_cast<char *>(path.c_str()), nullptr};
+        const int error = posix_spawnp(&m_pid, path.c_str(), &actions, nullptr, argv, environ);
+        posix_spawn_file_actions_destroy(&actions);
+        close(input[0]);
+        close(output[1]);
+        m_in = input[1];
+        m_out = output[0];
+        if (error != 0) {
+            close(m_in);
+            close(m_out);
+            throw std::runtime_error("cannot start " + path);
+        }
+#else
+        throw std::runtime_error("engine matches need a POSIX system, cannot start " + path);
+#endif
+    }
+
+    ~ChildProcess()
+    {
+#ifdef __unix__
+        close(m_in);
+        close(m_out);
+        // engines quit once their input closes, the ones that do not are killed after a grace period
+        for (int i = 0; i < 50; ++i) {
+            if (waitpid(m_pid, nullptr, WNOHANG) == m_pid)
+                return;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        kill(m_pid, SIGKILL);
+        waitpid(m_pid, nullptr, 0);
+#endif
+    }
+
+    ChildProcess(const ChildProcess &) = delete;
+    ChildProcess &operator=(const ChildProcess &) = delete;
+
+    bool write_line(std::string_view line)
+    {
+#ifdef __unix__
+        std::string text(line);
+        text.push_back('\n');
+        for (size_t written = 0; written < text.size();) {
+            const ssize_t count = write(m_in, text.data() + written, text.size() - written);
+            if (count <= 0)
+                return false;
+            written += size_t(count);
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // false once the deadline passes or the process closed its output
+    bool read_line(std::string &line, Clock::time_point deadline)
+    {
+        for (;;) {
+            const size_t end = m_buffer.find('\n', m_consumed);
+            if (end != std::string::npos) {
+                line.assign(m_buffer, m_consumed, end - m_consumed);
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                m_consumed = end + 1;
+                return true;
+            }
+            m_buffer.erase(0, m_consumed);
+            m_consumed = 0;
+#ifdef __unix__
+            const auto remaining =
+                std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+            if (remaining < 0)
+                return false;
+            pollfd descriptor{m_out, POLLIN, 0};
+            if (poll(&descriptor, 1, int(std::min<int64_t>(remaining, 1000))) <= 0)
+                continue;
+            char chunk[4096];
+            const ssize_t count = read(m_out, chunk, sizeof(chunk));
+            if (count <= 0)
+                return false;
+            m_buffer.append(chunk, size_t(count));
+#else
+            return false;
+#endif
+        }
+    }
+
+private:
+    int m_in{-1};
+    int m_out{-1};
+#ifdef __unix__
+    pid_t m_pid{0};
+#endif
+    std::string m_buffer;
+    size_t m_consumed{0};
+};
+
+struct EngineConfig
+{
+    std::string path;
+    int64_t hash_mb{0};
+    int64_t threads{0};
+};
+
+// One engine of a game slot, started once and kept for every game the slot plays. Engines that crash or hang are
+// started again for the next game.
+class UciPlayer
+{
+public:
+    explicit UciPlayer(const EngineConfig &config)
+        : m_config(config)
+    {}
+
+    // starts the process if it is not running and tells the engine a new game begins, false if it does not answer
+    bool new_game()
+    {
+        if (!m_process) {
+            m_process = std::make_unique<ChildProcess>(m_config.path);
+            if (!handshake()) {
+                m_process.reset();
+                return false;
+            }
+        }
+        return send("ucinewgame") && wait_ready();
+    }
+
+    // searches the position and returns the move in coordinate notation, nullopt if the engine did not answer before
+    // the deadline. score is set to the last score it reported, from its side.
+    std::optional<std::string> go(const std::string &position, const std::string &limits, Clock::time_point deadline,
+                                  std::optional<int> &score)
+    {
+        score.reset();
+        if (!m_process || !send(position) || !send(limits)) {
+            m_process.reset();
+            return std::nullopt;
+        }
+        std::string line;
+        engine::uci::Info info;
+        while (m_process->read_line(line, deadline)) {
+            std::string_view best;
+            if (engine::uci::parse_bestmove(line, best))
+                return std::string(best);
+            if (engine::uci::parse_info(line, info) && info.has_score && !info.lowerbound && !info.upperbound)
+                score = info.is_mate ? (info.score > 0 ? 100000 - info.score : -100000 - info.score) : info.score;
+        }
+        m_process.reset();
+        return std::nullopt;
+    }
+
+    // "id name" of the engine, the path until it has been started
+    [[nodiscard]] const std::string &name() const { return m_name.empty() ? m_config.path : m_name; }
+
+private:
+    bool send(std::string_view line) { return m_process->write_line(line); }
+
+    bool handshake()
+    {
+        if (!send("uci"))
+            return false;
+        const auto deadline = Clock::now() + HANDSHAKE_TIMEOUT;
+        bool has_hash = false, has_threads = false;
+        std::string line;
+        while (m_process->read_line(line, deadline)) {
+            std::string_view rest = line;
+            const std::string_view command = engine::uci::next_token(rest);
+            engine::uci::Option option;
+            if (command == "uciok") {
+                if (m_config.hash_mb && has_hash)
+                    send("setoption name Hash value " + std::to_string(m_config.hash_mb));
+                if (m_config.threads && has_threads)
+                    send("setoption name Threads value " + std::to_string(m_config.threads));
+                return wait_ready();
+            }
+            if (command == "id" && engine::uci::next_token(rest) == "name" && m_name.empty())
+                m_name = std::string(rest.substr(std::min(rest.find_first_not_of(' '), rest.size())));
+            else if (engine::uci::parse_option(line, option)) {
+                has_hash |= option.name == "Hash";
+                has_threads |= option.name == "Threads";
+            }
+        }
+        return false;
+    }
+
+    bool wait_ready()
+    {
+        if (!send("isready"))
+            return false;
+        const auto deadline = Clock::now() + HANDSHAKE_TIMEOUT;
+        std::string line;
+        while (m_process->read_line(line, deadline)) {
+            if (line == "readyok")
+                return true;
+        }
+        m_process.reset();
+        return false;
+    }
+
+    EngineConfig m_config;
+    std::unique_ptr<ChildProcess> m_process;
+    std::string m_name;
+};
+
+struct TimeControl
+{
+    // a clock of base_ms plus increment_ms per move, or a fixed limit per move when base_ms is 0
+    int64_t base_ms{0};
+    int64_t increment_ms{0};
+    int64_t movetime_ms{0};
+    int64_t nodes{0};
+    int64_t depth{0};
+    // slack over the clock before a move counts as a loss on time, and the time allowed without a clock
+    int64_t margin_ms{100};
+    int64_t move_timeout_ms{60000};
+};
+
+struct Opening
+{
+    std::string fen;
+    std::vector<db::Move> moves;
+};
+
+struct Settings
+{
+    TimeControl time_control;
+    int resign_score{0}; // 0 for no resign adjudication
+    int max_plies{0};    // 0 for none, games that reach it are drawn
+};
+
+struct GameResult
+{
+    int white_score2{1}; // white's points doubled: 2 won, 1 drawn, 0 lost
+    std::string reason;
+    db::PgnGame pgn;
+};
+
+// the position's result from white's side decided by the rules alone, nullopt while the game goes on
+std::optional<std::pair<int, std::string>> adjudicate(db::Board &board)
+{
+    if (board.generate_moves().empty()) {
+        if (!board.is_check())
+            return std::pair{1, std::string("stalemate")};
+        return std::pair{board.get_position().stm == db::WHITE ? 0 : 2, std::string("checkmate")};
+    }
+    if (board.is_fifty_move_draw())
+        return std::pair{1, std::string("50 move rule")};
+    if (board.is_repetition(2))
+        return std::pair{1, std::string("threefold repetition")};
+    if (board.is_insufficient_material())
+        return std::pair{1, std::string("insufficient material")};
+    return std::nullopt;
+}
+
+std::string go_command(const TimeControl &tc, const int64_t clocks[2])
+{
+    if (tc.base_ms) {
+        return "go wtime " + std::to_string(clocks[db::WHITE]) + " btime " + std::to_string(clocks[db::BLACK]) +
+               " winc " + std::to_string(tc.increment_ms) + " binc " + std::to_string(tc.increment_ms);
+    }
+    std::string command = "go";
+    if (tc.movetime_ms)
+        command += " movetime " + std::to_string(tc.movetime_ms);
+    if (tc.nodes)
+        command += " nodes " + std::to_string(tc.nodes);
+    if (tc.depth)
+        command += " depth " + std::to_string(tc.depth);
+    return command;
+}
+
+// Plays one game between players[0] as white and players[1] as black from opening. The board decides every result
+// the rules decide, the engines only choose moves; illegal moves, crashes and running out of time lose.
+GameResult play_game(UciPlayer *players[2], const Opening &opening, const Settings &settings)
+{
+    GameResult result;
+    db::Board board;
+    board.set_fen(opening.fen);
+    result.pgn.game = db::Game(opening.fen);
+    std::string position_command = "position fen " + opening.fen + " moves";
+    const auto play = [&](const db::Move &move) {
+        db::Move printed = move;
+        board.prepare_for_print(printed);
+        result.pgn.game.add_move(printed);
+        board.do_move(move);
+        position_command += " " + engine::uci::move_to_uci(move);
+    };
+    for (const db::Move &move : opening.moves)
+        play(move);
+
+    const auto finish = [&](int white_score2, std::string reason) {
+        result.white_score2 = white_score2;
+        result.reason = std::move(reason);
+    };
+    for (int color = 0; color < 2; ++color) {
+        if (!players[color]->new_game()) {
+            finish(color == db::WHITE ? 0 : 2, players[color]->name() + " does not answer");
+            return result;
+        }
+    }
+
+    const TimeControl &tc = settings.time_control;
+    int64_t clocks[2] = {tc.base_ms, tc.base_ms};
+    // consecutive moves of each engine with a decisive score, positive while white wins
+    int resign_streaks[2] = {0, 0};
+    for (int ply = 0;; ++ply) {
+        if (auto decided = adjudicate(board)) {
+            finish(decided->first, decided->second);
+            break;
+        }
+        if (settings.max_plies && ply >= settings.max_plies) {
+            finish(1, "move limit");
+            break;
+        }
+        const db::Color stm = board.get_position().stm;
+        const int loss = stm == db::WHITE ? 0 : 2;
+        UciPlayer &player = *players[stm];
+        const auto start = Clock::now();
+        const auto deadline = start + std::chrono::milliseconds(tc.base_ms ? clocks[stm] + tc.margin_ms
+                                                                            : tc.move_timeout_ms);
+        std::optional<int> score;
+        const std::optional<std::string> answer = player.go(position_command, go_command(tc, clocks), deadline, score);
+        const int64_t used_ms =
+            std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+        if (!answer) {
+            finish(loss, player.name() + (Clock::now() >= deadline ? " lost on time" : " stopped responding"));
+            break;
+        }
+        if (tc.base_ms) {
+            clocks[stm] -= used_ms;
+            if (clocks[stm] < -tc.margin_ms) {
+                finish(loss, player.name() + " lost on time");
+                break;
+            }
+            clocks[stm] = std::max<int64_t>(clocks[stm], 0) + tc.increment_ms;
+        }
+        const db::Move move = engine::uci::move_from_uci(board, *answer);
+        if (!move.is_legal) {
+            finish(loss, player.name() + " played the illegal move " + *answer);
+            break;
+        }
+        // both engines agree on the winner for a few moves each
+        if (settings.resign_score) {
+            const int white_score = !score ? 0 : stm == db::WHITE ? *score : -*score;
+            int &streak = resign_streaks[stm];
+            if (white_score >= settings.resign_score)
+                streak = std::max(streak, 0) + 1;
+            else if (white_score <= -settings.resign_score)
+                streak = std::min(streak, 0) - 1;
+            else
+                streak = 0;
+            if (std::min(resign_streaks[0], resign_streaks[1]) >= RESIGN_MOVES ||
+                std::max(resign_streaks[0], resign_streaks[1]) <= -RESIGN_MOVES) {
+                finish(streak > 0 ? 2 : 0, "adjudicated by score");
+                break;
+            }
+        }
+        play(move);
+    }
+    return result;
+}
+
+std::vector<Opening> read_openings(const std::string &path, int max_plies)
+{
+    std::vector<Opening> openings;
+    std::ifstream in(path);
+    if (!in)
+        throw std::runtime_error("cannot open " + path);
+    db::Board board;
+    if (path.ends_with(".pgn")) {
+        db::PgnReader reader(in);
+        db::PgnGame game;
+        while (reader.read(game)) {
+            Opening opening{game.game.start_fen(), {}};
+            for (auto node = game.game.get_moves().begin() + 1; node != game.game.get_moves().end(); ++node) {
+                if (node->variation_level == 0 && (max_plies == 0 || int(opening.moves.size()) < max_plies))
+                    opening.moves.push_back(node->move);
+            }
+            openings.push_back(std::move(opening));
+        }
+    } else {
+        db::Position position;
+        for (std::string line; std::getline(in, line);) {
+            std::string_view operations;
+            if (board.parse_fen(line, position, &operations) != db::FenError::NONE ||
+                board.validate(position) != db::FenError::NONE)
+                continue;
+            char fen[db::MAX_FEN_LENGTH];
+            openings.push_back({std::string(fen, db::Board::write_fen(position, fen)), {}});
+        }
+    }
+    if (openings.empty())
+        throw std::runtime_error("no openings in " + path);
+    return openings;
+}
+
+// "40/60+0.6" style clocks are not supported, only base seconds with an optional increment
+TimeControl parse_time_control(const Options &options)
+{
+    TimeControl tc;
+    if (options.has("tc")) {
+        const std::string text = options.value("tc");
+        const size_t plus = text.find('+');
+        tc.base_ms = int64_t(std::stod(text.substr(0, plus)) * 1000);
+        tc.increment_ms = plus == std::string::npos ? 0 : int64_t(std::stod(text.substr(plus + 1)) * 1000);
+        if (tc.base_ms <= 0)
+            throw std::invalid_argument("the time control needs a positive base time");
+    }
+    tc.movetime_ms = options.integer("movetime", 0);
+    tc.nodes = options.integer("nodes", 0);
+    tc.depth = options.integer("depth", 0);
+    tc.margin_ms = options.integer("timemargin", tc.margin_ms);
+    if (!tc.base_ms && !tc.movetime_ms && !tc.nodes && !tc.depth)
+        throw std::invalid_argument("expected a limit: --tc, --movetime, --nodes or --depth");
+    if (tc.movetime_ms)
+        tc.move_timeout_ms = tc.movetime_ms + std::max<int64_t>(tc.margin_ms, 1000);
+    return tc;
+}
+
+// Results from the first engine's side. Elo and its 95% interval follow from the score and the variance of the game
+// results, the SPRT is the usual normal approximation of the log likelihood ratio between elo0 and elo1.
+struct Statistics
+{
+    int wins{0};
+    int draws{0};
+    int losses{0};
+
+    [[nodiscard]] int games() const { return wins + draws + losses; }
+    [[nodiscard]] double score() const { return (wins + 0.5 * draws) / std::max(1, games()); }
+    // variance of a single game's result
+    [[nodiscard]] double variance() const
+    {
+        const double s = score();
+        return (wins * (1 - s) * (1 - s) + draws * (0.5 - s) * (0.5 - s) + losses * s * s) / std::max(1, games());
+    }
+
+    static double elo(double score)
+    {
+        score = std::clamp(score, 1e-6, 1 - 1e-6);
+        return -400 * std::log10(1 / score - 1);
+    }
+    static double expected_score(double elo) { return 1 / (1 + std::pow(10, -elo / 400)); }
+
+    [[nodiscard]] double elo() const { return elo(score()); }
+    [[nodiscard]] double elo_error() const
+    {
+        const double margin = 1.959964 * std::sqrt(variance() / std::max(1, games()));
+        return std::max(0.0, (elo(score() + margin) - elo(score() - margin)) / 2);
+    }
+    // likelihood of superiority, the probability that the first engine is the stronger one
+    [[nodiscard]] double los() const
+    {
+        return wins + losses ? 0.5 * (1 + std::erf((wins - losses) / std::sqrt(2.0 * (wins + losses)))) : 0.5;
+    }
+    [[nodiscard]] double llr(double elo0, double elo1) const
+    {
+        const double variance_of_mean = variance() / std::max(1, games());
+        if (variance_of_mean <= 0)
+            return 0;
+        const double s0 = expected_score(elo0), s1 = expected_score(elo1);
+        return (s1 - s0) * (2 * score() - s0 - s1) / (2 * variance_of_mean);
+    }
+};
+
+std::string summary(const Statistics &stats, const std::string &names)
+{
+    char text[256];
+    std::snprintf(text, sizeof(text), "%s: %d games +%d =%d -%d  score %.1f%%  elo %+.1f +- %.1f  los %.1f%%",
+                  names.c_str(), stats.games(), stats.wins, stats.draws, stats.losses, 100 * stats.score(),
+                  stats.elo(), stats.elo_error(), 100 * stats.los());
+    return text;
+}
+} // namespace
+
+int match(const Options &options)
+{
+    if (options.positional().size() != 2)
+        throw std::invalid_argument("expected two engines");
+    Settings settings;
+    settings.time_control = parse_time_control(options);
+    settings.resign_score = int(options.integer("resign", 0));
+    settings.max_plies = int(options.integer("max-plies", 0));
+    EngineConfig configs[2];
+    for (int i = 0; i < 2; ++i) {
+        configs[i].path = options.positional()[i];
+        configs[i].hash_mb = options.integer("hash", 16);
+        configs[i].threads = options.integer("engine-threads", 1);
+    }
+    // every game runs two single threaded engines, one of which searches at a time
+    const size_t concurrency = size_t(
+        std::max<int64_t>(1, options.integer("concurrency", std::max(1u, std::thread::hardware_concurrency()))));
+    const int games = int(std::max<int64_t>(1, options.integer("games", 100)));
+
+    std::vector<Opening> openings{{START_FEN, {}}};
+    if (options.has("openings")) {
+        openings = read_openings(options.value("openings"), int(options.integer("plies", 0)));
+        if (options.has("seed")) {
+            std::mt19937_64 random(uint64_t(options.integer("seed", 0)));
+            std::shuffle(openings.begin(), openings.end(), random);
+        }
+    }
+
+    std::optional<std::pair<double, double>> sprt;
+    if (options.has("sprt")) {
+        const std::string bounds = options.value("sprt");
+        const size_t comma = bounds.find(',');
+        if (comma == std::string::npos)
+            throw std::invalid_argument("expected --sprt elo0,elo1");
+        sprt = {std::stod(bounds.substr(0, comma)), std::stod(bounds.substr(comma + 1))};
+    }
+    const double alpha = options.real("alpha", 0.05), beta = options.real("beta", 0.05);
+    const double lower_bound = std::log(beta / (1 - alpha)), upper_bound = std::log((1 - beta) / alpha);
+
+    std::ofstream pgn_out;
+    if (options.has("pgn-out")) {
+        pgn_out.open(options.value("pgn-out"));
+        if (!pgn_out)
+            throw std::runtime_error("cannot open " + options.value("pgn-out"));
+    }
+#ifdef __unix__
+    // an engine that exits while it is written to must not take the match down with it
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+    std::mutex mutex;
+    Statistics stats;
+    std::string names = configs[0].path + " vs " + configs[1].path;
+    std::atomic<int> next{0};
+    std::atomic<bool> stop{false};
+    std::string sprt_result;
+    const auto start = Clock::now();
+
+    // Game i plays opening i / 2, the engines swap colors between the two games of a pair so that the openings'
+    // bias cancels out. Every slot keeps both engines running between its games.
+    const auto play_slot = [&] {
+        UciPlayer first(configs[0]), second(configs[1]);
+        for (int game; !stop && (game = next++) < games;) {
+            const bool first_white = game % 2 == 0;
+            UciPlayer *players[2] = {first_white ? &first : &second, first_white ? &second : &first};
+            GameResult result = play_game(players, openings[size_t(game / 2) % openings.size()], settings);
+            const int first_score2 = first_white ? result.white_score2 : 2 - result.white_score2;
+
+            std::lock_guard lock(mutex);
+            stats.wins += first_score2 == 2;
+            stats.draws += first_score2 == 1;
+            stats.losses += first_score2 == 0;
+            names = first.name() + " vs " + second.name();
+            const char *result_text = result.white_score2 == 2 ? "1-0" : result.white_score2 == 1 ? "1/2-1/2" : "0-1";
+            std::fprintf(stderr, "game %d: %s - %s %s (%s)\n", game + 1, players[0]->name().c_str(),
+                         players[1]->name().c_str(), result_text, result.reason.c_str());
+            std::fprintf(stderr, "%s  %.1f games/min\n", summary(stats, names).c_str(),
+                         stats.games() * 60.0 /
+                             std::max(1e-3, std::chrono::duration<double>(Clock::now() - start).count()));
+            if (pgn_out.is_open()) {
+                result.pgn.result = result_text;
+                result.pgn.tags = {{"Event", "chesscli match"},
+                                   {"Round", std::to_string(game + 1)},
+                                   {"White", players[0]->name()},
+                                   {"Black", players[1]->name()},
+                                   {"Result", result_text},
+                                   {"Termination", result.reason}};
+                if (result.pgn.game.start_fen() != START_FEN) {
+                    result.pgn.tags.emplace_back("SetUp", "1");
+                    result.pgn.tags.emplace_back("FEN", result.pgn.game.start_fen());
+                }
+                db::write_pgn(pgn_out, result.pgn);
+                pgn_out.flush();
+            }
+            if (sprt && sprt_result.empty()) {
+                const double llr = stats.llr(sprt->first, sprt->second);
+                std::fprintf(stderr, "sprt llr %.2f (%.2f, %.2f)\n", llr, lower_bound, upper_bound);
+                if (llr >= upper_bound || llr <= lower_bound) {
+                    sprt_result = llr >= upper_bound ? "H1 accepted" : "H0 accepted";
+                    stop = true;
+                }
+            }
+        }
+    };
+    std::exception_ptr error;
+    const auto slot = [&] {
+        try {
+            play_slot();
+        } catch (...) {
+            std::lock_guard lock(mutex);
+            error = std::current_exception();
+            stop = true;
+        }
+    };
+    std::vector<std::thread> slots;
+    for (size_t i = 0; i < std::min(concurrency, size_t(games)); ++i)
+        slots.emplace_back(slot);
+    for (auto &thread : slots)
+        thread.join();
+    if (error)
+        std::rethrow_exception(error);
+
+    std::cout << summary(stats, names) << "\n";
+    if (sprt) {
+        std::cout << "sprt elo0 " << sprt->first << " elo1 " << sprt->second << ": llr " << stats.llr(sprt->first,
+                                                                                                   sprt->second)
+                  << ", " << (sprt_result.empty() ? "no decision" : sprt_result) << "\n";
+    }
+    return 0;
+}
+
+} // namespace cli
@@ -0,0 +1,98 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "commands.hxx"
+#include "nnue.hxx"
+
+namespace cli {
+namespace {
+struct Line
+{
+    db::Position start;
+    std::vector<db::Move> moves;
+    std::vector<db::Position> positions; // after each move
+};
+
+std::vector<Line> random_lines(size_t position_count)
+{
+    std::mt19937_64 random(1);
+    std::vector<Line> lines;
+    size_t count = 0;
+    db::Board board;
+    while (count < position_count) {
+        board.set_fen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+        Line line;
+        line.start = board.get_position();
+        for (int ply = 0; ply < 120 && count < position_count; ++ply, ++count) {
+            std::vector<db::Move> moves = board.generate_moves();
+            if (moves.empty())
+                break;
+            line.moves.push_back(moves[random() % moves.size()]);
+            board.do_move(line.moves.back());
+            line.positions.push_back(board.get_position());
+        }
+        lines.push_back(std::move(line));
+    }
+    return lines;
+}
+} // namespace
+
+int nnue_bench(const Options &options)
+{
+    using namespace engine::nnue;
+    std::unique_ptr<Network> network = options.has("net") ? Network::load(options.value("net")) : Network::random(1);
+    if (options.has("save"))
+        network->save(options.value("save"));
+    const size_t position_count = size_t(std::max<int64_t>(1, options.integer("positions", 20000)));
+    const std::vector<Line> lines = random_lines(position_count);
+
+    // every incremental result must match a refresh, including after taking moves back to the middle of a line
+    size_t mismatches = 0;
+    Evaluator evaluator(*network);
+    for (const auto &line : lines) {
+        evaluator.reset(line.start);
+        for (size_t i = 0; i < line.moves.size(); ++i) {
+            evaluator.push(line.moves[i]);
+            mismatches += evaluator.evaluate(line.positions[i]) !=
+                          Evaluator::evaluate_from_scratch(*network, line.positions[i]);
+        }
+        for (size_t i = line.moves.size(); i > line.moves.size() / 2; --i)
+            evaluator.pop();
+        if (line.moves.size() >= 2) {
+            const db::Position &middle = line.positions[line.moves.size() / 2 - 1];
+            mismatches += evaluator.evaluate(middle) != Evaluator::evaluate_from_scratch(*network, middle);
+        }
+    }
+
+    int64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto &line : lines) {
+        evaluator.reset(line.start);
+        for (size_t i = 0; i < line.moves.size(); ++i) {
+            evaluator.push(line.moves[i]);
+            checksum += evaluator.evaluate(line.positions[i]);
+        }
+    }
+    const double incremental =
+        std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / position_count;
+
+    start = std::chrono::steady_clock::now();
+    for (const auto &line : lines) {
+        for (const auto &position : line.positions)
+            checksum += Evaluator::evaluate_from_scratch(*network, position);
+    }
+    const double scratch =
+        std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / position_count;
+
+    std::printf("kernels %s, %s network, %zu positions, %zu mismatches\n", kernel_name(),
+                options.has("net") ? (network->is_mapped() ? "mapped" : "loaded") : "random", position_count,
+                mismatches);
+    std::printf("incremental  %8.1f ns  %10.0f evaluations/s\n", incremental, 1e9 / incremental);
+    std::printf("refresh      %8.1f ns  %10.0f evaluations/s\n", scratch, 1e9 / scratch);
+    std::printf("checksum %lld\n", (long long)checksum);
+    return mismatches == 0 ? 0 : 1;
+}
+
+} // namespace cli
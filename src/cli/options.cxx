@@ -0,0 +1,45 @@
+#include "options.hxx"
+
+namespace cli {
+
+Options::Options(int argc, char *argv[], const std::set<std::string> &flags)
+{
+    for (int i = 0; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.size() > 2 && arg.starts_with("--")) {
+            std::string name = arg.substr(2);
+            // a following argument is the value unless it is an option itself
+            if (!flags.contains(name) && i + 1 < argc && !std::string(argv[i + 1]).starts_with("--"))
+                m_values[name] = argv[++i];
+            else
+                m_values[name];
+        } else {
+            m_positional.push_back(std::move(arg));
+        }
+    }
+}
+
+std::string Options::value(const std::string &name, const std::string &fallback) const
+{
+    auto it = m_values.find(name);
+    return it == m_values.end() || it->second.empty() ? fallback : it->second;
+}
+
+int64_t Options::integer(const std::string &name, int64_t fallback) const
+{
+    auto it = m_values.find(name);
+    return it == m_values.end() || it->second.empty() ? fallback : std::stoll(it->second);
+}
+
+double Options::real(const std::string &name, double fallback) const
+{
+    auto it = m_values.find(name);
+    return it == m_values.end() || it->second.empty() ? fallback : std::stod(it->second);
+}
+
+std::string Options::positional(size_t index, const std::string &fallback) const
+{
+    return index < m_positional.size() ? m_positional[index] : fallback;
+}
+
+} // namespace cli
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace cli {
+// Command line of a subcommand: "--name value" pairs, "--name" flags and positional arguments in order. Names listed
+// in flags never take a value so that a positional argument may follow them.
+class Options
+{
+public:
+    Options(int argc, char *argv[], const std::set<std::string> &flags = {});
+
+    [[nodiscard]] bool has(const std::string &name) const { return m_values.contains(name); }
+    [[nodiscard]] std::string value(const std::string &name, const std::string &fallback = {}) const;
+    [[nodiscard]] int64_t integer(const std::string &name, int64_t fallback) const;
+    [[nodiscard]] double real(const std::string &name, double fallback) const;
+    [[nodiscard]] const std::vector<std::string> &positional() const { return m_positional; }
+    // positional argument at index, fallback if there are fewer
+    [[nodiscard]] std::string positional(size_t index, const std::string &fallback) const;
+
+private:
+    std::map<std::string, std::string> m_values;
+    std::vector<std::string> m_positional;
+};
+} // namespace cli
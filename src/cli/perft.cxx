@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "commands.hxx"
+#include "packedposition.hxx"
+#include "uci.hxx"
+
+namespace cli {
+namespace {
+constexpr int MAX_DEPTH = 5;
+
+struct PerftCase
+{
+    const char *fen;
+    uint64_t nodes[MAX_DEPTH]; // leaf counts at depth 1 to 5
+};
+
+const PerftCase perft_cases[] = {
+    {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", {20, 400, 8902, 197281, 4865609}},
+    // Kiwipete: castling both ways, en passant and promotions within a few plies
+    {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", {48, 2039, 97862, 4085603, 193690690}},
+    // Chess960, with kings and rooks that start off their standard squares
+    {"bqnb1rkr/pp3ppp/3ppn2/2p5/5P2/P2P4/NPP1P1PP/BQ1BNRKR w HFhf - 2 9", {21, 528, 12189, 326672, 8146062}},
+    {"2nnrbkr/p1qppppp/8/1ppb4/6PP/3PP3/PPP2P2/BQNNRBKR w HEhe - 1 9", {21, 807, 18002, 667366, 16253601}},
+    {"b1q1rrkb/pppppppp/3nn3/8/P7/1PPP4/4PPPP/BQNNRKRB w GE - 1 9", {20, 479, 10471, 273318, 6417013}},
+    {"1rqbkrbn/1ppppp1p/1n6/p1N3p1/8/2P4P/PP1PPPP1/1RQBKRBN w FBfb - 0 9", {29, 502, 14569, 287739, 8652810}},
+    {"rbbqn1kr/pp2p1pp/6n1/2pp1p2/2P4P/P7/BP1PPPP1/R1BQNNKR w HAha - 0 9", {27, 916, 25798, 890435, 26302461}},
+};
+
+uint64_t perft(db::Board &board, int depth)
+{
+    std::vector<db::Move> moves = board.generate_moves();
+    if (depth == 1)
+        return moves.size();
+    uint64_t nodes = 0;
+    for (const auto &move : moves) {
+        board.do_move(move);
+        nodes += perft(board, depth - 1);
+        board.undo_move(move);
+    }
+    return nodes;
+}
+
+// Walks the tree like perft and checks every move on the way: both UCI forms and a move as the GUI enters it (from
+// and to only) lead back to it, the FEN and the packed record of the position after it read back to the same
+// position, and undo_move restores the position before. Returns the number of failures, the first few are printed.
+class RoundTrips
+{
+public:
+    size_t run(db::Board &board, int depth)
+    {
+        std::vector<db::Move> moves = board.generate_moves();
+        for (const auto &move : moves) {
+            const uint64_t key = board.get_position().key();
+            const std::string fen = board.get_fen();
+            check_move(board, move, fen);
+            board.do_move(move);
+            check_position(board);
+            if (depth > 1)
+                run(board, depth - 1);
+            board.undo_move(move);
+            if (board.get_position().key() != key || board.get_fen() != fen)
+                fail("undo_move", fen, move);
+        }
+        return m_failures;
+    }
+
+private:
+    void fail(const char *what, const std::string &fen, const db::Move &move)
+    {
+        if (m_failures++ < 10)
+            std::printf("FAIL %s: %s %s\n", what, fen.c_str(), engine::uci::move_to_uci(move, true).c_str());
+    }
+
+    void check_move(db::Board &board, const db::Move &move, const std::string &fen)
+    {
+        for (const bool chess960 : {false, true}) {
+            const db::Move parsed = engine::uci::move_from_uci(board, engine::uci::move_to_uci(move, chess960));
+            if (!parsed.is_legal || parsed.from != move.from || parsed.to != move.to ||
+                parsed.promoted != move.promoted || parsed.is_castling != move.is_castling)
+                fail(chess960 ? "uci (chess960)" : "uci", fen, move);
+        }
+        db::Move entered;
+        entered.from = move.from;
+        entered.to = move.to;
+        entered.piece_moved = move.piece_moved;
+        entered.captured = board.get_piece_at(move.to);
+        entered.color = move.color;
+        entered.promoted = move.promoted;
+        const db::Move prepared = board.prepare_move(entered);
+        if (!prepared.is_legal || prepared.is_castling != move.is_castling)
+            fail("prepare_move", fen, move);
+    }
+
+    void check_position(db::Board &board)
+    {
+        const db::Position &position = board.get_position();
+        const std::string fen = board.get_fen();
+        db::Position unpacked;
+        if (!db::PackedPosition::pack(position).unpack(unpacked)) {
+            fail("unpack", fen, db::Move{});
+        } else {
+            m_scratch.update_attacks(unpacked);
+            if (m_scratch.get_fen(unpacked) != fen || unpacked.key() != position.key())
+                fail("pack", fen, db::Move{});
+        }
+        db::Position parsed;
+        bool same = m_scratch.parse_fen(fen, parsed, nullptr) == db::FenError::NONE &&
+                    m_scratch.validate(parsed) == db::FenError::NONE && parsed.key() == position.key();
+        // rooks of rights that are gone are not written to the FEN
+        for (int right = 0; right < 4; ++right)
+            same = same && (!(position.castling_rights >> right & 1) ||
+                            parsed.castling_rooks[right] == position.castling_rooks[right]);
+        if (!same)
+            fail("fen", fen, db::Move{});
+    }
+
+    db::Board m_scratch;
+    size_t m_failures{0};
+};
+} // namespace
+
+int perft(const Options &options)
+{
+    const int depth = int(std::clamp<int64_t>(options.integer("depth", 4), 1, MAX_DEPTH));
+    const int check_depth = int(std::clamp<int64_t>(options.integer("check", 2), 0, MAX_DEPTH));
+
+    size_t failures = 0;
+    uint64_t total_nodes = 0;
+    double total_seconds = 0;
+    db::Board board;
+    for (const auto &test : perft_cases) {
+        board.set_fen(test.fen);
+        const auto start = std::chrono::steady_clock::now();
+        const uint64_t nodes = perft(board, depth);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        total_nodes += nodes;
+        total_seconds += seconds;
+        const uint64_t expected = test.nodes[depth - 1];
+        if (nodes != expected) {
+            ++failures;
+            std::printf("FAIL %s depth %d: expected %llu, got %llu\n", test.fen, depth, (unsigned long long)expected,
+                        (unsigned long long)nodes);
+        }
+        size_t round_trip_failures = 0;
+        if (check_depth > 0) {
+            RoundTrips round_trips;
+            round_trip_failures = round_trips.run(board, check_depth);
+            failures += round_trip_failures;
+        }
+        std::printf("%-72s %10llu nodes %7.1f Mnps, %zu round trip failures\n", test.fen, (unsigned long long)nodes,
+                    nodes / seconds / 1e6, round_trip_failures);
+    }
+    std::printf("%zu positions at depth %d, %zu failed, %.1f Mnps overall\n", std::size(perft_cases), depth,
+                failures, total_nodes / total_seconds / 1e6);
+    return failures == 0 ? 0 : 1;
+}
+
+} // namespace cli
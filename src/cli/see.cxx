@@ -0,0 +1,80 @@
+#include <chrono>
+#include <cstdio>
+
+#include "commands.hxx"
+#include "uci.hxx"
+
+namespace cli {
+namespace {
+struct SeeCase
+{
+    const char *fen;
+    const char *move;
+    int value; // with pawn 100, knight 320, bishop 330, rook 500, queen 900
+};
+
+const SeeCase see_cases[] = {
+    // undefended pawn
+    {"1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1", "e1e5", 100},
+    // pawn takes a knight defended by a pawn
+    {"4k3/8/3p4/4n3/3P4/8/8/4K3 w - - 0 1", "d4e5", 220},
+    // queen takes a pawn defended by a pawn
+    {"4k3/8/3p4/4p3/8/8/4Q3/4K3 w - - 0 1", "e2e5", -800},
+    {"4k3/8/8/3q4/4P3/5P2/8/4K3 b - - 0 1", "d5e4", -800},
+    // rook battery: the second rook only attacks once the first one has captured
+    {"4k3/4r3/8/4p3/8/8/4R3/4R1K1 w - - 0 1", "e2e5", 100},
+    // bishop battery, still losing the bishop for two pawns
+    {"3k4/8/3p4/4p3/8/2B5/1B6/4K3 w - - 0 1", "c3e5", -130},
+    // bishop behind the capturing pawn makes the recapture pointless
+    {"4k3/8/3p4/4n3/3P4/2B5/8/4K3 w - - 0 1", "d4e5", 320},
+    // knight takes a rook defended by a knight
+    {"4k3/8/2n5/4r3/8/3N4/8/4K3 w - - 0 1", "d3e5", 180},
+    // rook takes a knight defended by a pawn
+    {"4k3/8/5p2/4n3/8/8/8/4R1K1 w - - 0 1", "e1e5", -180},
+    // en passant
+    {"4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1", "e5d6", 100},
+    // capturing promotion, undefended and recaptured by the king
+    {"1r2k3/P7/8/8/8/8/8/4K3 w - - 0 1", "a7b8q", 1300},
+    {"1r6/P1k5/8/8/8/8/8/4K3 w - - 0 1", "a7b8q", 400},
+    // the king captures last, once nothing defends the square any more
+    {"4k3/8/8/8/8/8/3r4/2R1K3 w - - 0 1", "e1d2", 500},
+    {"4k3/8/8/8/3r4/8/3r4/3RK3 w - - 0 1", "d1d2", 500},
+    // quiet move to a square attacked by a pawn
+    {"4k3/8/3p4/8/8/5N2/8/4K3 w - - 0 1", "f3e5", -320},
+    // quiet move to a square attacked and defended by pawns
+    {"4k3/8/3p4/8/3P4/5N2/8/4K3 w - - 0 1", "f3e5", -220},
+};
+} // namespace
+
+int see(const Options &)
+{
+    int failures = 0;
+    db::Board board;
+    for (const auto &test : see_cases) {
+        board.set_fen(test.fen);
+        db::Move move = engine::uci::move_from_uci(board, test.move);
+        int value = move.is_legal ? board.see(move) : 0;
+        if (!move.is_legal || value != test.value) {
+            ++failures;
+            std::printf("FAIL %s %s: expected %d, got %s%d\n", test.fen, test.move, test.value,
+                        move.is_legal ? "" : "illegal move ", value);
+        }
+    }
+
+    // cost per call over the whole set
+    constexpr int rounds = 20000;
+    int64_t sum = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto &test : see_cases) {
+        board.set_fen(test.fen);
+        db::Move move = engine::uci::move_from_uci(board, test.move);
+        for (int i = 0; i < rounds; ++i)
+            sum += board.see(move);
+    }
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%zu positions, %d failed, %.1f ns per see (checksum %lld)\n", std::size(see_cases), failures,
+                ns / (rounds * std::size(see_cases)), (long long)sum);
+    return failures == 0 ? 0 : 1;
+}
+
+} // namespace cli
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "commands.hxx"
+#include "smpsearch.hxx"
+
+namespace cli {
+namespace {
+const char *const bench_positions[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP3PPP/R2QKB1R w KQ - 0 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+};
+
+std::vector<size_t> parse_thread_counts(const std::string &text)
+{
+    std::vector<size_t> counts;
+    std::istringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ','))
+        counts.push_back(size_t(std::max(1, std::stoi(item))));
+    if (counts.empty())
+        throw std::invalid_argument("no thread counts given");
+    return counts;
+}
+} // namespace
+
+int smp_bench(const Options &options)
+{
+    const int depth = int(options.integer("depth", 7));
+    const size_t hash_mb = size_t(std::max<int64_t>(1, options.integer("hash", 64)));
+    const std::vector<size_t> thread_counts = parse_thread_counts(options.value("threads", "1,2,4,8,16"));
+
+    // time to depth over the whole set, with a cleared table for every thread count so that runs do not help each
+    // other; speedup is relative to the first thread count
+    double base_ms = 0;
+    std::printf("%7s %10s %8s %12s %10s  %s\n", "threads", "time ms", "speedup", "nodes", "knps", "nodes per thread");
+    for (size_t threads : thread_counts) {
+        engine::SmpSearch search(threads, hash_mb);
+        std::vector<uint64_t> thread_nodes(threads, 0);
+        uint64_t nodes = 0;
+        double ms = 0;
+        for (const char *fen : bench_positions) {
+            db::Board board;
+            board.set_fen(fen);
+            search.transposition_table().clear();
+            search.set_position(board.get_position());
+            std::atomic<bool> stop{false};
+            engine::SearchLimits limits;
+            limits.depth = depth;
+            const auto start = std::chrono::steady_clock::now();
+            engine::SearchInfo info = search.go(limits, stop);
+            ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            nodes += info.nodes;
+            std::vector<uint64_t> per_thread = search.thread_nodes();
+            for (size_t i = 0; i < threads; ++i)
+                thread_nodes[i] += per_thread[i];
+        }
+        if (base_ms == 0)
+            base_ms = ms;
+        std::printf("%7zu %10.0f %8.2f %12llu %10.0f ", threads, ms, base_ms / ms, (unsigned long long)nodes,
+                    nodes / std::max(ms, 1e-3));
+        for (uint64_t n : thread_nodes)
+            std::printf(" %llu", (unsigned long long)n);
+        std::printf("\n");
+        std::fflush(stdout);
+    }
+    return 0;
+}
+
+} // namespace cli
@@ -0,0 +1,150 @@
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "commands.hxx"
+#include "tbgen.hxx"
+
+namespace cli {
+namespace {
+using engine::tb::ProbeResult;
+using engine::tb::Wdl;
+
+// the color flipped position: colors swapped, ranks mirrored and the other side to move
+db::Position flip(db::Board &board, const db::Position &position)
+{
+    db::Position flipped;
+    for (int square = db::A1; square <= db::H8; ++square) {
+        const db::Piece piece = position.board[square];
+        if (piece != db::PIECE_NONE)
+            board.set_piece_at(db::make_piece(db::type_of(piece), db::opposite(db::color_of(piece))),
+                               db::Square(square ^ 56), flipped);
+    }
+    flipped.stm = db::opposite(position.stm);
+    board.update_attacks(flipped);
+    return flipped;
+}
+
+// Compares random positions of the table with what their moves lead to, one ply deep through the probing code: the
+// result must be the best one of the moves and the dtz must follow from theirs. Returns the number of mismatches.
+size_t check_table(const engine::tb::Layout &layout, const engine::tb::Tablebases &tablebases, size_t samples)
+{
+    std::mt19937_64 random(layout.material_key());
+    db::Board board;
+    size_t mismatches = 0;
+    for (size_t checked = 0; checked < samples;) {
+        db::Square squares[engine::tb::MAX_PIECES];
+        if (!layout.decode(random() % layout.size(), squares))
+            continue;
+        db::Position position;
+        for (size_t i = 0; i < layout.pieces().size(); ++i)
+            board.set_piece_at(layout.pieces()[i], squares[i], position);
+        position.stm = random() % 2 ? db::WHITE : db::BLACK;
+        board.update_attacks(position);
+        const db::Bitboard king = position.by_type[db::KING] & position.by_color[db::opposite(position.stm)];
+        if (board.attackers_to(db::Square(std::countr_zero(king)), position.by_color[0] | position.by_color[1],
+                               position) &
+            position.by_color[position.stm])
+            continue;
+        ++checked;
+
+        ProbeResult expected{Wdl::LOSS, 0};
+        const std::vector<db::Move> moves = board.generate_moves(position);
+        if (moves.empty() && !(position.by_type[db::KING] & position.by_color[position.stm] &
+                               position.attacks[db::opposite(position.stm)]))
+            expected = {};
+        for (const auto &move : moves) {
+            // the tables leave en passant captures after a double push aside
+            db::Position after = board.test_move(move, position);
+            after.ep = db::SQUARE_NONE;
+            const std::optional<ProbeResult> child = tablebases.probe(after);
+            if (!child)
+                throw std::runtime_error("a table " + layout.name() + " depends on is missing");
+            const Wdl wdl = Wdl(-int(child->wdl));
+            const bool zeroing = move.captured != db::PIECE_NONE || db::type_of(move.piece_moved) == db::PAWN;
+            const int dtz = std::min(zeroing ? 1 : child->dtz + 1, engine::tb::MAX_DTZ);
+            if (wdl > expected.wdl)
+                expected = {wdl, wdl == Wdl::DRAW ? 0 : dtz};
+            else if (wdl == expected.wdl && wdl == Wdl::WIN)
+                expected.dtz = std::min(expected.dtz, dtz);
+            else if (wdl == expected.wdl && wdl == Wdl::LOSS)
+                expected.dtz = std::max(expected.dtz, dtz);
+        }
+
+        const std::optional<ProbeResult> result = tablebases.probe(position);
+        const std::optional<ProbeResult> flipped = tablebases.probe(flip(board, position));
+        for (const auto &probed : {result, flipped}) {
+            if (!probed || probed->wdl != expected.wdl || probed->dtz != expected.dtz) {
+                if (mismatches++ < 10)
+                    std::printf("  mismatch %s: %d/%d expected %d/%d\n", board.get_fen(position).c_str(),
+                                probed ? int(probed->wdl) : 9, probed ? probed->dtz : -1, int(expected.wdl),
+                                expected.dtz);
+            }
+        }
+    }
+    return mismatches;
+}
+} // namespace
+
+int tb_gen(const Options &options)
+{
+    namespace fs = std::filesystem;
+    if (!options.has("out") || options.positional().empty())
+        throw std::invalid_argument("expected an output directory and the tables to generate");
+    const std::string directory = options.value("out");
+    const size_t threads =
+        size_t(std::max<int64_t>(1, options.integer("threads", std::max(1u, std::thread::hardware_concurrency()))));
+    const size_t samples = size_t(std::max<int64_t>(0, options.integer("check", 0)));
+    fs::create_directories(directory);
+
+    engine::tb::Tablebases tablebases;
+    tablebases.add_directory(directory);
+    size_t mismatches = 0;
+    // the tables a capture or promotion leads to come first
+    std::function<void(const engine::tb::Layout &)> generate = [&](const engine::tb::Layout &layout) {
+        const std::string path = (fs::path(directory) / (layout.name() + ".ctb")).string();
+        if (fs::exists(path))
+            return;
+        for (const auto &dependency : engine::tb::Generator::dependencies(layout))
+            generate(dependency);
+        tablebases.add_directory(directory);
+
+        const auto start = std::chrono::steady_clock::now();
+        engine::tb::Generator generator(layout, tablebases, threads);
+        const engine::tb::Generator::Stats stats = generator.run();
+        const uint64_t bytes =
+            engine::tb::write_table(path, layout, generator.values(db::WHITE), generator.values(db::BLACK));
+        const double seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::printf("%-8s %12llu positions  %5.1f%% won  %5.1f%% drawn  %5.1f%% lost  %3d+%3d iterations  %8.1f s  "
+                    "%10llu bytes (%.1f%% of raw)\n",
+                    layout.name().c_str(), (unsigned long long)stats.positions, 100.0 * stats.wins / stats.positions,
+                    100.0 * stats.draws / stats.positions, 100.0 * stats.losses / stats.positions,
+                    stats.wdl_iterations, stats.dtz_iterations, seconds, (unsigned long long)bytes,
+                    100.0 * bytes / (2 * layout.size()));
+        std::fflush(stdout);
+
+        if (samples) {
+            tablebases.add_directory(directory);
+            const size_t table_mismatches = check_table(layout, tablebases, samples);
+            std::printf("%-8s %zu positions checked, %zu mismatches\n", layout.name().c_str(), samples,
+                        table_mismatches);
+            mismatches += table_mismatches;
+        }
+    };
+
+    for (const auto &name : options.positional()) {
+        const std::optional<engine::tb::Layout> layout = engine::tb::Layout::parse(name);
+        if (!layout)
+            throw std::invalid_argument(name + " is not a material like KRPvKR");
+        generate(*layout);
+    }
+    return mismatches == 0 ? 0 : 1;
+}
+
+} // namespace cli
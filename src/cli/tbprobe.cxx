@@ -0,0 +1,65 @@
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "commands.hxx"
+#include "tablebase.hxx"
+
+namespace cli {
+namespace {
+std::string describe(const std::optional<engine::tb::ProbeResult> &result)
+{
+    using engine::tb::Wdl;
+    if (!result)
+        return "not in the tables";
+    if (result->wdl == Wdl::DRAW)
+        return "draw";
+    return std::string(result->wdl == Wdl::WIN ? "win" : "loss") + ", dtz " + std::to_string(result->dtz);
+}
+} // namespace
+
+int tb_probe(const Options &options)
+{
+    if (!options.has("tb"))
+        throw std::invalid_argument("expected a tablebase directory with --tb");
+    engine::tb::Tablebases tablebases;
+    const size_t tables = tablebases.add_directory(options.value("tb"));
+    std::printf("%zu tables, up to %d pieces\n", tables, tablebases.max_pieces());
+
+    std::vector<std::string> fens = options.positional();
+    if (fens.empty()) {
+        for (std::string line; std::getline(std::cin, line);) {
+            if (!line.empty())
+                fens.push_back(line);
+        }
+    }
+
+    db::Board board;
+    for (const auto &fen : fens) {
+        if (!board.set_fen(fen)) {
+            std::printf("%s: invalid fen\n", fen.c_str());
+            continue;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        const std::optional<engine::tb::ProbeResult> result = tablebases.probe(board.get_position());
+        const double micros =
+            std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        std::printf("%s: %s (%.1f us)\n", fen.c_str(), describe(result).c_str(), micros);
+        if (!options.has("moves") || !result)
+            continue;
+        // results of the moves from the opponent's point of view
+        for (db::Move move : board.generate_moves()) {
+            board.prepare_for_print(move);
+            const std::string san = move.to_san();
+            board.do_move(move);
+            std::printf("    %-8s %s\n", san.c_str(), describe(tablebases.probe(board.get_position())).c_str());
+            board.undo_move(move);
+        }
+    }
+    return 0;
+}
+
+} // namespace cli
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "commands.hxx"
+#include "transpositiontable.hxx"
+
+namespace cli {
+namespace {
+uint64_t mix(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// every field of the entry follows from the key, a probe that returns anything else has read a torn slot
+engine::TTEntry entry_for(uint64_t key)
+{
+    uint64_t bits = mix(key);
+    engine::TTEntry entry;
+    entry.from = db::Square(bits & 63);
+    entry.to = db::Square((bits >> 6) & 63);
+    entry.promoted = (bits >> 12) & 1 ? db::QUEEN : db::PIECE_TYPE_NONE;
+    entry.bound = engine::Bound(1 + (bits >> 13) % 3);
+    entry.depth = int((bits >> 16) & 63);
+    entry.score = int16_t(bits >> 32);
+    return entry;
+}
+
+bool same_entry(const engine::TTEntry &lhs, const engine::TTEntry &rhs)
+{
+    return lhs.from == rhs.from && lhs.to == rhs.to && lhs.promoted == rhs.promoted && lhs.bound == rhs.bound &&
+           lhs.depth == rhs.depth && lhs.score == rhs.score;
+}
+} // namespace
+
+int tt_stress(const Options &options)
+{
+    // at least two threads, a single one could never observe a concurrent write
+    const int64_t cores = std::thread::hardware_concurrency();
+    const size_t threads = size_t(std::max<int64_t>(2, options.integer("threads", cores)));
+    const int64_t seconds = std::max<int64_t>(1, options.integer("seconds", 5));
+    const size_t hash_mb = size_t(std::max<int64_t>(1, options.integer("hash", 1)));
+    engine::TranspositionTable tt(hash_mb, options.has("huge-pages"));
+    // more keys than slots so that clusters are contended and overwritten all the time
+    const uint64_t key_count = tt.size() * 4;
+
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> probes{0};
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> stores{0};
+    std::atomic<uint64_t> torn{0};
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            uint64_t state = mix(t);
+            uint64_t local_probes = 0, local_hits = 0, local_stores = 0, local_torn = 0, rounds = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (int i = 0; i < 4096; ++i) {
+                    state = mix(state);
+                    const uint64_t key = mix((state % key_count) ^ 0x5555);
+                    if (state & (1ULL << 40)) {
+                        tt.store(key, entry_for(key));
+                        ++local_stores;
+                    } else {
+                        engine::TTEntry entry;
+                        ++local_probes;
+                        if (tt.probe(key, entry)) {
+                            ++local_hits;
+                            local_torn += !same_entry(entry, entry_for(key));
+                        }
+                    }
+                }
+                // aging runs concurrently with the readers as it would between searches
+                if (t == 0 && ++rounds % 16 == 0)
+                    tt.new_search();
+            }
+            probes += local_probes;
+            hits += local_hits;
+            stores += local_stores;
+            torn += local_torn;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    stop = true;
+    for (auto &worker : workers)
+        worker.join();
+
+    std::printf("threads %zu  slots %zu%s  stores %llu  probes %llu  hits %llu  hashfull %d  torn %llu\n", threads,
+                tt.size(), tt.uses_huge_pages() ? " (huge pages)" : "", (unsigned long long)stores.load(),
+                (unsigned long long)probes.load(), (unsigned long long)hits.load(), tt.hashfull(),
+                (unsigned long long)torn.load());
+    return torn == 0 ? 0 : 1;
+}
+
+} // namespace cli
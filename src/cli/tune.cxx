@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "commands.hxx"
+#include "tuner.hxx"
+
+namespace cli {
+namespace {
+// chunk files named on the command line, or found in the directories named there, in a stable order
+std::vector<std::string> chunk_paths(const std::vector<std::string> &arguments)
+{
+    std::vector<std::string> paths;
+    for (const auto &argument : arguments) {
+        if (!std::filesystem::is_directory(argument)) {
+            paths.push_back(argument);
+            continue;
+        }
+        std::vector<std::string> found;
+        for (const auto &entry : std::filesystem::directory_iterator(argument)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".bin")
+                found.push_back(entry.path().string());
+        }
+        std::sort(found.begin(), found.end());
+        paths.insert(paths.end(), found.begin(), found.end());
+    }
+    return paths;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+} // namespace
+
+int tune(const Options &options)
+{
+    if (options.positional().empty())
+        throw std::invalid_argument("expected training chunks or directories holding them");
+    engine::Tuner::Settings settings;
+    settings.mobility = options.has("mobility");
+    settings.lambda = std::clamp(options.real("lambda", 0.0), 0.0, 1.0);
+    settings.learning_rate = options.real("rate", 1.0);
+    settings.threads =
+        size_t(std::max<int64_t>(1, options.integer("threads", std::max(1u, std::thread::hardware_concurrency()))));
+    const int64_t epochs = std::max<int64_t>(0, options.integer("epochs", 500));
+    const int64_t report_every = std::max<int64_t>(1, options.integer("report", 10));
+    engine::Tuner tuner(settings);
+
+    auto start = std::chrono::steady_clock::now();
+    size_t records = 0;
+    for (const auto &path : chunk_paths(options.positional())) {
+        const std::vector<engine::TrainingRecord> chunk = engine::read_training_chunk(path);
+        records += chunk.size();
+        tuner.add(chunk);
+    }
+    if (tuner.size() == 0)
+        throw std::runtime_error("no positions to tune on");
+    std::fprintf(stderr, "%zu positions (%zu skipped) loaded in %.1fs\n", tuner.size(), records - tuner.size(),
+                 seconds_since(start));
+
+    start = std::chrono::steady_clock::now();
+    // a scaling fitted once keeps the errors of later runs over other data comparable
+    if (options.has("scaling")) {
+        const double scaling = options.real("scaling", 0.0);
+        if (scaling <= 0)
+            throw std::invalid_argument("the scaling must be positive");
+        tuner.set_scaling(scaling);
+    } else {
+        tuner.fit_scaling();
+    }
+    std::fprintf(stderr, "sigmoid scaling %.6f, error %.6f (%.1fs)\n", tuner.scaling(), tuner.error(),
+                 seconds_since(start));
+
+    start = std::chrono::steady_clock::now();
+    for (int64_t epoch = 1; epoch <= epochs; ++epoch) {
+        const double error = tuner.epoch();
+        if (epoch % report_every == 0 || epoch == epochs)
+            std::fprintf(stderr, "epoch %lld  error %.6f  %.2fs/epoch\n", (long long)epoch, error,
+                         seconds_since(start) / double(epoch));
+    }
+
+    if (options.has("out")) {
+        std::ofstream out(options.value("out"));
+        if (!out)
+            throw std::runtime_error("cannot open " + options.value("out"));
+        tuner.write(out);
+    } else {
+        tuner.write(std::cout);
+    }
+    return 0;
+}
+
+} // namespace cli
@@ -7,6 +7,9 @@
 #pragma once
 #include <stdint.h>
 #include <type_traits> //just for is_constant_evaluated
+#ifdef __AVX2__
+#include <immintrin.h> //_pext_u64
+#endif
 
 namespace Chess_Lookup {
 	static constexpr uint64_t SliderPext[] = {
@@ -1,5 +1,6 @@
 #include "bitboard.hxx"
 
+#include <array>
 #include <bit>
 #include <cstring>
 #include <iostream>
@@ -15,10 +16,53 @@ constexpr Bitboard not_gh_file = 4557430888798830399ULL;
 
 #define occupancy(position) ((position).by_color[WHITE] | (position).by_color[BLACK])
 
-constexpr Bitboard w_OO_mask = 0x60ULL;
-constexpr Bitboard w_OOO_mask = 0xeULL;
-constexpr Bitboard b_OO_mask = 0x6000000000000000ULL;
-constexpr Bitboard b_OOO_mask = 0xe00000000000000ULL;
+namespace {
+// Castling in standard chess and Chess960 alike, by king and rook file on the first rank (shifted up to the eighth
+// for black): the squares besides king and rook that king and rook cross or land on and that have to be empty, and
+// the squares from the king's start to its destination that must not be attacked.
+struct CastlingMasks
+{
+    Bitboard empty;
+    Bitboard safe;
+};
+constexpr auto castling_masks = [] {
+    std::array<std::array<CastlingMasks, 8>, 8> masks{};
+    const auto span = [](int a, int b) { return (2ULL << std::max(a, b)) - (1ULL << std::min(a, b)); };
+    for (int king = FILE_A; king <= FILE_H; ++king) {
+        for (int rook = FILE_A; rook <= FILE_H; ++rook) {
+            if (rook == king)
+                continue;
+            const bool king_side = rook > king;
+            const Bitboard king_path = span(king, king_side ? FILE_G : FILE_C);
+            const Bitboard rook_path = span(rook, king_side ? FILE_F : FILE_D);
+            masks[king][rook] = {(king_path | rook_path) & ~(1ULL << king | 1ULL << rook), king_path};
+        }
+    }
+    return masks;
+}();
+
+// the castling rights of position whose rook stands on square
+uint8_t castling_rights_of_rook(const Position &position, Square square)
+{
+    uint8_t rights = 0;
+    for (int index = 0; index < 4; ++index)
+        rights |= uint8_t(position.castling_rooks[index] == square) << index;
+    return rights & position.castling_rights;
+}
+
+// right is set and nothing stands in the way, the king may still end up in check
+bool castling_possible(const Position &position, uint8_t right)
+{
+    if (!(position.castling_rights & right))
+        return false;
+    const Color us = right & WHITE_CASTLING_ALL ? WHITE : BLACK;
+    const Square king = Square(std::countr_zero(position.by_type[KING] & position.by_color[us]));
+    const Square rook = position.castling_rook(right);
+    const CastlingMasks &masks = castling_masks[file_of(king)][file_of(rook)];
+    const int shift = us == WHITE ? 0 : 56;
+    return !(((masks.empty << shift) & occupancy(position)) | ((masks.safe << shift) & position.attacks[opposite(us)]));
+}
+} // namespace
 
 Board::Board()
 {
@@ -144,6 +188,12 @@ void Board::clear_square(Square square)
 {
     if (square == SQUARE_NONE)
         return;
+    if (const Piece piece = m_position.board[square]; piece != PIECE_NONE) {
+        m_position.piece_key ^= zobrist::piece_key(piece, square);
+        m_position.psqt_mg -= psqt::score(piece, square).mg;
+        m_position.psqt_eg -= psqt::score(piece, square).eg;
+        m_position.phase -= psqt::phase_weight[type_of(piece)];
+    }
     for (PieceType p = PAWN; p <= KING; ++p)
         m_position.by_type[p] &= ~square_bitboard(square);
     m_position.by_color[WHITE] &= ~square_bitboard(square);
@@ -154,6 +204,12 @@ void Board::clear_square(Square square, Position &position)
 {
     if (square == SQUARE_NONE)
         return;
+    if (const Piece piece = position.board[square]; piece != PIECE_NONE) {
+        position.piece_key ^= zobrist::piece_key(piece, square);
+        position.psqt_mg -= psqt::score(piece, square).mg;
+        position.psqt_eg -= psqt::score(piece, square).eg;
+        position.phase -= psqt::phase_weight[type_of(piece)];
+    }
     for (PieceType p = PAWN; p <= KING; ++p)
         position.by_type[p] &= ~square_bitboard(square);
     position.by_color[WHITE] &= ~square_bitboard(square);
@@ -162,21 +218,14 @@ void Board::clear_square(Square square, Position &position)
 }
 void Board::set_piece_at(Piece piece, Square square)
 {
-    clear_square(square);
-    if (piece == PIECE_NONE || square == SQUARE_NONE)
-        return;
-    m_position.by_type[type_of(piece)] |= square_bitboard(square);
-    m_position.by_color[color_of(piece)] |= square_bitboard(square);
-    m_position.board[square] = piece;
+    set_piece_at(piece, square, m_position);
 }
 void Board::set_piece_at(Piece piece, Square square, Position &position)
 {
     clear_square(square, position);
     if (piece == PIECE_NONE || square == SQUARE_NONE)
         return;
-    position.by_type[type_of(piece)] |= square_bitboard(square);
-    position.by_color[color_of(piece)] |= square_bitboard(square);
-    position.board[square] = piece;
+    position.add_piece(piece, square);
 }
 
 Piece Board::get_piece_at(Square square)
@@ -195,10 +244,15 @@ void Board::set_ep_square(Square square)
 
 bool Board::is_piece_attack(Square from, Square to)
 {
+    ++m_call_counters.is_piece_attack;
     Piece p = get_piece_at(from);
     bool legal = false;
     if (color_of(p) != m_position.stm)
         return false;
+    // a castling king move goes on as the king taking the rook it castles with
+    const Square rook = castling_rook(from, to);
+    if (rook != SQUARE_NONE)
+        to = rook;
     switch (p) {
         case WHITE_PAWN:
             legal = m_pawn_attacks[WHITE][from] & m_position.by_color[BLACK] & square_bitboard(to) |
@@ -234,28 +288,12 @@ bool Board::is_piece_attack(Square from, Square to)
                     ~m_position.by_color[color_of(p)];
             break;
         case WHITE_KING:
-            legal =
-                m_king_attacks[from] & square_bitboard(to) & ~m_position.attacks[BLACK] & ~m_position.by_color[WHITE] |
-                (square_bitboard(from) & ~m_position.attacks[BLACK] &&
-                 square_bitboard(to) & square_bitboard(C1) | square_bitboard(to) & square_bitboard(A1) &&
-                 m_position.castling_rights & WHITE_CASTLING_OOO &&
-                 !(w_OOO_mask & (occupancy(m_position)) | w_OOO_mask & m_position.attacks[BLACK])) |
-                (square_bitboard(from) & ~m_position.attacks[BLACK] &&
-                 square_bitboard(to) & square_bitboard(G1) | square_bitboard(to) & square_bitboard(H1) &&
-                 m_position.castling_rights & WHITE_CASTLING_OO &&
-                 !(w_OO_mask & (occupancy(m_position)) | w_OO_mask & m_position.attacks[BLACK]));
-            break;
         case BLACK_KING:
-            legal =
-                m_king_attacks[from] & square_bitboard(to) & ~m_position.attacks[WHITE] & ~m_position.by_color[BLACK] |
-                (square_bitboard(from) & ~m_position.attacks[WHITE] &&
-                 square_bitboard(to) & square_bitboard(C8) | square_bitboard(to) & square_bitboard(A8) &&
-                 m_position.castling_rights & BLACK_CASTLING_OOO &&
-                 !(b_OOO_mask & (occupancy(m_position)) | b_OOO_mask & m_position.attacks[WHITE])) |
-                (square_bitboard(from) & ~m_position.attacks[WHITE] &&
-                 square_bitboard(to) & square_bitboard(G8) | square_bitboard(to) & square_bitboard(H8) &&
-                 m_position.castling_rights & BLACK_CASTLING_OO &&
-                 !(b_OO_mask & (occupancy(m_position)) | b_OO_mask & m_position.attacks[WHITE]));
+            if (rook != SQUARE_NONE)
+                legal = castling_possible(m_position, castling_rights_of_rook(m_position, rook));
+            else
+                legal = m_king_attacks[from] & square_bitboard(to) & ~m_position.attacks[opposite(color_of(p))] &
+                        ~m_position.by_color[color_of(p)];
             break;
         case PIECE_NONE:
             legal = false;
@@ -277,13 +315,10 @@ bool Board::is_piece_attack(Square from, Square to)
     move.is_legal = legal;
     move.prev_ep = m_position.ep;
     move.castling_rights = m_position.castling_rights;
-    if (move.piece_moved == db::Piece::WHITE_KING && move.from == db::Square::E1 &&
-            (move.to == db::Square::A1 || move.to == db::Square::C1 || move.to == db::Square::H1 ||
-             move.to == db::Square::G1) ||
-        move.piece_moved == db::Piece::BLACK_KING && move.from == db::Square::E8 &&
-            (move.to == db::Square::A8 || move.to == db::Square::C8 || move.to == db::Square::H8 ||
-             move.to == db::Square::G8))
+    if (rook != SQUARE_NONE) {
+        move.captured = PIECE_NONE;
         move.is_castling = true;
+    }
     if (p == WHITE_PAWN)
         move.is_enpassant = square_bitboard(m_position.ep) & square_bitboard(to) &&
                             square_bitboard(from) << 7 & not_h_file & square_bitboard(m_position.ep) |
@@ -301,6 +336,23 @@ bool Board::is_piece_attack(Square from, Square to)
     }
     return legal;
 }
+Square Board::castling_rook(Square from, Square to) const
+{
+    const Piece king = m_position.board[from];
+    if (type_of(king) != KING || to == SQUARE_NONE)
+        return SQUARE_NONE;
+    const uint8_t rights =
+        m_position.castling_rights & (color_of(king) == WHITE ? WHITE_CASTLING_ALL : BLACK_CASTLING_ALL);
+    for (uint8_t right : {uint8_t(rights & CASTLING_OO), uint8_t(rights & CASTLING_OOO)}) {
+        if (!right)
+            continue;
+        const Square rook = m_position.castling_rook(right);
+        const Square king_to = make_square(right & CASTLING_OO ? FILE_G : FILE_C, rank_of(from));
+        if (to == rook || (to == king_to && std::abs(file_of(to) - file_of(from)) > 1))
+            return rook;
+    }
+    return SQUARE_NONE;
+}
 Move Board::prepare_move(Move move)
 {
     // Here we should test the move to see if it is legal
@@ -311,6 +363,12 @@ Move Board::prepare_move(Move move)
         move.is_legal = false;
         return move;
     }
+    const Square rook = castling_rook(from, to);
+    if (rook != SQUARE_NONE) {
+        move.to = rook;
+        move.captured = PIECE_NONE;
+        move.is_castling = true;
+    }
     if (move.piece_moved == WHITE_PAWN)
         move.is_enpassant = square_bitboard(m_position.ep) & square_bitboard(to) &&
                             square_bitboard(from) << 7 & not_h_file & square_bitboard(m_position.ep) |
@@ -334,6 +392,7 @@ bool Board::do_move(const Move &move)
 {
     if (!move.is_legal)
         return false;
+    m_history.push_back(m_position.key());
     // increment half move clock
     if (type_of(move.piece_moved) == PAWN || move.captured != PIECE_NONE)
         m_position.half_move_clock = 0;
@@ -356,61 +415,23 @@ bool Board::do_move(const Move &move)
     if (move.prev_ep == m_position.ep)
         m_position.ep = SQUARE_NONE;
 
-    // when a rook is move remove respective castling right
-    if (type_of(move.piece_moved) == ROOK) {
-        if (move.from == H1 && m_position.castling_rights & WHITE_CASTLING_OO)
-            m_position.castling_rights &= ~WHITE_CASTLING_OO;
-        else if (move.from == A1 && m_position.castling_rights & WHITE_CASTLING_OOO)
-            m_position.castling_rights &= ~WHITE_CASTLING_OOO;
-        else if (move.from == H8 && m_position.castling_rights & BLACK_CASTLING_OO)
-            m_position.castling_rights &= ~BLACK_CASTLING_OO;
-        else if (move.from == A8 && m_position.castling_rights & BLACK_CASTLING_OOO)
-            m_position.castling_rights &= ~BLACK_CASTLING_OOO;
-    }
-
-    // when a rook is captured remove respective castling right
-    if (type_of(move.captured) == ROOK) {
-        if (move.to == H1 && m_position.castling_rights & WHITE_CASTLING_OO)
-            m_position.castling_rights &= ~WHITE_CASTLING_OO;
-        else if (move.to == A1 && m_position.castling_rights & WHITE_CASTLING_OOO)
-            m_position.castling_rights &= ~WHITE_CASTLING_OOO;
-        else if (move.to == H8 && m_position.castling_rights & BLACK_CASTLING_OO)
-            m_position.castling_rights &= ~BLACK_CASTLING_OO;
-        else if (move.to == A8 && m_position.castling_rights & BLACK_CASTLING_OOO)
-            m_position.castling_rights &= ~BLACK_CASTLING_OOO;
-    }
+    // when a rook is moved or captured remove respective castling right
+    if (type_of(move.piece_moved) == ROOK)
+        m_position.castling_rights &= ~castling_rights_of_rook(m_position, move.from);
+    if (type_of(move.captured) == ROOK)
+        m_position.castling_rights &= ~castling_rights_of_rook(m_position, move.to);
 
     if (move.piece_moved == WHITE_KING)
         m_position.castling_rights &= ~WHITE_CASTLING_ALL;
     else if (move.piece_moved == BLACK_KING)
         m_position.castling_rights &= ~BLACK_CASTLING_ALL;
 
+    // in Chess960 the king or rook may land on the other's start square or stay where it is
     if (move.is_castling) {
-        if (move.to == A1 || move.to == C1) {
-            clear_square(A1);
-            clear_square(E1);
-            set_piece_at(WHITE_KING, C1);
-            set_piece_at(WHITE_ROOK, D1);
-            m_position.castling_rights &= ~WHITE_CASTLING_ALL;
-        } else if (move.to == H1 || move.to == G1) {
-            clear_square(H1);
-            clear_square(E1);
-            set_piece_at(WHITE_KING, G1);
-            set_piece_at(WHITE_ROOK, F1);
-            m_position.castling_rights &= ~WHITE_CASTLING_ALL;
-        } else if (move.to == A8 || move.to == C8) {
-            clear_square(A8);
-            clear_square(E8);
-            set_piece_at(BLACK_KING, C8);
-            set_piece_at(BLACK_ROOK, D8);
-            m_position.castling_rights &= ~BLACK_CASTLING_ALL;
-        } else if (move.to == H8 || move.to == G8) {
-            clear_square(H8);
-            clear_square(E8);
-            set_piece_at(BLACK_KING, G8);
-            set_piece_at(BLACK_ROOK, F8);
-            m_position.castling_rights &= ~BLACK_CASTLING_ALL;
-        }
+        clear_square(move.from);
+        clear_square(move.to);
+        set_piece_at(move.piece_moved, move.castling_king_to());
+        set_piece_at(make_piece(ROOK, move.color), move.castling_rook_to());
     }
 
     m_position.stm = opposite(m_position.stm);
@@ -444,16 +465,8 @@ Position Board::test_move(const Move &move, Position position)
     if (move.prev_ep == position.ep)
         position.ep = SQUARE_NONE;
 
-    if (type_of(move.piece_moved) == ROOK) {
-        if (move.from == H1 && position.castling_rights & WHITE_CASTLING_OO)
-            position.castling_rights &= ~WHITE_CASTLING_OO;
-        else if (move.from == A1 && position.castling_rights & WHITE_CASTLING_OOO)
-            position.castling_rights &= ~WHITE_CASTLING_OOO;
-        else if (move.from == H8 && position.castling_rights & BLACK_CASTLING_OO)
-            position.castling_rights &= ~BLACK_CASTLING_OO;
-        else if (move.from == A8 && position.castling_rights & BLACK_CASTLING_OOO)
-            position.castling_rights &= ~BLACK_CASTLING_OOO;
-    }
+    if (type_of(move.piece_moved) == ROOK)
+        position.castling_rights &= ~castling_rights_of_rook(position, move.from);
 
     if (move.piece_moved == WHITE_KING)
         position.castling_rights &= ~WHITE_CASTLING_ALL;
@@ -461,40 +474,10 @@ Position Board::test_move(const Move &move, Position position)
         position.castling_rights &= ~BLACK_CASTLING_ALL;
 
     if (move.is_castling) {
-        switch (move.to) {
-            case A1:
-            case C1:
-                clear_square(A1, position);
-                clear_square(E1, position);
-                set_piece_at(WHITE_KING, C1, position);
-                set_piece_at(WHITE_ROOK, D1, position);
-                position.castling_rights &= WHITE_CASTLING_ALL;
-                break;
-            case H1:
-            case G1:
-                clear_square(H1, position);
-                clear_square(E1, position);
-                set_piece_at(WHITE_KING, G1, position);
-                set_piece_at(WHITE_ROOK, F1, position);
-                position.castling_rights &= WHITE_CASTLING_ALL;
-                break;
-            case A8:
-            case C8:
-                clear_square(A8, position);
-                clear_square(E8, position);
-                set_piece_at(BLACK_KING, C8, position);
-                set_piece_at(BLACK_ROOK, D8, position);
-                position.castling_rights &= BLACK_CASTLING_ALL;
-                break;
-            case H8:
-            case G8:
-                clear_square(H8, position);
-                clear_square(E8, position);
-                set_piece_at(BLACK_KING, G8, position);
-                set_piece_at(BLACK_ROOK, F8, position);
-                position.castling_rights &= BLACK_CASTLING_ALL;
-                break;
-        }
+        clear_square(move.from, position);
+        clear_square(move.to, position);
+        set_piece_at(move.piece_moved, move.castling_king_to(), position);
+        set_piece_at(make_piece(ROOK, move.color), move.castling_rook_to(), position);
     }
     position.stm = opposite(position.stm);
     if (!move.is_castling && !move.is_enpassant) {
@@ -513,43 +496,21 @@ bool Board::undo_move(const Move &move)
 {
     if (!move.is_legal)
         return false;
-    set_piece_at(move.piece_moved, move.from);
-    if (!move.is_enpassant)
-        set_piece_at(move.captured, move.to);
-    else {
-        clear_square(move.to);
-        set_piece_at(move.captured, move.color == BLACK ? Square(move.to + 8) : Square(move.to - 8));
-    }
-
+    // the board may have been set to a position after the move, then there is no key to take back
+    if (!m_history.empty())
+        m_history.pop_back();
     if (move.is_castling) {
-        switch (move.to) {
-            case A1:
-            case C1:
-                clear_square(C1);
-                clear_square(D1);
-                set_piece_at(WHITE_KING, E1);
-                set_piece_at(WHITE_ROOK, A1);
-                break;
-            case H1:
-            case G1:
-                clear_square(G1);
-                clear_square(F1);
-                set_piece_at(WHITE_KING, E1);
-                set_piece_at(WHITE_ROOK, H1);
-                break;
-            case A8:
-            case C8:
-                clear_square(C8);
-                clear_square(D8);
-                set_piece_at(BLACK_KING, E8);
-                set_piece_at(BLACK_ROOK, A8);
-                break;
-            case H8:
-            case G8:
-                clear_square(G8);
-                clear_square(F8);
-                set_piece_at(BLACK_KING, E8);
-                set_piece_at(BLACK_ROOK, H8);
+        clear_square(move.castling_king_to());
+        clear_square(move.castling_rook_to());
+        set_piece_at(move.piece_moved, move.from);
+        set_piece_at(make_piece(ROOK, move.color), move.to);
+    } else {
+        set_piece_at(move.piece_moved, move.from);
+        if (!move.is_enpassant)
+            set_piece_at(move.captured, move.to);
+        else {
+            clear_square(move.to);
+            set_piece_at(move.captured, move.color == BLACK ? Square(move.to + 8) : Square(move.to - 8));
         }
     }
     m_position.castling_rights = move.castling_rights;
@@ -573,45 +534,36 @@ Bitboard Board::get_bpawn_pushes(Bitboard pawns, Bitboard occupancy)
     return pushes;
 }
 
+void Board::generate_castling(const Position &position, std::vector<Move> &move_list)
+{
+    const uint8_t rights = position.stm == WHITE ? WHITE_CASTLING_ALL : BLACK_CASTLING_ALL;
+    for (uint8_t right : {uint8_t(rights & CASTLING_OOO), uint8_t(rights & CASTLING_OO)}) {
+        if (!castling_possible(position, right))
+            continue;
+        Move m;
+        m.is_castling = true;
+        m.piece_moved = make_piece(KING, position.stm);
+        m.color = position.stm;
+        m.from = Square(std::countr_zero(position.by_type[KING] & position.by_color[position.stm]));
+        m.to = position.castling_rook(right);
+        m.is_legal = true;
+        // the path is safe, a slider on the back rank the castling rook stood in front of can still give check
+        Position test_position = test_move(m, position);
+        if (!(test_position.by_type[KING] & test_position.by_color[position.stm] &
+              get_attacks(test_position, opposite(m.color)))) {
+            move_list.push_back(m);
+        }
+    }
+}
+
 std::vector<Move> Board::generate_moves(const Position &position)
 {
+    ++m_call_counters.generate_moves;
     std::vector<Move> move_list;
     Square from = SQUARE_NONE, to = SQUARE_NONE;
     Bitboard movers = 0, moves = 0;
-    // castle moves
+    generate_castling(position, move_list);
     if (position.stm == WHITE) {
-        if (position.by_type[KING] & position.by_color[WHITE] & ~position.attacks[BLACK] &&
-            position.castling_rights & WHITE_CASTLING_OOO &&
-            !(w_OOO_mask & (occupancy(position)) | w_OOO_mask & position.attacks[BLACK])) {
-            Move m;
-            m.is_castling = true;
-            m.piece_moved = WHITE_KING;
-            m.color = WHITE;
-            m.from = E1;
-            m.to = C1;
-            m.is_legal = true;
-            Position test_position = test_move(m, position);
-            if (!(test_position.by_type[KING] & test_position.by_color[position.stm] &
-                  get_attacks(test_position, opposite(m.color)))) {
-                move_list.push_back(m);
-            }
-        }
-        if (position.by_type[KING] & position.by_color[WHITE] & ~position.attacks[BLACK] &&
-            position.castling_rights & WHITE_CASTLING_OO &&
-            !(w_OO_mask & (occupancy(position)) | w_OO_mask & position.attacks[BLACK])) {
-            Move m;
-            m.is_castling = true;
-            m.piece_moved = WHITE_KING;
-            m.color = WHITE;
-            m.from = E1;
-            m.to = G1;
-            m.is_legal = true;
-            Position test_position = test_move(m, position);
-            if (!(test_position.by_type[KING] & test_position.by_color[position.stm] &
-                  get_attacks(test_position, opposite(m.color)))) {
-                move_list.push_back(m);
-            }
-        }
         movers = position.by_type[PAWN] & position.by_color[position.stm];
 
         if (position.ep != SQUARE_NONE) {
@@ -773,39 +725,6 @@ std::vector<Move> Board::generate_moves(const Position &position)
         }
 
     } else {
-        if (position.by_type[KING] & position.by_color[BLACK] & ~position.attacks[WHITE] &&
-            position.castling_rights & BLACK_CASTLING_OOO &&
-            !(b_OOO_mask & (occupancy(position)) | b_OOO_mask & position.attacks[WHITE])) {
-            Move m;
-            m.is_castling = true;
-            m.piece_moved = BLACK_KING;
-            m.color = BLACK;
-            m.from = E8;
-            m.to = C8;
-            m.is_legal = true;
-            Position test_position = test_move(m, position);
-            if (!(test_position.by_type[KING] & test_position.by_color[position.stm] &
-                  get_attacks(test_position, opposite(m.color)))) {
-                move_list.push_back(m);
-            }
-        }
-        if (position.by_type[KING] & position.by_color[BLACK] & ~position.attacks[WHITE] &&
-            position.castling_rights & BLACK_CASTLING_OO &&
-            !(b_OO_mask & (occupancy(position)) | b_OO_mask & position.attacks[WHITE])) {
-            Move m;
-            m.is_castling = true;
-            m.piece_moved = BLACK_KING;
-            m.color = BLACK;
-            m.from = E8;
-            m.to = G8;
-            m.is_legal = true;
-            Position test_position = test_move(m, position);
-            if (!(test_position.by_type[KING] & test_position.by_color[position.stm] &
-                  get_attacks(test_position, opposite(m.color)))) {
-                move_list.push_back(m);
-            }
-        }
-
         movers = position.by_type[PAWN] & position.by_color[position.stm];
 
         if (position.ep != SQUARE_NONE) {
@@ -1087,6 +1006,67 @@ std::vector<Move> Board::generate_moves(const Position &position)
         }
     }
 
+    // the state a move overwrites travels with it so that undo_move can restore it
+    for (auto &m : move_list) {
+        m.prev_ep = position.ep;
+        m.castling_rights = position.castling_rights;
+        m.half_move_clock = position.half_move_clock;
+        m.full_move = position.full_move;
+    }
+    return move_list;
+}
+
+std::vector<Move> Board::generate_unmoves(const Position &position)
+{
+    std::vector<Move> move_list;
+    const Color color = opposite(position.stm);
+    const Bitboard occupied = occupancy(position);
+    auto add = [&](Square from, Square to) {
+        Move m;
+        m.from = from;
+        m.to = to;
+        m.piece_moved = position.board[to];
+        m.color = color;
+        m.is_legal = true;
+        move_list.push_back(m);
+    };
+    for (Bitboard pieces = position.by_color[color] & ~position.by_type[PAWN]; pieces; pieces &= pieces - 1) {
+        const Square to = Square(std::countr_zero(pieces));
+        Bitboard origins;
+        switch (type_of(position.board[to])) {
+            case KNIGHT:
+                origins = m_knight_attacks[to];
+                break;
+            case BISHOP:
+                origins = get_bishop_attacks(to, occupied);
+                break;
+            case ROOK:
+                origins = get_rook_attacks(to, occupied);
+                break;
+            case QUEEN:
+                origins = get_queen_attacks(to, occupied);
+                break;
+            default:
+                origins = m_king_attacks[to];
+                break;
+        }
+        for (origins &= ~occupied; origins; origins &= origins - 1)
+            add(Square(std::countr_zero(origins)), to);
+    }
+    // pushes back towards the pawn's own side, double pushes from the fourth rank
+    const int back = color == WHITE ? -8 : 8;
+    const Rank double_rank = color == WHITE ? RANK_4 : RANK_5;
+    const Rank start_rank = color == WHITE ? RANK_2 : RANK_7;
+    for (Bitboard pawns = position.by_color[color] & position.by_type[PAWN]; pawns; pawns &= pawns - 1) {
+        const Square to = Square(std::countr_zero(pawns));
+        const Square from = Square(to + back);
+        if (occupied & square_bitboard(from))
+            continue;
+        if (rank_of(to) != start_rank)
+            add(from, to);
+        if (rank_of(to) == double_rank && !(occupied & square_bitboard(Square(from + back))))
+            add(Square(from + back), to);
+    }
     return move_list;
 }
 
@@ -1152,197 +1132,307 @@ void Board::prepare_for_print(Move &move)
     }
 }
 
-bool Board::parse_fen(const std::string &fen, Position &position)
+namespace {
+// What a character of the piece placement field does: the piece it puts down (PIECE_NONE for digits and slashes,
+// which then sets a bit nobody reads), how far it moves the cursor and whether it ends a rank or is not allowed.
+struct PlacementCode
 {
-    position = {};
-    uint curr_char = 0;
-    // Field 1: parse piece positions
-    for (Square square = A8; fen[curr_char] != ' ';) {
-        char fen_char = fen[curr_char];
-        // match ascii pieces within FEN string
-        size_t id;
-        // match empty square numbers within FEN string
-        if (isdigit(fen_char)) {
-            int offset = fen_char - '0';
-            square = Square(square + offset);
-            ++curr_char;
-        }
-
-        // match rank separator
-        else if (fen_char == '/') {
-            ++curr_char;
-            square = Square(square - 16);
-        } else if ((id = fen_char_pieces.find(fen_char)) != std::string::npos) {
-            set_piece_at(Piece(id), square, position);
-            ++square;
-            ++curr_char;
-        }
+    uint8_t piece;
+    uint8_t advance;
+    uint8_t slash;
+    uint8_t invalid;
+};
+
+constexpr std::array<PlacementCode, 256> placement_codes = [] {
+    std::array<PlacementCode, 256> codes{};
+    codes.fill({PIECE_NONE, 0, 0, 1});
+    for (uint8_t digit = 1; digit <= 8; ++digit)
+        codes['0' + digit] = {PIECE_NONE, digit, 0, 0};
+    codes['/'] = {PIECE_NONE, 0, 1, 0};
+    constexpr char pieces[] = "PNBRQKpnbrqk";
+    for (uint8_t piece = WHITE_PAWN; piece <= BLACK_KING; ++piece)
+        codes[uint8_t(pieces[piece])] = {piece, 1, 0, 0};
+    return codes;
+}();
+
+// squares of the rank of square beyond it towards the h-file, or towards the a-file
+Bitboard beyond(Square square, bool king_side)
+{
+    const Bitboard rank = rank_mask[rank_of(square)];
+    return king_side ? rank & ~((2ULL << square) - 1) : rank & ((1ULL << square) - 1);
+}
 
-        else {
-            // CHESSOPS_CORE_ERROR("Field 1: Malformed fen positions\n"); // error
-            return false;
-        }
-    }
-    ++curr_char;
-    // Field 2: parse side to move
-    if (fen[curr_char] == 'w' || fen[curr_char] == 'b') {
-        position.stm = fen[curr_char] == 'w' ? WHITE : BLACK;
-        ++curr_char;
-    } else {
-        // CHESSOPS_CORE_ERROR("Field 2: Invalid side to move\n"); // error
-        return false;
-    }
+// unsigned number of at most 9 digits at text[pos], false without one
+bool parse_number(std::string_view text, size_t &pos, uint32_t &number)
+{
+    const size_t begin = pos;
+    number = 0;
+    while (pos < text.size() && pos - begin < 9 && unsigned(text[pos] - '0') < 10)
+        number = number * 10 + uint32_t(text[pos++] - '0');
+    return pos != begin && (pos == text.size() || unsigned(text[pos] - '0') >= 10);
+}
 
-    if (fen[curr_char] != ' ') {
-        // CHESSOPS_CORE_ERROR("Field 2: There should be a space at the end of field 2\n"); // error
-        return false;
-    }
+size_t skip_spaces(std::string_view text, size_t pos)
+{
+    while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t'))
+        ++pos;
+    return pos;
+}
 
-    ++curr_char;
+char *write_number(char *out, uint32_t number)
+{
+    char digits[10];
+    int count = 0;
+    do {
+        digits[count++] = char('0' + number % 10);
+        number /= 10;
+    } while (number);
+    while (count)
+        *out++ = digits[--count];
+    return out;
+}
+} // namespace
 
-    // Field 3: parse castling rights
+const char *fen_error_text(FenError error)
+{
+    switch (error) {
+        case FenError::NONE:
+            return "valid";
+        case FenError::PLACEMENT:
+            return "malformed piece placement";
+        case FenError::SIDE_TO_MOVE:
+            return "invalid side to move";
+        case FenError::CASTLING:
+            return "invalid castling field";
+        case FenError::EN_PASSANT:
+            return "invalid en passant field";
+        case FenError::CLOCKS:
+            return "invalid move clocks";
+        case FenError::TRAILING:
+            return "unexpected text after the position";
+        case FenError::KINGS:
+            return "not exactly one king per side";
+        case FenError::PAWN_ON_BACK_RANK:
+            return "pawn on the first or last rank";
+        case FenError::OPPONENT_IN_CHECK:
+            return "side not to move is in check";
+        case FenError::CASTLING_RIGHTS:
+            return "castling right without king and rook on their squares";
+        case FenError::EN_PASSANT_SQUARE:
+            return "en passant square without a pawn that just moved two squares";
+    }
+    return "unknown error";
+}
 
-    while (fen[curr_char] != ' ') {
-        switch (fen[curr_char]) {
-            case '-':
-                position.castling_rights = CASTLING_NONE;
-                break;
-            case 'K':
-                position.castling_rights |= WHITE_CASTLING_OO;
-                break;
-            case 'Q':
-                position.castling_rights |= WHITE_CASTLING_OOO;
-                break;
-            case 'k':
-                position.castling_rights |= BLACK_CASTLING_OO;
-                break;
-            case 'q':
-                position.castling_rights |= BLACK_CASTLING_OOO;
-                break;
+FenError Board::parse_fen(std::string_view fen, Position &position, std::string_view *operations)
+{
+    position = {};
+    // Field 1: the placement is scanned without branching on the character, pieces land in one bitboard each
+    // indexed from a8 like the FEN, errors are collected and checked once at the end
+    Bitboard pieces[PIECE_NONE + 1] = {};
+    size_t pos = 0;
+    uint32_t cursor = 0, slashes = 0, invalid = 0;
+    for (; pos < fen.size() && fen[pos] != ' '; ++pos) {
+        const PlacementCode code = placement_codes[uint8_t(fen[pos])];
+        pieces[code.piece] |= Bitboard(cursor < 64) << (cursor & 63);
+        invalid |= code.invalid | (code.slash & (cursor != 8 * (slashes + 1)));
+        slashes += code.slash;
+        cursor += code.advance;
+    }
+    if (invalid || cursor != 64 || slashes != 7)
+        return FenError::PLACEMENT;
+    for (int index = WHITE_PAWN; index <= BLACK_KING; ++index) {
+        // a8 first to a1 first is a byte swap, the squares are known to be empty
+        for (Bitboard b = __builtin_bswap64(pieces[index]); b; b &= b - 1)
+            position.add_piece(Piece(index), Square(std::countr_zero(b)));
+    }
 
-            default: /*CHESSOPS_CORE_ERROR("Field 3: Invalid character: {0}", fen[curr_char]);*/
-                return false;
+    // Field 2: side to move
+    if (pos + 2 > fen.size() || (fen[pos + 1] != 'w' && fen[pos + 1] != 'b'))
+        return FenError::SIDE_TO_MOVE;
+    position.stm = fen[pos + 1] == 'w' ? WHITE : BLACK;
+    pos += 2;
+    if (pos >= fen.size() || fen[pos] != ' ')
+        return FenError::SIDE_TO_MOVE;
+    ++pos;
+
+    // Field 3: castling rights
+    if (pos < fen.size() && fen[pos] == '-') {
+        ++pos;
+    } else {
+        const size_t begin = pos;
+        // KQkq castle with the outermost rook (X-FEN), the file letters of Shredder-FEN name the rook. A right
+        // without king or rook on the back rank is left for validate.
+        for (; pos < fen.size() && fen[pos] != ' '; ++pos) {
+            const Color color = fen[pos] >= 'a' ? BLACK : WHITE;
+            const char letter = char(fen[pos] & ~0x20);
+            if (letter != 'K' && letter != 'Q' && unsigned(letter - 'A') >= 8)
+                return FenError::CASTLING;
+            const Rank rank = color == WHITE ? RANK_1 : RANK_8;
+            const Bitboard king = position.by_type[KING] & position.by_color[color] & rank_mask[rank];
+            const Square king_square = king ? Square(std::countr_zero(king)) : make_square(FILE_E, rank);
+            const Bitboard rooks = position.by_type[ROOK] & position.by_color[color] & rank_mask[rank];
+            File file = File(letter - 'A');
+            if (letter == 'K') {
+                const Bitboard outer = rooks & beyond(king_square, true);
+                file = outer ? file_of(Square(63 - std::countl_zero(outer))) : FILE_H;
+            } else if (letter == 'Q') {
+                const Bitboard outer = rooks & beyond(king_square, false);
+                file = outer ? file_of(Square(std::countr_zero(outer))) : FILE_A;
+            }
+            const uint8_t right = (file > file_of(king_square) ? CASTLING_OO : CASTLING_OOO) &
+                                  (color == WHITE ? WHITE_CASTLING_ALL : BLACK_CASTLING_ALL);
+            if (position.castling_rights & right)
+                return FenError::CASTLING;
+            position.castling_rights |= right;
+            position.castling_rooks[std::countr_zero(right)] = uint8_t(make_square(file, rank));
         }
-        ++curr_char;
+        if (pos == begin)
+            return FenError::CASTLING;
     }
-    ++curr_char;
-    // Field 4: parse enpassant square
-    if (fen[curr_char] != '-') {
-        if (fen[curr_char] >= 'a' && fen[curr_char] <= 'h' && fen[curr_char + 1] >= '1' && fen[curr_char + 1] <= '8') {
-            File f = File(fen[curr_char] - 'a');
-            Rank r = Rank(fen[curr_char + 1] - '1');
-            position.ep = make_square(f, r);
-            curr_char += 2;
-        } else {
-            // CHESSOPS_CORE_ERROR("Field 4: Invalid en passant square\n"); // error
-            return false;
-        }
+    if (pos >= fen.size() || fen[pos] != ' ')
+        return FenError::CASTLING;
+    ++pos;
+
+    // Field 4: en passant square
+    if (pos < fen.size() && fen[pos] == '-') {
+        ++pos;
     } else {
-        position.ep = SQUARE_NONE;
-        ++curr_char;
+        if (pos + 2 > fen.size() || unsigned(fen[pos] - 'a') >= 8 || (fen[pos + 1] != '3' && fen[pos + 1] != '6'))
+            return FenError::EN_PASSANT;
+        position.ep = make_square(File(fen[pos] - 'a'), Rank(fen[pos + 1] - '1'));
+        pos += 2;
     }
-    ++curr_char;
-    // CHESSOPS_CORE_INFO("Field 5 has: \"{0}\"", fen.substr(curr_char));
-    // field 5 half move number
-    if (curr_char >= fen.length() || !isdigit(fen.at(curr_char))) {
-        // CHESSOPS_CORE_ERROR("Field 5: Not a number\n"); // error
-        return false;
+    if (pos < fen.size() && fen[pos] != ' ' && fen[pos] != '\t')
+        return FenError::EN_PASSANT;
+
+    // Fields 5 and 6: the clocks, optional in an EPD and in short FENs
+    pos = skip_spaces(fen, pos);
+    if (pos < fen.size() && unsigned(fen[pos] - '0') < 10) {
+        uint32_t half_move_clock, full_move;
+        if (!parse_number(fen, pos, half_move_clock))
+            return FenError::CLOCKS;
+        pos = skip_spaces(fen, pos);
+        if (!parse_number(fen, pos, full_move))
+            return FenError::CLOCKS;
+        position.half_move_clock = half_move_clock;
+        position.full_move = std::max<uint32_t>(1, full_move);
+        pos = skip_spaces(fen, pos);
     }
-    std::string s;
-    do {
-        s += fen.at(curr_char);
-        ++curr_char;
-    } while ((isdigit(fen.at(curr_char))));
+    size_t end = fen.size();
+    while (end > pos && (fen[end - 1] == ' ' || fen[end - 1] == '\t' || fen[end - 1] == '\r' || fen[end - 1] == '\n'))
+        --end;
+    if (operations)
+        *operations = fen.substr(pos, end - pos);
+    else if (pos != end)
+        return FenError::TRAILING;
 
-    position.half_move_clock = stoi(s);
-    ++curr_char;
+    update_attacks(position);
+    return FenError::NONE;
+}
 
-    // CHESSOPS_CORE_INFO("Field 6 has: \"{0}\"", fen.substr(curr_char));
-    // field 6 full move number
-    if (curr_char >= fen.length() || !isdigit(fen.at(curr_char))) {
-        // CHESSOPS_CORE_ERROR("Field 6: Not a number\n"); // error
-        return false;
+FenError Board::validate(const Position &position) const
+{
+    const Bitboard kings[2] = {position.by_type[KING] & position.by_color[WHITE],
+                               position.by_type[KING] & position.by_color[BLACK]};
+    if (std::popcount(kings[WHITE]) != 1 || std::popcount(kings[BLACK]) != 1)
+        return FenError::KINGS;
+    constexpr Bitboard back_ranks = 0xff000000000000ffULL;
+    if (position.by_type[PAWN] & back_ranks)
+        return FenError::PAWN_ON_BACK_RANK;
+    const Color them = opposite(position.stm);
+    if (attackers_to(Square(std::countr_zero(kings[them])), occupancy(position), position) &
+        position.by_color[position.stm])
+        return FenError::OPPONENT_IN_CHECK;
+
+    // king on the back rank and the rook of every right on its square, on the king's side the right castles to
+    for (uint8_t right = WHITE_CASTLING_OOO; right <= BLACK_CASTLING_OO; right <<= 1) {
+        if (!(position.castling_rights & right))
+            continue;
+        const Color color = right & WHITE_CASTLING_ALL ? WHITE : BLACK;
+        const Rank rank = color == WHITE ? RANK_1 : RANK_8;
+        const Square king = Square(std::countr_zero(kings[color]));
+        const Square rook = position.castling_rook(right);
+        if (rank_of(king) != rank || rank_of(rook) != rank || position.board[rook] != make_piece(ROOK, color) ||
+            (file_of(rook) > file_of(king)) != bool(right & CASTLING_OO))
+            return FenError::CASTLING_RIGHTS;
     }
-    s = "";
-    do {
-        s += fen.at(curr_char);
-        ++curr_char;
 
-    } while ((fen.length() != curr_char && isdigit(fen.at(curr_char))));
-    int move_number = stoi(s);
-    // position.full_move = position.stm == WHITE ? move_number * 2 : move_number * 2;
-    position.full_move = move_number;
-    ++curr_char;
-
-    update_attacks();
-    return true;
+    if (position.ep != SQUARE_NONE) {
+        // on the third rank of the side that just moved, empty, with its pawn in front and the start square empty
+        const int forward = position.stm == WHITE ? -8 : 8;
+        const Rank rank = position.stm == WHITE ? RANK_6 : RANK_3;
+        const Square pawn = Square(position.ep + forward);
+        const Square start = Square(position.ep - forward);
+        if (rank_of(position.ep) != rank || position.board[position.ep] != PIECE_NONE ||
+            position.board[start] != PIECE_NONE || position.board[pawn] != make_piece(PAWN, them))
+            return FenError::EN_PASSANT_SQUARE;
+    }
+    return FenError::NONE;
 }
 
-std::string Board::get_position_fen(const Position &position)
+size_t Board::write_fen(const Position &position, char *buffer, bool epd)
 {
-    std::string fen;
-    char curr_char = 0;
-    // Field 1: Piece placement
-    for (Square square = A8;;) {
-        Piece p = get_piece_at(square, position);
+    constexpr char pieces[] = "PNBRQKpnbrqk";
+    char *out = buffer;
+    // Field 1: piece placement
+    for (int rank = RANK_8; rank >= RANK_1; --rank) {
         int empty = 0;
-        Rank current_rank = rank_of(square);
-        for (; p == PIECE_NONE && rank_of(square) == current_rank; ++empty, p = get_piece_at(++square, position))
-            ;
-        if (empty != 0)
-            fen.append(std::to_string(empty));
-        for (; p != PIECE_NONE && rank_of(square) == current_rank;
-             fen.push_back(fen_char_pieces.at(p)), p = get_piece_at(++square, position))
-            ;
-        if (rank_of(square) == current_rank)
-            continue;
-        fen.push_back('/');
-        if (square - 1 == H1)
-            break;
-        current_rank = rank_of(square);
-        square = Square(square - 16); // TODO: maybe overload operator-=
-    }
-
-    fen.push_back(' ');
-    // Field 2: Side to move
-    fen.push_back(position.stm == BLACK ? 'b' : 'w');
-    fen.push_back(' ');
-    // Field 3: Castling Rights
-    if (position.castling_rights == CASTLING_NONE) {
-        fen.push_back(' ');
-    } else {
-        if (position.castling_rights & WHITE_CASTLING_OO) {
-            fen.push_back('K');
-        }
-        if (position.castling_rights & WHITE_CASTLING_OOO) {
-            fen.push_back('Q');
-        }
-        if (position.castling_rights & BLACK_CASTLING_OO) {
-            fen.push_back('k');
-        }
-        if (position.castling_rights & BLACK_CASTLING_OOO) {
-            fen.push_back('q');
+        for (int file = FILE_A; file <= FILE_H; ++file) {
+            const Piece piece = position.board[rank * RANK_WIDTH + file];
+            if (piece == PIECE_NONE) {
+                ++empty;
+                continue;
+            }
+            if (empty)
+                *out++ = char('0' + empty);
+            empty = 0;
+            *out++ = pieces[piece];
         }
+        if (empty)
+            *out++ = char('0' + empty);
+        *out++ = rank == RANK_1 ? ' ' : '/';
     }
-    fen.push_back(' ');
-    // Field 4: enpassant square
-
+    // Field 2: side to move
+    *out++ = position.stm == BLACK ? 'b' : 'w';
+    *out++ = ' ';
+    // Field 3: castling rights
+    if (position.castling_rights == CASTLING_NONE)
+        *out++ = '-';
+    // KQkq unless another rook stands further out than the one castled with, then its file as in X-FEN
+    for (uint8_t right : {WHITE_CASTLING_OO, WHITE_CASTLING_OOO, BLACK_CASTLING_OO, BLACK_CASTLING_OOO}) {
+        if (!(position.castling_rights & right))
+            continue;
+        const Square rook = position.castling_rook(right);
+        const bool king_side = right & CASTLING_OO;
+        const Color color = right & WHITE_CASTLING_ALL ? WHITE : BLACK;
+        const char letter = position.by_type[ROOK] & position.by_color[color] & beyond(rook, king_side)
+                                ? char('A' + file_of(rook))
+                                : king_side ? 'K' : 'Q';
+        *out++ = color == WHITE ? letter : char(letter | 0x20);
+    }
+    *out++ = ' ';
+    // Field 4: en passant square
     if (position.ep == SQUARE_NONE) {
-        fen.push_back('-');
+        *out++ = '-';
     } else {
-        std::string sqr = square_str.at(position.ep);
-        sqr[0] = (char)tolower(sqr[0]); // This is really really stupid...
-        fen.append(sqr);
+        *out++ = char('a' + file_of(position.ep));
+        *out++ = char('1' + rank_of(position.ep));
     }
-    fen.push_back(' ');
-    // Field 5: half move number
-    fen.append(std::to_string(m_position.half_move_clock));
-    fen.push_back(' ');
-
-    // Field 6: full move number
-    fen.append(std::to_string(m_position.full_move));
+    if (epd)
+        return size_t(out - buffer);
+    // Fields 5 and 6: half move clock and full move number
+    *out++ = ' ';
+    out = write_number(out, position.half_move_clock);
+    *out++ = ' ';
+    out = write_number(out, position.full_move);
+    return size_t(out - buffer);
+}
 
-    return fen;
+std::string Board::get_position_fen(const Position &position)
+{
+    char buffer[MAX_FEN_LENGTH];
+    return std::string(buffer, write_fen(position, buffer));
 }
 
 Piece Board::get_piece_at_from_bb(Square s)
@@ -1464,57 +1554,106 @@ bool Board::is_enemy_piece_attack(Square from, Square to, const Position &positi
     return false;
 }
 
-void Board::update_attacks()
+Bitboard Board::attackers_to(Square square, Bitboard occupied, const Position &position) const
 {
-    Color color = opposite(m_position.stm);
-    m_position.attacks[color] = 0;
-    for (Square from = A1; from <= H8; ++from) {
-        if (square_bitboard(from) & m_position.by_color[color]) {
-            for (Square to = A1; to <= H8; ++to) {
-                if (from == to) {
-                    continue;
-                }
-                if (is_enemy_piece_attack(from, to, m_position)) {
-                    m_position.attacks[color] |= square_bitboard(to);
-                }
-            }
+    const Bitboard diagonal = position.by_type[BISHOP] | position.by_type[QUEEN];
+    const Bitboard straight = position.by_type[ROOK] | position.by_type[QUEEN];
+    return (m_pawn_attacks[BLACK][square] & position.by_type[PAWN] & position.by_color[WHITE]) |
+           (m_pawn_attacks[WHITE][square] & position.by_type[PAWN] & position.by_color[BLACK]) |
+           (m_knight_attacks[square] & position.by_type[KNIGHT]) | (m_king_attacks[square] & position.by_type[KING]) |
+           (get_bishop_attacks(square, occupied) & diagonal) | (get_rook_attacks(square, occupied) & straight);
+}
+
+int Board::see(const Move &move, const Position &position) const
+{
+    // the middlegame material of the evaluation, with a king worth more than anything it could win and a last entry
+    // for PIECE_TYPE_NONE
+    static constexpr auto value = [] {
+        std::array<int, PIECE_TYPES + 1> value{};
+        for (int type = PAWN; type < KING; ++type)
+            value[type] = psqt::piece_value_mg[type];
+        value[KING] = 20000;
+        return value;
+    }();
+
+    const Square to = move.to;
+    Bitboard occupied = occupancy(position) ^ square_bitboard(move.from);
+    int gain[32];
+    gain[0] = move.captured == PIECE_NONE ? 0 : value[type_of(move.captured)];
+    PieceType on_square = type_of(move.piece_moved);
+    if (move.is_enpassant)
+        occupied ^= square_bitboard(move.color == WHITE ? to - 8 : to + 8);
+    if (move.promoted != PIECE_NONE) {
+        on_square = type_of(move.promoted);
+        gain[0] += value[on_square] - value[PAWN];
+    }
+
+    const Bitboard diagonal = position.by_type[BISHOP] | position.by_type[QUEEN];
+    const Bitboard straight = position.by_type[ROOK] | position.by_type[QUEEN];
+    // sliders lined up behind the first piece on a ray only join in once that piece has captured, the x-ray
+    // lookups tell whether there are any so that exchanges without batteries never look the sliders up again
+    const bool has_xrays = (Chess_Lookup::Lookup_Pext::Bishop_Xray(to, occupied) & diagonal & occupied) ||
+                           (Chess_Lookup::Lookup_Pext::Rook_Xray(to, occupied) & straight & occupied);
+    Bitboard attackers = attackers_to(to, occupied, position) & occupied;
+    Color side = opposite(move.color);
+
+    // gain[depth] is what the side capturing at depth wins if it is recaptured in turn
+    int depth = 0;
+    for (;;) {
+        ++depth;
+        gain[depth] = value[on_square] - gain[depth - 1];
+
+        Bitboard own = attackers & position.by_color[side];
+        if (!own || depth == 31)
+            break;
+        PieceType type = PAWN;
+        while (!(own & position.by_type[type]))
+            ++type;
+        const Bitboard from = own & position.by_type[type] & (0 - (own & position.by_type[type]));
+        occupied ^= from;
+        attackers ^= from;
+        if (has_xrays) {
+            if (type == PAWN || type == BISHOP || type == QUEEN)
+                attackers |= get_bishop_attacks(to, occupied) & diagonal & occupied;
+            if (type == ROOK || type == QUEEN)
+                attackers |= get_rook_attacks(to, occupied) & straight & occupied;
         }
+        on_square = type;
+        side = opposite(side);
     }
+    // the last entry assumed a capture nobody can make, every side picks the better of capturing and standing pat
+    while (--depth)
+        gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+    return gain[0];
+}
+
+void Board::update_attacks()
+{
+    update_attacks(m_position);
 }
 
 void Board::update_attacks(Position &position)
 {
     Color color = opposite(position.stm);
-    position.attacks[color] = 0;
-    for (Square from = A1; from <= H8; ++from) {
-        if (square_bitboard(from) & position.by_color[color]) {
-            for (Square to = A1; to <= H8; ++to) {
-                if (from == to) {
-                    continue;
-                }
-                if (is_enemy_piece_attack(from, to, position)) {
-                    position.attacks[color] |= square_bitboard(to);
-                }
-            }
-        }
-    }
+    position.attacks[color] = get_attacks(position, color);
 }
 
 Bitboard Board::get_attacks(const Position &position, Color color)
 {
-    Bitboard attacks = 0;
-    for (Square from = A1; from <= H8; ++from) {
-        if (square_bitboard(from) & position.by_color[color]) {
-            for (Square to = A1; to <= H8; ++to) {
-                if (from == to) {
-                    continue;
-                }
-                if (is_enemy_piece_attack(from, to, position)) {
-                    attacks |= square_bitboard(to);
-                }
-            }
-        }
-    }
+    // one table lookup per piece instead of testing every from/to pair, this runs after every move
+    const Bitboard occupied = occupancy(position);
+    const Bitboard own = position.by_color[color];
+    Bitboard pawns = position.by_type[PAWN] & own;
+    Bitboard attacks = color == WHITE ? (pawns << 7 & not_h_file) | (pawns << 9 & not_a_file)
+                                      : (pawns >> 7 & not_a_file) | (pawns >> 9 & not_h_file);
+    for (Bitboard b = position.by_type[KNIGHT] & own; b; b &= b - 1)
+        attacks |= m_knight_attacks[std::countr_zero(b)];
+    for (Bitboard b = (position.by_type[BISHOP] | position.by_type[QUEEN]) & own; b; b &= b - 1)
+        attacks |= get_bishop_attacks(Square(std::countr_zero(b)), occupied);
+    for (Bitboard b = (position.by_type[ROOK] | position.by_type[QUEEN]) & own; b; b &= b - 1)
+        attacks |= get_rook_attacks(Square(std::countr_zero(b)), occupied);
+    for (Bitboard b = position.by_type[KING] & own; b; b &= b - 1)
+        attacks |= m_king_attacks[std::countr_zero(b)];
     return attacks;
 }
 
@@ -1,10 +1,15 @@
 #pragma once
 #include <Pext.hpp>
 #include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <string_view>
 #include <vector>
 
 #include "move.hxx"
+#include "psqt.hxx"
 #include "types.hxx"
+#include "zobrist.hxx"
 
 namespace db {
 
@@ -16,9 +21,14 @@ struct Position
         , stm(COLOR_NONE)
         , ep(SQUARE_NONE)
         , castling_rights(CASTLING_NONE)
+        , castling_rooks{A1, H1, A8, H8}
         , half_move_clock(0)
         , full_move(1)
         , attacks{0}
+        , piece_key(0)
+        , psqt_mg(0)
+        , psqt_eg(0)
+        , phase(0)
     {
         std::fill(&board[0], &board[0] + sizeof(board) / sizeof(board[0]), PIECE_NONE);
     }
@@ -30,17 +40,75 @@ struct Position
     Color stm;
     Square ep; // enpassant square
     uint8_t castling_rights;
+    // square of the rook each right castles with, indexed by the bit of the right. a1, h1, a8 and h8 in standard
+    // chess, any square of the back rank on the king's side of the right in Chess960.
+    uint8_t castling_rooks[4];
+    [[nodiscard]] Square castling_rook(uint8_t right) const { return Square(castling_rooks[std::countr_zero(right)]); }
     // TODO: think of better names maybe
     uint32_t half_move_clock; // number of moves since last pawn move or capture
     uint32_t full_move;       // full move number in game (incremented after each half move)
 
     Bitboard attacks[2]; // all attacks for each color
+
+    uint64_t piece_key; // zobrist key of the pieces only, kept up to date by set_piece_at and clear_square
+    // full zobrist key including side to move, castling rights and en passant file
+    [[nodiscard]] uint64_t key() const
+    {
+        return piece_key ^ zobrist::castling_key(castling_rights) ^ zobrist::ep_key(ep) ^ zobrist::turn_key(stm);
+    }
+
+    // material and piece square sums from white's point of view and the game phase (psqt::PHASE_MAX with all pieces
+    // on the board), kept up to date by set_piece_at and clear_square like piece_key
+    int32_t psqt_mg;
+    int32_t psqt_eg;
+    int32_t phase;
+
+    // puts piece on an empty square, keeping the bitboards, key and sums in step. Board::set_piece_at also clears the
+    // square first.
+    void add_piece(Piece piece, Square square)
+    {
+        by_type[type_of(piece)] |= square_bitboard(square);
+        by_color[color_of(piece)] |= square_bitboard(square);
+        board[square] = piece;
+        piece_key ^= zobrist::piece_key(piece, square);
+        psqt_mg += psqt::score(piece, square).mg;
+        psqt_eg += psqt::score(piece, square).eg;
+        phase += psqt::phase_weight[type_of(piece)];
+    }
 };
 
 // A bitboard based board representation
+// why Board::parse_fen rejected a FEN or Board::validate a position
+enum class FenError : uint8_t
+{
+    NONE,
+    PLACEMENT,
+    SIDE_TO_MOVE,
+    CASTLING,
+    EN_PASSANT,
+    CLOCKS,
+    TRAILING,
+    KINGS,
+    PAWN_ON_BACK_RANK,
+    OPPONENT_IN_CHECK,
+    CASTLING_RIGHTS,
+    EN_PASSANT_SQUARE,
+};
+const char *fen_error_text(FenError error);
+
+// longest FEN write_fen produces, with room to spare for 9 digit clocks
+constexpr size_t MAX_FEN_LENGTH = 96;
+
 class Board
 {
 public:
+    // number of calls into the expensive queries, read by the GUI's frame profiler
+    struct CallCounters
+    {
+        uint64_t is_piece_attack{0};
+        uint64_t generate_moves{0};
+    };
+
     Board();
 
     static std::string print_bitboard(Bitboard bitboard);
@@ -66,45 +134,127 @@ public:
                m_position.attacks[opposite(m_position.stm)];
     }
     bool is_piece_attack(Square from, Square to);
+    // the rook a king move from from to to castles with, SQUARE_NONE when it is no castling. Castling moves are the
+    // king taking its own rook, the king landing on its destination (g or c file) two or more files away is taken
+    // as castling too so that standard notation and the usual king drag keep working.
+    Square castling_rook(Square from, Square to) const;
+    // pieces of both colors attacking square, sliders are blocked by occupancy instead of the board's pieces
+    Bitboard attackers_to(Square square, Bitboard occupancy) const
+    {
+        return attackers_to(square, occupancy, m_position);
+    }
+    Bitboard attackers_to(Square square, Bitboard occupancy, const Position &position) const;
+    // static exchange evaluation: material won by the side making move once the exchange it starts on the target
+    // square is played out, each side stopping when recapturing no longer pays. Pins are not considered.
+    int see(const Move &move) const { return see(move, m_position); }
+    int see(const Move &move, const Position &position) const;
 
     Move prepare_move(Move move);
     bool do_move(const Move &move);
     Position test_move(const Move &move, Position position);
     bool undo_move(const Move &move);
-    bool set_fen(const std::string &fen) { return parse_fen(fen, m_position); }
-    bool set_fen(const std::string &fen, Position &position) { return parse_fen(fen, position); }
+    bool set_fen(const std::string &fen)
+    {
+        m_history.clear();
+        return parse_fen(fen, m_position, nullptr) == FenError::NONE;
+    }
+    bool set_fen(const std::string &fen, Position &position)
+    {
+        return parse_fen(fen, position, nullptr) == FenError::NONE;
+    }
     std::string get_fen() { return get_position_fen(m_position); }
     std::string get_fen(const Position &position) { return get_position_fen(position); }
     Color get_stm() { return m_position.stm; }
     uint8_t get_castling_rights() { return m_position.castling_rights; }
     bool debug_is_enemy_attack(Square sq) { return m_position.attacks[opposite(m_position.stm)] & square_bitboard(sq); }
-    Position get_position() { return m_position; }
+    const Position &get_position() const { return m_position; }
+    void set_position(const Position &position)
+    {
+        m_position = position;
+        m_history.clear();
+    }
+
+    // Keys of the positions before each move done since the position was set, pushed by do_move and popped by
+    // undo_move. A search continuing a game sets the game's keys so that it sees repetitions of earlier positions.
+    const std::vector<uint64_t> &history() const { return m_history; }
+    void set_history(const std::vector<uint64_t> &history) { m_history = history; }
+    // the position occurred times times before, counting only positions since the last capture or pawn move with the
+    // same side to move. Threefold repetition is is_repetition(2), a search treats the first repetition as a draw.
+    bool is_repetition(int times = 1) const
+    {
+        // a position cannot repeat within fewer than four plies, most nodes of a search return here
+        const size_t reach = std::min<size_t>(m_position.half_move_clock, m_history.size());
+        if (reach < 4)
+            return false;
+        const uint64_t key = m_position.key();
+        for (size_t back = 4; back <= reach; back += 2) {
+            if (m_history[m_history.size() - back] == key && --times == 0)
+                return true;
+        }
+        return false;
+    }
+    // a hundred plies without a capture or pawn move, unless the last of them mated
+    bool is_fifty_move_draw()
+    {
+        return m_position.half_move_clock >= 100 && !(is_check() && generate_moves().empty());
+    }
+    // neither side can mate: no pawns, rooks or queens and at most one minor piece, or bishops that all stand on
+    // squares of one color
+    bool is_insufficient_material() const
+    {
+        const Position &p = m_position;
+        if (p.by_type[PAWN] | p.by_type[ROOK] | p.by_type[QUEEN])
+            return false;
+        if (std::popcount(p.by_type[KNIGHT] | p.by_type[BISHOP]) <= 1)
+            return true;
+        constexpr Bitboard dark_squares = 0xaa55aa55aa55aa55ULL;
+        return !p.by_type[KNIGHT] && (!(p.by_type[BISHOP] & dark_squares) || !(p.by_type[BISHOP] & ~dark_squares));
+    }
 
     std::vector<Move> generate_moves() { return generate_moves(m_position); }
     std::vector<Move> generate_moves(const Position &position);
+    // moves the side not to move could have made to reach position, from and to as in the forward move. Only quiet
+    // moves: no captures, promotions, castling or en passant, and the legality of the position before is up to the
+    // caller. Used by the retrograde analysis of the endgame tables.
+    std::vector<Move> generate_unmoves(const Position &position);
+    // attacks of the side not to move, for positions put together with set_piece_at
+    void update_attacks(Position &position);
 
     // removes illegal moves to aid disambiguation
     void remove_illegal(const Move &move, Bitboard &b);
     // prepares move for conversion to SAN (disambiguation)
     void prepare_for_print(Move &move);
-    // assumes fen is valid
+    const CallCounters &get_call_counters() const { return m_call_counters; }
+    void reset_call_counters() { m_call_counters = {}; }
+    // Parses the fields of a FEN without exceptions and without checking that the position makes sense, see
+    // validate. The clocks may be left out. With operations the text after the fields is returned there (the
+    // operations of an EPD line), without it anything but white space after the fields is an error.
+    FenError parse_fen(std::string_view fen, Position &position, std::string_view *operations);
+    // kings, pawns, the side not to move being in check, castling rights and the en passant square
+    FenError validate(const Position &position) const;
+    // writes the FEN of position, or only its first four fields for an EPD, into buffer of at least MAX_FEN_LENGTH
+    // bytes and returns the length
+    static size_t write_fen(const Position &position, char *buffer, bool epd = false);
+
 private:
-    bool parse_fen(const std::string &fen, Position &position); // returns false if it fails
     std::string get_position_fen(const Position &position);
 
-    Bitboard get_rook_attacks(Square square, Bitboard occupancy)
+    static Bitboard get_rook_attacks(Square square, Bitboard occupancy)
     {
         return Chess_Lookup::Lookup_Pext::Rook(square, occupancy);
     }
-    Bitboard get_bishop_attacks(Square square, Bitboard occupancy)
+    static Bitboard get_bishop_attacks(Square square, Bitboard occupancy)
     {
         return Chess_Lookup::Lookup_Pext::Bishop(square, occupancy);
     }
-    Bitboard get_queen_attacks(Square square, Bitboard occupancy)
+    static Bitboard get_queen_attacks(Square square, Bitboard occupancy)
     {
         return Chess_Lookup::Lookup_Pext::Queen(square, occupancy);
     }
 
+    // adds the castling moves of the side to move that are legal in position
+    void generate_castling(const Position &position, std::vector<Move> &move_list);
+
     Bitboard get_wpawn_pushes(Bitboard pawns, Bitboard occupancy);
     Bitboard get_bpawn_pushes(Bitboard pawns, Bitboard occupancy);
 
@@ -114,11 +264,12 @@ private:
     bool is_enemy_piece_attack(Square from, Square to, const Position &position);
 
     void update_attacks();
-    void update_attacks(Position &position);
 
     Bitboard get_attacks(const Position &position, Color color);
 
     Position m_position;
+    std::vector<uint64_t> m_history;
+    CallCounters m_call_counters;
 
     Piece get_piece_at_from_bb(Square s);
 
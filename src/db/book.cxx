@@ -0,0 +1,318 @@
+#include "book.hxx"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace db::polyglot {
+
+namespace {
+constexpr size_t ENTRY_SIZE = 16;
+
+uint64_t read_big_endian(const uint8_t *data, size_t bytes)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i)
+        value = value << 8 | data[i];
+    return value;
+}
+
+void write_big_endian(uint8_t *data, uint64_t value, size_t bytes)
+{
+    for (size_t i = bytes; i-- > 0; value >>= 8)
+        data[i] = uint8_t(value);
+}
+
+// the test positions of the Polyglot format description and their keys
+const std::pair<const char *, uint64_t> random64_tests[] = {
+    {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", START_KEY},
+    {"rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", 0x823c9b50fd114196ULL},
+    {"rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2", 0x0756b94461c50fb0ULL},
+    {"rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2", 0x662fafb965db29d4ULL},
+    {"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", 0x22a48b5a8e47ff78ULL},
+    {"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR b kq - 0 3", 0x652a607ca3f242c1ULL},
+    {"rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4", 0x00fdd303c946bdd9ULL},
+    {"rnbqkbnr/p1pppppp/8/8/PpP4P/8/1P1PPPP1/RNBQKBNR b KQkq c3 0 3", 0x3c8123ea7b067637ULL},
+    {"rnbqkbnr/p1pppppp/8/8/P6P/R1p5/1P1PPPP1/1NBQKBNR b Kkq - 0 4", 0x5c3f9b829b279560ULL},
+};
+
+int result_score(const std::string &result, Color color)
+{
+    if (result == "1/2-1/2")
+        return 1;
+    if (result == (color == WHITE ? "1-0" : "0-1"))
+        return 2;
+    return 0;
+}
+} // namespace
+
+std::optional<Keys> load_keys(const std::string &path)
+{
+    std::ifstream in(path);
+    Keys keys;
+    size_t count = 0;
+    for (std::string line; std::getline(in, line);) {
+        const size_t begin = line.find_first_not_of(" \t,");
+        if (begin == std::string::npos)
+            continue;
+        if (count == keys.size())
+            return std::nullopt;
+        try {
+            keys[count++] = std::stoull(line.substr(begin), nullptr, 16);
+        } catch (const std::exception &) {
+            return std::nullopt;
+        }
+    }
+    if (count != keys.size())
+        return std::nullopt;
+    return keys;
+}
+
+bool is_random64(const Keys &keys)
+{
+    Board board;
+    return std::all_of(std::begin(random64_tests), std::end(random64_tests), [&](const auto &test) {
+        return board.set_fen(test.first) && key(board.get_position(), keys) == test.second;
+    });
+}
+
+Keys default_keys(const std::string &book_path)
+{
+    const std::filesystem::path path = std::filesystem::path(book_path).parent_path() / KEYS_FILE;
+    std::error_code error;
+    if (std::filesystem::is_regular_file(path, error)) {
+        if (std::optional<Keys> keys = load_keys(path.string()); keys && is_random64(*keys))
+            return *keys;
+    }
+    return zobrist::keys;
+}
+
+uint64_t key(const Position &position, const Keys &keys)
+{
+    uint64_t key = 0;
+    for (int square = A1; square <= H8; ++square) {
+        const Piece piece = position.board[square];
+        if (piece != PIECE_NONE)
+            key ^= keys[64 * zobrist::piece_index(piece) + square];
+    }
+    if (position.castling_rights & WHITE_CASTLING_OO)
+        key ^= keys[zobrist::CASTLING_OFFSET + 0];
+    if (position.castling_rights & WHITE_CASTLING_OOO)
+        key ^= keys[zobrist::CASTLING_OFFSET + 1];
+    if (position.castling_rights & BLACK_CASTLING_OO)
+        key ^= keys[zobrist::CASTLING_OFFSET + 2];
+    if (position.castling_rights & BLACK_CASTLING_OOO)
+        key ^= keys[zobrist::CASTLING_OFFSET + 3];
+    if (position.ep != SQUARE_NONE) {
+        const Square pushed = Square(position.stm == WHITE ? position.ep - 8 : position.ep + 8);
+        const File file = file_of(pushed);
+        const Bitboard neighbours = (file > FILE_A ? square_bitboard(Square(pushed - 1)) : 0) |
+                                    (file < FILE_H ? square_bitboard(Square(pushed + 1)) : 0);
+        if (neighbours & position.by_type[PAWN] & position.by_color[position.stm])
+            key ^= keys[zobrist::EP_OFFSET + file];
+    }
+    if (position.stm == WHITE)
+        key ^= keys[zobrist::TURN_OFFSET];
+    return key;
+}
+
+uint16_t encode_move(const Move &move)
+{
+    // castling is king takes rook in polyglot as in Board
+    const Square to = move.to;
+    const int promotion = move.promoted == PIECE_NONE ? 0 : int(type_of(move.promoted));
+    return uint16_t(file_of(to) | rank_of(to) << 3 | file_of(move.from) << 6 | rank_of(move.from) << 9 |
+                    promotion << 12);
+}
+
+Book::Book()
+    : m_entries(nullptr)
+    , m_size(0)
+    , m_mapping_size(0)
+    , m_keys(zobrist::keys)
+{}
+
+Book::~Book()
+{
+    close();
+}
+
+bool Book::open(const std::string &path)
+{
+    close();
+#ifdef __unix__
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size == 0 || size_t(status.st_size) % ENTRY_SIZE != 0) {
+        ::close(fd);
+        return false;
+    }
+    const size_t file_size = size_t(status.st_size);
+    void *map = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        return false;
+    m_entries = static_cast<const uint8_t *>(map);
+    m_mapping_size = file_size;
+#else
+    std::ifstream in(path, std::ios::binary);
+    m_owned.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    if (m_owned.empty() || m_owned.size() % ENTRY_SIZE != 0) {
+        m_owned.clear();
+        return false;
+    }
+    m_entries = m_owned.data();
+    const size_t file_size = m_owned.size();
+#endif
+    m_size = file_size / ENTRY_SIZE;
+    return true;
+}
+
+void Book::close()
+{
+#ifdef __unix__
+    if (m_entries)
+        munmap(const_cast<uint8_t *>(m_entries), m_mapping_size);
+#endif
+    m_owned.clear();
+    m_entries = nullptr;
+    m_size = 0;
+    m_mapping_size = 0;
+}
+
+std::vector<BookMove> Book::moves(Board &board, const Position &position) const
+{
+    std::vector<BookMove> moves;
+    if (!m_entries)
+        return moves;
+    const uint64_t position_key = key(position, m_keys);
+    const size_t low = first_entry(position_key);
+    const std::vector<Move> legal = board.generate_moves(position);
+    for (size_t i = low; i < m_size && read_big_endian(m_entries + i * ENTRY_SIZE, 8) == position_key; ++i) {
+        const uint8_t *entry = m_entries + i * ENTRY_SIZE;
+        const uint16_t encoded = uint16_t(read_big_endian(entry + 8, 2));
+        const auto move = std::find_if(legal.begin(), legal.end(),
+                                       [encoded](const Move &move) { return encode_move(move) == encoded; });
+        // a colliding key or a damaged book
+        if (move == legal.end())
+            continue;
+        moves.push_back({*move, uint16_t(read_big_endian(entry + 10, 2))});
+    }
+    return moves;
+}
+
+bool Book::has_start_position() const
+{
+    if (!m_entries)
+        return false;
+    Board board;
+    board.set_fen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    const uint64_t start_key = key(board.get_position(), m_keys);
+    const size_t index = first_entry(start_key);
+    return index < m_size && read_big_endian(m_entries + index * ENTRY_SIZE, 8) == start_key;
+}
+
+size_t Book::first_entry(uint64_t key) const
+{
+    size_t low = 0, high = m_size;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (read_big_endian(m_entries + middle * ENTRY_SIZE, 8) < key)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+std::optional<Move> Book::pick(Board &board, const Position &position, std::mt19937_64 &random) const
+{
+    const std::vector<BookMove> moves = this->moves(board, position);
+    uint64_t total = 0;
+    for (const auto &move : moves)
+        total += move.weight;
+    if (total == 0)
+        return std::nullopt;
+    uint64_t choice = std::uniform_int_distribution<uint64_t>(0, total - 1)(random);
+    for (const auto &move : moves) {
+        if (choice < move.weight)
+            return move.move;
+        choice -= move.weight;
+    }
+    return std::nullopt;
+}
+
+BookBuilder::BookBuilder(const Keys &keys)
+    : m_keys(keys)
+    , m_positions(0)
+{}
+
+void BookBuilder::add_game(const PgnGame &game, size_t plies)
+{
+    m_board.set_fen(game.game.start_fen());
+    size_t ply = 0;
+    for (auto node = game.game.get_moves().begin() + 1; node != game.game.get_moves().end() && ply < plies; ++node) {
+        if (node->variation_level != 0)
+            continue;
+        auto &moves = m_moves[key(m_board.get_position(), m_keys)];
+        m_positions += moves.empty();
+        Stats &stats = moves[encode_move(node->move)];
+        ++stats.games;
+        stats.weight += result_score(game.result, node->move.color);
+        m_board.do_move(node->move);
+        ++ply;
+    }
+}
+
+size_t BookBuilder::write(const std::string &path, uint32_t min_games) const
+{
+    std::vector<uint64_t> keys;
+    keys.reserve(m_moves.size());
+    for (const auto &[key, moves] : m_moves)
+        keys.push_back(key);
+    std::sort(keys.begin(), keys.end());
+
+    std::ofstream out(path, std::ios::binary);
+    size_t entries = 0;
+    std::vector<std::pair<uint16_t, uint32_t>> selected;
+    for (uint64_t key : keys) {
+        selected.clear();
+        uint32_t max_weight = 0;
+        for (const auto &[move, stats] : m_moves.at(key)) {
+            if (stats.games < min_games || stats.weight == 0)
+                continue;
+            selected.emplace_back(move, stats.weight);
+            max_weight = std::max(max_weight, stats.weight);
+        }
+        // heaviest first, the order most programs expect
+        std::sort(selected.begin(), selected.end(), [](const auto &lhs, const auto &rhs) {
+            return lhs.second != rhs.second ? lhs.second > rhs.second : lhs.first < rhs.first;
+        });
+        for (const auto &[move, weight] : selected) {
+            const uint64_t scaled = max_weight > 0xffff ? std::max<uint64_t>(1, uint64_t(weight) * 0xffff / max_weight)
+                                                        : weight;
+            uint8_t entry[ENTRY_SIZE] = {};
+            write_big_endian(entry, key, 8);
+            write_big_endian(entry + 8, move, 2);
+            write_big_endian(entry + 10, scaled, 2);
+            out.write(reinterpret_cast<const char *>(entry), sizeof(entry));
+            ++entries;
+        }
+    }
+    if (!out)
+        throw std::runtime_error("cannot write " + path);
+    return entries;
+}
+} // namespace db::polyglot
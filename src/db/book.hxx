@@ -0,0 +1,108 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bitboard.hxx"
+#include "pgn.hxx"
+#include "zobrist.hxx"
+
+// Polyglot opening books (.bin): entries of 16 big endian bytes holding a position key, a move, a weight and a learn
+// value, sorted by key. Keys hash the position with the Polyglot scheme, which is the layout of db::zobrist except
+// that the en passant file only counts when a pawn of the side to move can take.
+namespace db::polyglot {
+using Keys = std::array<uint64_t, zobrist::KEY_COUNT>;
+
+// key of the start position with Polyglot's Random64 table
+constexpr uint64_t START_KEY = 0x463b96181691fc9cULL;
+// file next to a book that default_keys() reads the Random64 table from
+constexpr const char *KEYS_FILE = "random64.txt";
+
+// the 781 keys of a text file with one number per line ("0x9D39247E33776D41"), the way Polyglot's Random64 table is
+// usually distributed
+std::optional<Keys> load_keys(const std::string &path);
+// whether keys hash the test positions of the Polyglot format description, the start position first, to their
+// published keys; true only for the Random64 table
+bool is_random64(const Keys &keys);
+// the Random64 table of KEYS_FILE in the directory of book_path when it passes is_random64(), db::zobrist::keys
+// otherwise. Books hashed with db::zobrist::keys are readable here but not by other programs.
+Keys default_keys(const std::string &book_path);
+
+uint64_t key(const Position &position, const Keys &keys = zobrist::keys);
+// move in Polyglot encoding: to file, to rank, from file, from rank and promotion piece in 3 bits each, castling as
+// the king taking its own rook
+uint16_t encode_move(const Move &move);
+
+struct BookMove
+{
+    Move move;
+    uint16_t weight{0};
+};
+
+// A book file mapped into memory, lookups binary search the entries without reading the whole file.
+class Book
+{
+public:
+    Book();
+    ~Book();
+    Book(const Book &) = delete;
+    Book &operator=(const Book &) = delete;
+
+    // false if the file cannot be mapped or its size is not a multiple of the entry size
+    bool open(const std::string &path);
+    void close();
+    [[nodiscard]] bool is_open() const { return m_entries != nullptr; }
+    [[nodiscard]] size_t size() const { return m_size; }
+    void set_keys(const Keys &keys) { m_keys = keys; }
+    // whether the start position is in the book. A book hashed with other keys misses it like every other position,
+    // so false for a book with entries usually means the keys do not match.
+    [[nodiscard]] bool has_start_position() const;
+
+    // legal book moves of the position, in file order (usually by descending weight)
+    std::vector<BookMove> moves(Board &board, const Position &position) const;
+    // a book move chosen with probability proportional to its weight, nullopt if the position is not in the book
+    std::optional<Move> pick(Board &board, const Position &position, std::mt19937_64 &random) const;
+
+private:
+    // index of the first entry with the key, or of the first entry above it
+    size_t first_entry(uint64_t key) const;
+
+    const uint8_t *m_entries;
+    size_t m_size;
+    size_t m_mapping_size;
+    std::vector<uint8_t> m_owned;
+    Keys m_keys;
+};
+
+// Collects the moves of games and writes them as a book. A move's weight is 2 for every game the side that played it
+// won and 1 for every draw; the weights of a position are scaled down together when they exceed 16 bits.
+class BookBuilder
+{
+public:
+    explicit BookBuilder(const Keys &keys = zobrist::keys);
+
+    // the first plies of the mainline
+    void add_game(const PgnGame &game, size_t plies);
+    // writes the moves played in at least min_games games with a weight above 0, returns the number of entries
+    size_t write(const std::string &path, uint32_t min_games) const;
+    [[nodiscard]] size_t positions() const { return m_positions; }
+
+private:
+    struct Stats
+    {
+        uint32_t games{0};
+        uint32_t weight{0};
+    };
+
+    Keys m_keys;
+    Board m_board;
+    // position key to the encoded moves played from it
+    std::unordered_map<uint64_t, std::unordered_map<uint16_t, Stats>> m_moves;
+    size_t m_positions;
+};
+} // namespace db::polyglot
@@ -12,11 +12,16 @@
 #include "movenode.hxx"
 namespace db {
 Game::Game()
-    : m_current_move_index(0)
+    : Game("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1")
+{}
+
+Game::Game(const std::string &fen)
+    : m_start_fen(fen)
+    , m_current_move_index(0)
     , m_current_move_id(0)
 {
     m_moves.emplace_back(Move(), 0, 0, 0); // set the root MoveNode
-    m_board.set_fen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR/ w KQkq - 0 1");
+    m_board.set_fen(fen);
 }
 
 size_t Game::find_move(MoveId move_id) const
@@ -79,6 +84,20 @@ void Game::add_move(const Move &move)
     }
 }
 
+void Game::set_comment(MoveId id, std::string comment)
+{
+    size_t index = find_move(id);
+    if (index < m_moves.size())
+        m_moves[index].comment = std::move(comment);
+}
+
+void Game::add_nag(MoveId id, uint8_t nag)
+{
+    size_t index = find_move(id);
+    if (index < m_moves.size())
+        m_moves[index].nags.push_back(nag);
+}
+
 Move Game::forward()
 {
     if (m_current_move_index == m_moves.size() - 1) {
@@ -120,24 +139,45 @@ Move Game::back()
 
 std::string Game::text() const
 {
-    dump_debug();
+    return build_text(nullptr, true);
+}
+
+std::string Game::text(std::vector<TextSpan> &spans) const
+{
+    spans.clear();
+    spans.reserve(m_moves.size());
+    return build_text(&spans, false);
+}
+
+std::string Game::move_number_text(const Move &move, bool starts_variation)
+{
+    if (move.color == WHITE)
+        return std::to_string(move.full_move) + ". ";
+    if (starts_variation)
+        return std::to_string(move.full_move) + "... ";
+    return {};
+}
+
+std::string Game::build_text(std::vector<TextSpan> *spans, bool mark_current) const
+{
     std::string text;
     for (auto it = m_moves.begin() + 1; it != m_moves.end(); ++it) {
-        if (it->variation_level > (it - 1)->variation_level) {
+        bool starts_variation = it->variation_level > (it - 1)->variation_level;
+        if (starts_variation)
             text += "(";
-            if (it->move.color == WHITE)
-                text += std::to_string(it->move.full_move) + ". ";
-            else
-                text += std::to_string(it->move.full_move) + "... ";
-
-        } else if (it->move.color == WHITE) {
-            text += std::to_string(it->move.full_move) + ". ";
-        }
-        if (std::distance(m_moves.begin(), it) == m_current_move_index) {
+        text += move_number_text(it->move, starts_variation);
+        if (mark_current && std::distance(m_moves.begin(), it) == m_current_move_index) {
             text += "[" + it->move.to_san() + "]";
         } else {
-            text += it->move.to_san();
+            std::string san = it->move.to_san();
+            if (spans)
+                spans->push_back({it->move_id, text.size(), san.size()});
+            text += san;
         }
+        for (uint8_t nag : it->nags)
+            text += " $" + std::to_string(nag);
+        if (!it->comment.empty())
+            text += " {" + it->comment + "}";
         if (it + 1 != m_moves.end() && (it + 1)->variation_level < it->variation_level) {
             text += ")";
         }
@@ -1,5 +1,6 @@
 #pragma once
 #include <cstddef>
+#include <string>
 #include <vector>
 
 #include "bitboard.hxx"
@@ -9,18 +10,40 @@ namespace db {
 class Game
 {
 public:
+    // location of a move's SAN inside the movetext
+    struct TextSpan
+    {
+        MoveId move_id;
+        size_t begin;
+        size_t length;
+    };
+
     Game();
+    // game starting from an arbitrary position instead of the initial one
+    explicit Game(const std::string &fen);
 
     [[nodiscard]] size_t find_move(MoveId id) const;
     void add_move(const Move &move);
     Move forward();
     Move back();
     [[nodiscard]] MoveId current_move() const { return m_current_move_id; }
-    [[nodiscard]] std::vector<MoveNode> get_moves() const { return m_moves; }
+    [[nodiscard]] const MoveNode &current_node() const { return m_moves[m_current_move_index]; }
+    [[nodiscard]] Position get_position() const { return m_board.get_position(); }
+    [[nodiscard]] const std::vector<MoveNode> &get_moves() const { return m_moves; }
+    [[nodiscard]] const std::string &start_fen() const { return m_start_fen; }
+    void set_comment(MoveId id, std::string comment);
+    void add_nag(MoveId id, uint8_t nag);
     [[nodiscard]] std::string text() const;
+    // movetext without the current move marker, spans receives the position of every move in it
+    [[nodiscard]] std::string text(std::vector<TextSpan> &spans) const;
+    // move number that precedes a move in movetext, empty if the move does not need one
+    [[nodiscard]] static std::string move_number_text(const Move &move, bool starts_variation);
     void dump_debug() const;
 
 private:
+    [[nodiscard]] std::string build_text(std::vector<TextSpan> *spans, bool mark_current) const;
+
+    std::string m_start_fen;
     size_t m_current_move_index;
     MoveId m_current_move_id;
 
@@ -25,6 +25,11 @@ struct Move
     bool gives_check{false};
     bool gives_mate{false};
 
+    // castling is stored as the king taking its own rook, in Chess960 too. Both end up on the same squares as in
+    // standard chess: the king on the g or c file, the rook next to it on the inside.
+    [[nodiscard]] Square castling_king_to() const { return make_square(to > from ? FILE_G : FILE_C, rank_of(from)); }
+    [[nodiscard]] Square castling_rook_to() const { return make_square(to > from ? FILE_F : FILE_D, rank_of(from)); }
+
     bool operator==(const Move &rhs)
     {
         return this->from == rhs.from && this->to == rhs.to && this->piece_moved == rhs.piece_moved &&
@@ -37,6 +42,14 @@ struct Move
     [[nodiscard]] std::string to_san() const
     {
         std::string san;
+        if (this->is_castling) {
+            san = this->to > this->from ? "O-O" : "O-O-O";
+            if (this->gives_check)
+                san.push_back('+');
+            else if (this->gives_mate)
+                san.push_back('#');
+            return san;
+        }
         if (type_of(this->piece_moved) != PAWN) {
             san.push_back(fen_char_pieces[type_of(this->piece_moved)]);
         }
@@ -67,6 +80,14 @@ struct Move
     [[nodiscard]] std::string to_symbol_san() const
     {
         std::string san;
+        if (this->is_castling) {
+            san = this->to > this->from ? "O-O" : "O-O-O";
+            if (this->gives_check)
+                san.push_back('+');
+            else if (this->gives_mate)
+                san.push_back('#');
+            return san;
+        }
         if (type_of(this->piece_moved) != PAWN) {
             san.append(piece_symbol[type_of(this->piece_moved)]);
         }
@@ -2,6 +2,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <random>
+#include <string>
 #include <vector>
 
 #include "move.hxx"
@@ -42,6 +43,8 @@ struct MoveNode
     MoveId move_id;
     VariationId variation_id;
     size_t variation_level;
+    std::string comment;       // text after the move, without braces
+    std::vector<uint8_t> nags; // numeric annotation glyphs, $1 = !, $2 = ?, $4 = ?? ...
 };
 
 } // namespace db
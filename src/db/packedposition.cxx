@@ -0,0 +1,92 @@
+#include "packedposition.hxx"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace db {
+namespace {
+// rook files of the rights in standard chess, indexed by the bit of the right
+constexpr int standard_rook_files[4] = {FILE_A, FILE_H, FILE_A, FILE_H};
+} // namespace
+
+PackedPosition PackedPosition::pack(const Position &position)
+{
+    PackedPosition packed;
+    packed.occupancy = position.by_color[WHITE] | position.by_color[BLACK];
+    // nibble n at bit 4 * n of two words, which is the byte layout of pieces on a little endian machine. Each word
+    // is filled by a loop of its own so that it stays in a register.
+    uint64_t words[2] = {0, 0};
+    Bitboard b = packed.occupancy;
+    for (uint64_t &word : words) {
+        uint64_t nibbles = 0;
+        for (int shift = 0; b && shift < 64; b &= b - 1, shift += 4)
+            nibbles |= uint64_t(position.board[std::countr_zero(b)]) << shift;
+        word = nibbles;
+    }
+    std::memcpy(packed.pieces, words, sizeof(words));
+    packed.half_move_clock = uint16_t(std::min<uint32_t>(position.half_move_clock, UINT16_MAX));
+    packed.full_move = uint16_t(std::min<uint32_t>(position.full_move, UINT16_MAX));
+    packed.stm = uint8_t(position.stm);
+    packed.ep = uint8_t(position.ep);
+    uint32_t files = 0;
+    for (int index = 0; index < 4; ++index) {
+        if (!(position.castling_rights & 1 << index))
+            continue;
+        const int file = file_of(Square(position.castling_rooks[index]));
+        files |= uint32_t(file ^ standard_rook_files[index]) << 3 * index;
+    }
+    packed.castling_rights = uint8_t(position.castling_rights | files >> 8 << 4);
+    packed.castling_files = uint8_t(files);
+    return packed;
+}
+
+bool PackedPosition::unpack(Position &position) const
+{
+    if (std::popcount(occupancy) > 32 || stm > BLACK || (ep != SQUARE_NONE && ep >= 64))
+        return false;
+    uint64_t words[2];
+    std::memcpy(words, pieces, sizeof(words));
+    position = {};
+    // the incremental state is summed in locals and stored once, Position::add_piece per piece is slower
+    Bitboard by_piece[PIECE_NONE] = {};
+    uint64_t key = 0;
+    int32_t mg = 0, eg = 0, phase = 0;
+    Bitboard b = occupancy;
+    for (uint64_t nibbles : words) {
+        for (int count = 0; b && count < 16; b &= b - 1, ++count, nibbles >>= 4) {
+            // unknown pieces are rejected before they index the key and score tables
+            if ((nibbles & 15) > BLACK_KING)
+                return false;
+            const Square square = Square(std::countr_zero(b));
+            const Piece piece = Piece(nibbles & 15);
+            by_piece[piece] |= square_bitboard(square);
+            position.board[square] = piece;
+            key ^= zobrist::keys[64 * zobrist::piece_index(piece) + square];
+            mg += psqt::scores[piece][square].mg;
+            eg += psqt::scores[piece][square].eg;
+            phase += psqt::phase_weight[type_of(piece)];
+        }
+    }
+    for (int piece = WHITE_PAWN; piece <= BLACK_KING; ++piece) {
+        position.by_type[type_of(Piece(piece))] |= by_piece[piece];
+        position.by_color[color_of(Piece(piece))] |= by_piece[piece];
+    }
+    position.piece_key = key;
+    position.psqt_mg = mg;
+    position.psqt_eg = eg;
+    position.phase = phase;
+    position.half_move_clock = half_move_clock;
+    position.full_move = full_move;
+    position.stm = Color(stm);
+    position.ep = Square(ep);
+    position.castling_rights = castling_rights & CASTLING_ALL;
+    const uint32_t files = uint32_t(castling_rights >> 4) << 8 | castling_files;
+    for (int index = 0; index < 4; ++index) {
+        const File file = File((files >> 3 * index & 7) ^ standard_rook_files[index]);
+        position.castling_rooks[index] = uint8_t(make_square(file, index < 2 ? RANK_1 : RANK_8));
+    }
+    return true;
+}
+
+} // namespace db
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <type_traits>
+
+#include "bitboard.hxx"
+
+namespace db {
+// A position in 32 bytes: the occupied squares and a nibble per piece in square order, followed by the state that a
+// FEN holds in its other fields. The layout is fixed (little endian, no padding) so records can be written to files,
+// shared memory or sockets as they are and compared with memcmp. Equal positions pack to equal bytes.
+struct PackedPosition
+{
+    uint64_t occupancy{0};
+    // the piece (0 to 11) of the n-th occupied square in the low nibble of byte n / 2 for even n, the high one for odd
+    uint8_t pieces[16]{};
+    uint16_t half_move_clock{0};
+    uint16_t full_move{1};
+    uint8_t stm{WHITE};
+    uint8_t ep{SQUARE_NONE};
+    // the rights in the low nibble. The rook files of the rights follow in three bits each, in the order of the right
+    // bits and xored with the standard files so that standard positions leave them zero: the low eight bits in
+    // castling_files, the rest in the high nibble.
+    uint8_t castling_rights{CASTLING_NONE};
+    uint8_t castling_files{0};
+
+    static PackedPosition pack(const Position &position);
+    // false for records no position packs to: more than 32 pieces, unknown pieces or state out of range. Attacks are
+    // left empty, Board::update_attacks computes them before moves are generated.
+    bool unpack(Position &position) const;
+
+    bool operator==(const PackedPosition &) const = default;
+};
+
+static_assert(sizeof(PackedPosition) == 32 && std::is_trivially_copyable_v<PackedPosition>);
+} // namespace db
@@ -0,0 +1,315 @@
+#include "pgn.hxx"
+
+#include <cctype>
+
+namespace db {
+
+static bool is_result(std::string_view token)
+{
+    return token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*";
+}
+
+static bool is_token_end(char c)
+{
+    return std::isspace(static_cast<unsigned char>(c)) || c == '{' || c == '}' || c == '(' || c == ')' || c == ';';
+}
+
+// move suffix annotations as defined by the PGN standard, ! = $1 ... ?! = $6
+static uint8_t suffix_nag(std::string_view suffix)
+{
+    if (suffix == "!")
+        return 1;
+    if (suffix == "?")
+        return 2;
+    if (suffix == "!!")
+        return 3;
+    if (suffix == "??")
+        return 4;
+    if (suffix == "!?")
+        return 5;
+    if (suffix == "?!")
+        return 6;
+    return 0;
+}
+
+std::string PgnGame::tag(std::string_view name) const
+{
+    for (const auto &[key, value] : tags) {
+        if (key == name)
+            return value;
+    }
+    return {};
+}
+
+PgnReader::PgnReader(std::istream &in)
+    : m_in(in)
+    , m_has_line(false)
+    , m_skipped(0)
+{}
+
+bool PgnReader::read(PgnGame &game)
+{
+    std::string tags;
+    std::string movetext;
+    while (read_sections(tags, movetext)) {
+        if (parse(tags, movetext, game))
+            return true;
+        ++m_skipped;
+    }
+    return false;
+}
+
+bool PgnReader::read_sections(std::string &tags, std::string &movetext)
+{
+    tags.clear();
+    movetext.clear();
+    while (m_has_line || std::getline(m_in, m_line)) {
+        m_has_line = false;
+        if (!m_line.empty() && m_line.back() == '\r')
+            m_line.pop_back();
+        if (m_line.empty()) {
+            if (!movetext.empty())
+                return true;
+            continue;
+        }
+        if (m_line.front() == '[') {
+            // a tag after movetext belongs to the next game, it is kept for the next call
+            if (!movetext.empty()) {
+                m_has_line = true;
+                return true;
+            }
+            tags += m_line;
+            tags += '\n';
+            continue;
+        }
+        if (m_line.front() == '%')
+            continue;
+        movetext += m_line;
+        movetext += '\n';
+    }
+    return !tags.empty() || !movetext.empty();
+}
+
+bool PgnReader::parse(const std::string &tags, const std::string &movetext, PgnGame &game)
+{
+    game.tags.clear();
+    game.result = "*";
+    std::string fen;
+    for (size_t begin = 0, end; begin < tags.size(); begin = end + 1) {
+        end = tags.find('\n', begin);
+        std::string_view line(tags.data() + begin, end - begin);
+        size_t name_end = line.find(' ');
+        size_t value_begin = line.find('"');
+        size_t value_end = line.rfind('"');
+        if (name_end == std::string_view::npos || value_begin == std::string_view::npos || value_end <= value_begin)
+            continue;
+        std::string value;
+        for (size_t i = value_begin + 1; i < value_end; ++i) {
+            if (line[i] == '\\' && i + 1 < value_end)
+                ++i;
+            value.push_back(line[i]);
+        }
+        game.tags.emplace_back(std::string(line.substr(1, name_end - 1)), std::move(value));
+        if (game.tags.back().first == "FEN")
+            fen = game.tags.back().second;
+    }
+    if (fen.empty())
+        fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    if (!m_board.set_fen(fen))
+        return false;
+    game.game = Game(fen);
+
+    MoveId last = 0;
+    int depth = 0;
+    const std::string_view text = movetext;
+    for (size_t i = 0; i < text.size();) {
+        char c = text[i];
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            ++i;
+        } else if (c == '{') {
+            size_t end = text.find('}', i);
+            if (end == std::string_view::npos)
+                return false;
+            if (depth == 0 && last != 0) {
+                std::string comment(text.substr(i + 1, end - i - 1));
+                for (auto &ch : comment) {
+                    if (ch == '\n')
+                        ch = ' ';
+                }
+                size_t first = comment.find_first_not_of(' ');
+                size_t final = comment.find_last_not_of(' ');
+                game.game.set_comment(last, first == std::string::npos ? std::string()
+                                                                       : comment.substr(first, final - first + 1));
+            }
+            i = end + 1;
+        } else if (c == ';') {
+            size_t end = text.find('\n', i);
+            i = end == std::string_view::npos ? text.size() : end + 1;
+        } else if (c == '(') {
+            ++depth;
+            ++i;
+        } else if (c == ')') {
+            --depth;
+            ++i;
+        } else if (depth > 0) {
+            // everything inside a variation is skipped
+            ++i;
+        } else {
+            size_t end = i;
+            while (end < text.size() && !is_token_end(text[end]))
+                ++end;
+            std::string_view token = text.substr(i, end - i);
+            i = end;
+            if (is_result(token)) {
+                game.result = std::string(token);
+                continue;
+            }
+            if (token.front() == '$') {
+                if (last != 0)
+                    game.game.add_nag(last, uint8_t(std::atoi(std::string(token.substr(1)).c_str())));
+                continue;
+            }
+            // move numbers, possibly glued to the move as in "12.e4"
+            size_t number_end = 0;
+            while (number_end < token.size() && std::isdigit(static_cast<unsigned char>(token[number_end])))
+                ++number_end;
+            if (number_end > 0 && number_end < token.size() && token[number_end] == '.') {
+                while (number_end < token.size() && token[number_end] == '.')
+                    ++number_end;
+                token.remove_prefix(number_end);
+            }
+            if (token.empty())
+                continue;
+
+            size_t suffix = token.find_first_of("!?");
+            uint8_t nag = suffix == std::string_view::npos ? 0 : suffix_nag(token.substr(suffix));
+            Move move = parse_san(m_board, token.substr(0, suffix));
+            if (!move.is_legal)
+                return false;
+            Move printed = move;
+            m_board.prepare_for_print(printed);
+            game.game.add_move(printed);
+            m_board.do_move(move);
+            last = game.game.current_move();
+            if (nag)
+                game.game.add_nag(last, nag);
+        }
+    }
+    return true;
+}
+
+Move parse_san(Board &board, std::string_view san)
+{
+    while (!san.empty() && (san.back() == '+' || san.back() == '#'))
+        san.remove_suffix(1);
+    Move none;
+    if (san.empty())
+        return none;
+
+    const std::vector<Move> moves = board.generate_moves();
+    if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+        const bool king_side = san.size() == 3;
+        for (const auto &move : moves) {
+            if (move.is_castling && (move.to > move.from) == king_side)
+                return move;
+        }
+        return none;
+    }
+
+    PieceType type = PAWN;
+    size_t piece = std::string_view("NBRQK").find(san.front());
+    if (piece != std::string_view::npos) {
+        type = PieceType(KNIGHT + piece);
+        san.remove_prefix(1);
+    }
+    PieceType promoted = PIECE_TYPE_NONE;
+    if (san.size() >= 2 && std::string_view("NBRQ").find(san.back()) != std::string_view::npos) {
+        promoted = PieceType(KNIGHT + std::string_view("NBRQ").find(san.back()));
+        san.remove_suffix(1);
+        if (san.back() == '=')
+            san.remove_suffix(1);
+    }
+    if (san.size() < 2)
+        return none;
+    const char to_file = san[san.size() - 2];
+    const char to_rank = san[san.size() - 1];
+    if (to_file < 'a' || to_file > 'h' || to_rank < '1' || to_rank > '8')
+        return none;
+    const Square to = make_square(File(to_file - 'a'), Rank(to_rank - '1'));
+    san.remove_suffix(2);
+
+    int from_file = -1;
+    int from_rank = -1;
+    for (char c : san) {
+        if (c >= 'a' && c <= 'h')
+            from_file = c - 'a';
+        else if (c >= '1' && c <= '8')
+            from_rank = c - '1';
+        else if (c != 'x' && c != ':')
+            return none;
+    }
+
+    const Move *found = nullptr;
+    for (const auto &move : moves) {
+        if (type_of(move.piece_moved) != type || move.to != to || move.is_castling)
+            continue;
+        if ((move.promoted == PIECE_NONE ? PIECE_TYPE_NONE : type_of(move.promoted)) != promoted)
+            continue;
+        if ((from_file >= 0 && file_of(move.from) != from_file) || (from_rank >= 0 && rank_of(move.from) != from_rank))
+            continue;
+        if (found)
+            return none; // ambiguous
+        found = &move;
+    }
+    return found ? *found : none;
+}
+
+static void write_token(std::ostream &out, std::string &line, const std::string &token)
+{
+    // export format keeps lines below 80 characters
+    if (!line.empty() && line.size() + 1 + token.size() > 79) {
+        out << line << '\n';
+        line.clear();
+    }
+    if (!line.empty())
+        line += ' ';
+    line += token;
+}
+
+void write_pgn(std::ostream &out, const PgnGame &game)
+{
+    for (const auto &[name, value] : game.tags) {
+        out << '[' << name << " \"";
+        for (char c : value) {
+            if (c == '"' || c == '\\')
+                out << '\\';
+            out << c;
+        }
+        out << "\"]\n";
+    }
+    out << '\n';
+
+    std::string line;
+    bool needs_number = true;
+    const auto &moves = game.game.get_moves();
+    for (auto node = moves.begin() + 1; node != moves.end(); ++node) {
+        if (node->variation_level != 0)
+            continue;
+        if (node->move.color == WHITE || needs_number) {
+            std::string number = Game::move_number_text(node->move, true);
+            number.pop_back();
+            write_token(out, line, number);
+        }
+        write_token(out, line, node->move.to_san());
+        for (uint8_t nag : node->nags)
+            write_token(out, line, "$" + std::to_string(nag));
+        if (!node->comment.empty())
+            write_token(out, line, "{" + node->comment + "}");
+        // black moves carry their number again when something was written between them and the white move
+        needs_number = !node->comment.empty() || !node->nags.empty();
+    }
+    write_token(out, line, game.result);
+    out << line << "\n\n";
+}
+
+} // namespace db
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "bitboard.hxx"
+#include "game.hxx"
+
+namespace db {
+struct PgnGame
+{
+    std::vector<std::pair<std::string, std::string>> tags;
+    Game game;
+    std::string result{"*"};
+
+    [[nodiscard]] std::string tag(std::string_view name) const;
+};
+
+// Reads games one after the other from a PGN stream. Only the mainline is imported: variations are skipped while
+// comments and NAGs (including !, ?, !? ... suffixes) of mainline moves are kept. Games with illegal or unreadable
+// moves are skipped and counted.
+class PgnReader
+{
+public:
+    explicit PgnReader(std::istream &in);
+
+    // false once the input is exhausted
+    bool read(PgnGame &game);
+    [[nodiscard]] size_t skipped() const { return m_skipped; }
+
+private:
+    bool read_sections(std::string &tags, std::string &movetext);
+    bool parse(const std::string &tags, const std::string &movetext, PgnGame &game);
+
+    std::istream &m_in;
+    std::string m_line;
+    bool m_has_line;
+    size_t m_skipped;
+    Board m_board;
+};
+
+void write_pgn(std::ostream &out, const PgnGame &game);
+
+// resolves a SAN move against the board's position, is_legal is false if it does not match exactly one legal move
+Move parse_san(Board &board, std::string_view san);
+} // namespace db
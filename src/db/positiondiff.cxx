@@ -0,0 +1,142 @@
+#include "positiondiff.hxx"
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <limits>
+
+namespace db {
+
+// upper bound for both sides of the exact assignment, whose work grows with 2^targets. Larger sets (only possible in
+// odd FENs) are paired greedily.
+constexpr int max_exact_pieces = 8;
+// cost of leaving a piece unpaired, larger than any squared distance on the board so pairing always wins
+constexpr int unpaired_cost = 1000;
+
+static int distance(Square a, Square b)
+{
+    int df = file_of(a) - file_of(b);
+    int dr = rank_of(a) - rank_of(b);
+    return df * df + dr * dr;
+}
+
+static int pop_squares(Bitboard b, std::array<Square, 64> &squares)
+{
+    int count = 0;
+    while (b) {
+        squares[count++] = Square(std::countr_zero(b));
+        b &= b - 1;
+    }
+    return count;
+}
+
+static void pair_greedy(Piece piece, const std::array<Square, 64> &from, int from_count,
+                        const std::array<Square, 64> &to, int to_count, PositionDiff &diff)
+{
+    uint64_t used = 0;
+    for (int i = 0; i < from_count; ++i) {
+        int best = -1;
+        for (int j = 0; j < to_count; ++j) {
+            if (!(used & (1ULL << j)) && (best < 0 || distance(from[i], to[j]) < distance(from[i], to[best])))
+                best = j;
+        }
+        if (best < 0) {
+            diff.removed.push_back({piece, from[i], SQUARE_NONE});
+            continue;
+        }
+        used |= 1ULL << best;
+        diff.moved.push_back({piece, from[i], to[best]});
+    }
+    for (int j = 0; j < to_count; ++j) {
+        if (!(used & (1ULL << j)))
+            diff.added.push_back({piece, SQUARE_NONE, to[j]});
+    }
+}
+
+// exact minimum cost assignment by dynamic programming over the subsets of targets already taken
+static void pair_exact(Piece piece, const std::array<Square, 64> &from, int from_count,
+                       const std::array<Square, 64> &to, int to_count, PositionDiff &diff)
+{
+    const int states = 1 << to_count;
+    constexpr int unreachable = std::numeric_limits<int>::max() / 2;
+    std::array<int, 1 << max_exact_pieces> cost{};
+    std::array<int, 1 << max_exact_pieces> next{};
+    // choice[i][mask]: target taken by the i-th source to reach mask, -1 when it stays unpaired
+    std::array<std::array<int8_t, 1 << max_exact_pieces>, max_exact_pieces> choice;
+
+    cost.fill(unreachable);
+    cost[0] = 0;
+    for (int i = 0; i < from_count; ++i) {
+        next.fill(unreachable);
+        for (int mask = 0; mask < states; ++mask) {
+            if (cost[mask] == unreachable)
+                continue;
+            if (cost[mask] + unpaired_cost < next[mask]) {
+                next[mask] = cost[mask] + unpaired_cost;
+                choice[i][mask] = -1;
+            }
+            for (int j = 0; j < to_count; ++j) {
+                if (mask & (1 << j))
+                    continue;
+                int with = mask | (1 << j);
+                int c = cost[mask] + distance(from[i], to[j]);
+                if (c < next[with]) {
+                    next[with] = c;
+                    choice[i][with] = int8_t(j);
+                }
+            }
+        }
+        cost = next;
+    }
+
+    int best_mask = 0;
+    for (int mask = 0; mask < states; ++mask) {
+        // every target left over is a piece that appears, which costs the same as one that disappears
+        int total = cost[mask] + (to_count - std::popcount(unsigned(mask))) * unpaired_cost;
+        int best_total = cost[best_mask] + (to_count - std::popcount(unsigned(best_mask))) * unpaired_cost;
+        if (cost[mask] != unreachable && total < best_total)
+            best_mask = mask;
+    }
+    int used = best_mask;
+    for (int i = from_count - 1, mask = best_mask; i >= 0; --i) {
+        int j = choice[i][mask];
+        if (j < 0) {
+            diff.removed.push_back({piece, from[i], SQUARE_NONE});
+        } else {
+            diff.moved.push_back({piece, from[i], to[j]});
+            mask &= ~(1 << j);
+        }
+    }
+    for (int j = 0; j < to_count; ++j) {
+        if (!(used & (1 << j)))
+            diff.added.push_back({piece, SQUARE_NONE, to[j]});
+    }
+}
+
+PositionDiff diff_positions(const Position &start, const Position &target)
+{
+    PositionDiff diff;
+    std::array<Square, 64> from{};
+    std::array<Square, 64> to{};
+    for (Color color : {WHITE, BLACK}) {
+        for (PieceType type = PAWN; type <= KING; ++type) {
+            Bitboard start_bb = start.by_type[type] & start.by_color[color];
+            Bitboard target_bb = target.by_type[type] & target.by_color[color];
+            diff.unchanged |= start_bb & target_bb;
+            Bitboard gone = start_bb & ~target_bb;
+            Bitboard arrived = target_bb & ~start_bb;
+            if (!gone && !arrived)
+                continue;
+            int from_count = pop_squares(gone, from);
+            int to_count = pop_squares(arrived, to);
+            Piece piece = make_piece(type, color);
+            if (from_count <= max_exact_pieces && to_count <= max_exact_pieces)
+                pair_exact(piece, from, from_count, to, to_count, diff);
+            else
+                pair_greedy(piece, from, from_count, to, to_count, diff);
+        }
+    }
+    return diff;
+}
+
+} // namespace db
@@ -0,0 +1,29 @@
+#pragma once
+#include <vector>
+
+#include "bitboard.hxx"
+#include "types.hxx"
+
+namespace db {
+// A piece that travels between two positions. from is SQUARE_NONE for pieces that only exist in the target position
+// and to is SQUARE_NONE for pieces that only exist in the start position.
+struct PieceMotion
+{
+    Piece piece;
+    Square from;
+    Square to;
+};
+
+struct PositionDiff
+{
+    std::vector<PieceMotion> moved;
+    std::vector<PieceMotion> removed;
+    std::vector<PieceMotion> added;
+    Bitboard unchanged{0}; // squares holding the same piece in both positions
+};
+
+// Computes which pieces moved, disappeared or appeared between two arbitrary positions. Pieces of the same kind are
+// paired so that the total distance travelled is minimal, the work is bounded by the number of pieces that differ
+// rather than by the number of squares.
+PositionDiff diff_positions(const Position &start, const Position &target);
+} // namespace db
@@ -0,0 +1,67 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "types.hxx"
+
+// Zobrist hashing keys. The table follows the Polyglot layout: 64 keys for each of the twelve pieces in the order
+// black pawn, white pawn, black knight, ... white king, then four castling keys, eight en passant file keys and the
+// key for white to move.
+namespace db::zobrist {
+constexpr size_t CASTLING_OFFSET = 768;
+constexpr size_t EP_OFFSET = 772;
+constexpr size_t TURN_OFFSET = 780;
+constexpr size_t KEY_COUNT = 781;
+
+constexpr std::array<uint64_t, KEY_COUNT> generate_keys()
+{
+    // splitmix64 with a fixed seed, hashes are stable between runs and builds
+    std::array<uint64_t, KEY_COUNT> keys{};
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    for (auto &key : keys) {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        key = z ^ (z >> 31);
+    }
+    return keys;
+}
+
+inline constexpr std::array<uint64_t, KEY_COUNT> keys = generate_keys();
+
+constexpr size_t piece_index(Piece piece)
+{
+    const size_t type = piece >= PIECE_TYPES ? piece - PIECE_TYPES : piece;
+    return 2 * type + (piece < PIECE_TYPES ? 1 : 0);
+}
+
+constexpr uint64_t piece_key(Piece piece, Square square)
+{
+    return keys[64 * piece_index(piece) + square];
+}
+
+constexpr uint64_t castling_key(uint8_t castling_rights)
+{
+    uint64_t key = 0;
+    if (castling_rights & WHITE_CASTLING_OO)
+        key ^= keys[CASTLING_OFFSET + 0];
+    if (castling_rights & WHITE_CASTLING_OOO)
+        key ^= keys[CASTLING_OFFSET + 1];
+    if (castling_rights & BLACK_CASTLING_OO)
+        key ^= keys[CASTLING_OFFSET + 2];
+    if (castling_rights & BLACK_CASTLING_OOO)
+        key ^= keys[CASTLING_OFFSET + 3];
+    return key;
+}
+
+constexpr uint64_t ep_key(Square ep)
+{
+    return ep == SQUARE_NONE ? 0 : keys[EP_OFFSET + ep % RANK_WIDTH];
+}
+
+constexpr uint64_t turn_key(Color stm)
+{
+    return stm == WHITE ? keys[TURN_OFFSET] : 0;
+}
+} // namespace db::zobrist
@@ -0,0 +1,35 @@
+#include "evaluate.hxx"
+
+#include <algorithm>
+#include <bit>
+
+namespace engine {
+
+static int taper(int mg, int eg, int phase, db::Color stm)
+{
+    phase = std::min(phase, db::psqt::PHASE_MAX);
+    const int white_score = (mg * phase + eg * (db::psqt::PHASE_MAX - phase)) / db::psqt::PHASE_MAX;
+    return stm == db::WHITE ? white_score : -white_score;
+}
+
+int evaluate(const db::Position &position)
+{
+    return taper(position.psqt_mg, position.psqt_eg, position.phase, position.stm);
+}
+
+int evaluate_from_scratch(const db::Position &position)
+{
+    int mg = 0;
+    int eg = 0;
+    int phase = 0;
+    for (db::Bitboard b = position.by_color[db::WHITE] | position.by_color[db::BLACK]; b; b &= b - 1) {
+        const db::Square square = db::Square(std::countr_zero(b));
+        const db::Piece piece = position.board[square];
+        mg += db::psqt::score(piece, square).mg;
+        eg += db::psqt::score(piece, square).eg;
+        phase += db::psqt::phase_weight[db::type_of(piece)];
+    }
+    return taper(mg, eg, phase, position.stm);
+}
+
+} // namespace engine
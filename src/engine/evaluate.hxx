@@ -0,0 +1,10 @@
+#pragma once
+#include "bitboard.hxx"
+
+namespace engine {
+// static evaluation in centipawns from the point of view of the side to move, tapered between the middlegame and
+// endgame sums the position keeps up to date
+int evaluate(const db::Position &position);
+// the same evaluation summed up from the pieces on the board, to check and measure the incremental one
+int evaluate_from_scratch(const db::Position &position);
+} // namespace engine
@@ -0,0 +1,403 @@
+#include "nnue.hxx"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+
+#if defined(__AVX2__) || defined(__AVX512BW__)
+#include <immintrin.h>
+#endif
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace engine::nnue {
+
+namespace {
+constexpr char MAGIC[8] = "CHNNUE1";
+constexpr size_t HEADER_SIZE = 64;
+
+constexpr size_t align64(size_t size)
+{
+    return (size + 63) / 64 * 64;
+}
+
+// byte sizes of the arrays in file order
+constexpr size_t array_sizes[] = {
+    HIDDEN * sizeof(int16_t),          HIDDEN * size_t(INPUTS) * sizeof(int16_t), L1 * sizeof(int32_t),
+    L1 * 2 * HIDDEN * sizeof(int8_t),  L2 * sizeof(int32_t),                      L2 * L1 * sizeof(int8_t),
+    L2 * sizeof(int8_t),               sizeof(int32_t),
+};
+
+constexpr size_t file_size()
+{
+    size_t size = HEADER_SIZE;
+    for (size_t array_size : array_sizes)
+        size += align64(array_size);
+    return size;
+}
+
+int feature(db::Color perspective, db::Square king, db::Piece piece, db::Square square)
+{
+    // black sees the board flipped so that both sides share the weights
+    const int flip = perspective == db::WHITE ? 0 : 56;
+    const int piece_index = db::type_of(piece) + (db::color_of(piece) == perspective ? 0 : 5);
+    return (king ^ flip) * PIECE_INPUTS + piece_index * 64 + (square ^ flip);
+}
+
+// out = in + sum of add rows - sum of sub rows over HIDDEN values, in and out may be the same
+void apply_rows(int16_t *out, const int16_t *in, const int16_t *const *add, int add_count, const int16_t *const *sub,
+                int sub_count)
+{
+#if defined(__AVX512BW__)
+    for (int i = 0; i < HIDDEN; i += 32) {
+        __m512i v = _mm512_loadu_si512(in + i);
+        for (int k = 0; k < add_count; ++k)
+            v = _mm512_add_epi16(v, _mm512_loadu_si512(add[k] + i));
+        for (int k = 0; k < sub_count; ++k)
+            v = _mm512_sub_epi16(v, _mm512_loadu_si512(sub[k] + i));
+        _mm512_storeu_si512(out + i, v);
+    }
+#elif defined(__AVX2__)
+    for (int i = 0; i < HIDDEN; i += 16) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+        for (int k = 0; k < add_count; ++k)
+            v = _mm256_add_epi16(v, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(add[k] + i)));
+        for (int k = 0; k < sub_count; ++k)
+            v = _mm256_sub_epi16(v, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(sub[k] + i)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), v);
+    }
+#else
+    for (int i = 0; i < HIDDEN; ++i) {
+        int16_t v = in[i];
+        for (int k = 0; k < add_count; ++k)
+            v = int16_t(v + add[k][i]);
+        for (int k = 0; k < sub_count; ++k)
+            v = int16_t(v - sub[k][i]);
+        out[i] = v;
+    }
+#endif
+}
+
+// clamps HIDDEN accumulator values to 0..127
+void clipped_relu(uint8_t *out, const int16_t *in)
+{
+#if defined(__AVX512BW__)
+    // packs works within 128 bit lanes, the permutation puts the lanes back in order
+    const __m512i order = _mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7);
+    for (int i = 0; i < HIDDEN; i += 64) {
+        __m512i packed = _mm512_packs_epi16(_mm512_loadu_si512(in + i), _mm512_loadu_si512(in + i + 32));
+        packed = _mm512_max_epi8(packed, _mm512_setzero_si512());
+        _mm512_storeu_si512(out + i, _mm512_permutexvar_epi64(order, packed));
+    }
+#elif defined(__AVX2__)
+    for (int i = 0; i < HIDDEN; i += 32) {
+        __m256i packed = _mm256_packs_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i)),
+                                            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i + 16)));
+        packed = _mm256_max_epi8(packed, _mm256_setzero_si256());
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_permute4x64_epi64(packed, 0xd8));
+    }
+#else
+    for (int i = 0; i < HIDDEN; ++i)
+        out[i] = uint8_t(std::clamp<int>(in[i], 0, 127));
+#endif
+}
+
+// inputs are at most 127, so the pairwise int16 sums of maddubs cannot saturate and every kernel gives the same sum
+int32_t dot(const uint8_t *in, const int8_t *weights, int size)
+{
+    int i = 0;
+    int32_t sum = 0;
+#if defined(__AVX512BW__)
+    if (size >= 64) {
+        __m512i acc = _mm512_setzero_si512();
+        for (; i + 64 <= size; i += 64) {
+            __m512i products = _mm512_maddubs_epi16(_mm512_loadu_si512(in + i), _mm512_loadu_si512(weights + i));
+            acc = _mm512_add_epi32(acc, _mm512_madd_epi16(products, _mm512_set1_epi16(1)));
+        }
+        sum += _mm512_reduce_add_epi32(acc);
+    }
+#endif
+#if defined(__AVX2__)
+    if (i + 32 <= size) {
+        __m256i acc = _mm256_setzero_si256();
+        for (; i + 32 <= size; i += 32) {
+            __m256i products =
+                _mm256_maddubs_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i)),
+                                     _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weights + i)));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(products, _mm256_set1_epi16(1)));
+        }
+        __m128i half = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4e));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xb1));
+        sum += _mm_cvtsi128_si32(half);
+    }
+#endif
+    for (; i < size; ++i)
+        sum += int32_t(in[i]) * weights[i];
+    return sum;
+}
+
+// fully connected layer with clipped ReLU output
+void affine(uint8_t *out, const uint8_t *in, const int8_t *weights, const int32_t *biases, int inputs, int outputs)
+{
+    for (int j = 0; j < outputs; ++j) {
+        int32_t sum = biases[j] + dot(in, weights + size_t(j) * inputs, inputs);
+        out[j] = uint8_t(std::clamp(sum >> WEIGHT_SCALE_BITS, 0, 127));
+    }
+}
+
+db::Square king_square(const db::Position &position, db::Color color)
+{
+    return db::Square(std::countr_zero(position.by_type[db::KING] & position.by_color[color]));
+}
+} // namespace
+
+const char *kernel_name()
+{
+#if defined(__AVX512BW__)
+    return "avx512";
+#elif defined(__AVX2__)
+    return "avx2";
+#else
+    return "scalar";
+#endif
+}
+
+Network::~Network()
+{
+#ifdef __unix__
+    if (m_mapped)
+        munmap(const_cast<uint8_t *>(m_data), m_size);
+#endif
+}
+
+void Network::assign(const uint8_t *data)
+{
+    m_data = data;
+    m_size = file_size();
+    const uint8_t *arrays[std::size(array_sizes)];
+    size_t offset = HEADER_SIZE;
+    for (size_t i = 0; i < std::size(array_sizes); ++i) {
+        arrays[i] = data + offset;
+        offset += align64(array_sizes[i]);
+    }
+    ft_biases = reinterpret_cast<const int16_t *>(arrays[0]);
+    ft_weights = reinterpret_cast<const int16_t *>(arrays[1]);
+    l1_biases = reinterpret_cast<const int32_t *>(arrays[2]);
+    l1_weights = reinterpret_cast<const int8_t *>(arrays[3]);
+    l2_biases = reinterpret_cast<const int32_t *>(arrays[4]);
+    l2_weights = reinterpret_cast<const int8_t *>(arrays[5]);
+    out_weights = reinterpret_cast<const int8_t *>(arrays[6]);
+    out_bias = reinterpret_cast<const int32_t *>(arrays[7]);
+}
+
+std::unique_ptr<Network> Network::load(const std::string &path)
+{
+    std::unique_ptr<Network> network(new Network());
+    const uint8_t *data = nullptr;
+#ifdef __unix__
+    // mapped read only, the pages are shared with every other process using the same file
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("cannot open " + path);
+    struct stat status;
+    if (fstat(fd, &status) != 0 || size_t(status.st_size) != file_size()) {
+        close(fd);
+        throw std::runtime_error(path + " does not have the size of a network");
+    }
+    void *mapping = mmap(nullptr, file_size(), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error("cannot map " + path);
+    data = static_cast<const uint8_t *>(mapping);
+    network->m_mapped = true;
+    network->assign(data);
+#else
+    std::ifstream in(path, std::ios::binary);
+    network->m_owned.resize(file_size());
+    if (!in.read(reinterpret_cast<char *>(network->m_owned.data()), std::streamsize(file_size())) ||
+        in.peek() != std::ifstream::traits_type::eof())
+        throw std::runtime_error(path + " does not have the size of a network");
+    data = network->m_owned.data();
+    network->assign(data);
+#endif
+    uint32_t dimensions[4];
+    std::memcpy(dimensions, data + sizeof(MAGIC), sizeof(dimensions));
+    if (std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0 || dimensions[0] != INPUTS || dimensions[1] != HIDDEN ||
+        dimensions[2] != L1 || dimensions[3] != L2)
+        throw std::runtime_error(path + " is not a network of this architecture");
+    return network;
+}
+
+std::unique_ptr<Network> Network::random(uint64_t seed)
+{
+    std::unique_ptr<Network> network(new Network());
+    std::vector<uint8_t> &data = network->m_owned;
+    data.assign(file_size(), 0);
+    std::memcpy(data.data(), MAGIC, sizeof(MAGIC));
+    const uint32_t dimensions[4] = {INPUTS, HIDDEN, L1, L2};
+    std::memcpy(data.data() + sizeof(MAGIC), dimensions, sizeof(dimensions));
+    network->assign(data.data());
+
+    // ranges that keep the activations inside the clipped range most of the time
+    std::mt19937_64 random(seed);
+    auto fill = [&](const auto *array, size_t count, int low, int high) {
+        using T = std::remove_const_t<std::remove_pointer_t<decltype(array)>>;
+        T *values = const_cast<T *>(array);
+        std::uniform_int_distribution<int> distribution(low, high);
+        for (size_t i = 0; i < count; ++i)
+            values[i] = T(distribution(random));
+    };
+    fill(network->ft_biases, HIDDEN, 0, 64);
+    fill(network->ft_weights, size_t(INPUTS) * HIDDEN, -8, 8);
+    fill(network->l1_biases, L1, -512, 512);
+    fill(network->l1_weights, size_t(L1) * 2 * HIDDEN, -4, 4);
+    fill(network->l2_biases, L2, -512, 512);
+    fill(network->l2_weights, size_t(L2) * L1, -32, 32);
+    fill(network->out_weights, L2, -64, 64);
+    fill(network->out_bias, 1, -256, 256);
+    return network;
+}
+
+void Network::save(const std::string &path) const
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out.write(reinterpret_cast<const char *>(m_data), std::streamsize(m_size)))
+        throw std::runtime_error("cannot write " + path);
+}
+
+Evaluator::Evaluator(const Network &network)
+    : m_network(network)
+    , m_states(128)
+    , m_ply(0)
+{}
+
+void Evaluator::reset(const db::Position &)
+{
+    m_ply = 0;
+    m_states[0].computed[db::WHITE] = m_states[0].computed[db::BLACK] = false;
+    m_states[0].dirty_count = 0;
+    m_states[0].king_moved = db::COLOR_NONE;
+}
+
+void Evaluator::push(const db::Move &move)
+{
+    if (++m_ply == m_states.size())
+        m_states.resize(2 * m_states.size());
+    State &state = m_states[m_ply];
+    state.computed[db::WHITE] = state.computed[db::BLACK] = false;
+    state.king_moved = db::type_of(move.piece_moved) == db::KING ? move.color : db::COLOR_NONE;
+
+    int count = 0;
+    const db::Piece placed = move.promoted != db::PIECE_NONE ? move.promoted : move.piece_moved;
+    if (move.captured != db::PIECE_NONE) {
+        db::Square captured_on = move.is_enpassant ? db::Square(move.color == db::WHITE ? move.to - 8 : move.to + 8)
+                                                   : move.to;
+        state.dirty[count++] = {move.captured, captured_on, db::SQUARE_NONE};
+    }
+    if (move.is_castling) {
+        // the king takes its own rook, both move on to their castled squares
+        state.dirty[count++] = {move.piece_moved, move.from, move.castling_king_to()};
+        state.dirty[count++] = {db::make_piece(db::ROOK, move.color), move.to, move.castling_rook_to()};
+    } else if (placed == move.piece_moved) {
+        state.dirty[count++] = {move.piece_moved, move.from, move.to};
+    } else {
+        state.dirty[count++] = {move.piece_moved, move.from, db::SQUARE_NONE};
+        state.dirty[count++] = {placed, db::SQUARE_NONE, move.to};
+    }
+    state.dirty_count = count;
+}
+
+void Evaluator::pop()
+{
+    --m_ply;
+}
+
+int Evaluator::evaluate(const db::Position &position)
+{
+    State &current = m_states[m_ply];
+    for (db::Color perspective : {db::WHITE, db::BLACK}) {
+        if (current.computed[perspective])
+            continue;
+        // back to the closest computed ancestor, a move of this side's king invalidates everything before it
+        size_t ply = m_ply;
+        while (ply > 0 && !m_states[ply].computed[perspective] && m_states[ply].king_moved != perspective)
+            --ply;
+        if (!m_states[ply].computed[perspective]) {
+            refresh(m_network, current, perspective, position);
+            continue;
+        }
+        const db::Square king = king_square(position, perspective);
+        for (++ply; ply <= m_ply; ++ply)
+            update(m_network, m_states[ply], m_states[ply - 1], perspective, king);
+    }
+    return forward(m_network, current, position.stm);
+}
+
+int Evaluator::evaluate_from_scratch(const Network &network, const db::Position &position)
+{
+    State state;
+    refresh(network, state, db::WHITE, position);
+    refresh(network, state, db::BLACK, position);
+    return forward(network, state, position.stm);
+}
+
+void Evaluator::refresh(const Network &network, State &state, db::Color perspective, const db::Position &position)
+{
+    const db::Square king = king_square(position, perspective);
+    const db::Bitboard occupied = position.by_color[db::WHITE] | position.by_color[db::BLACK];
+    const int16_t *rows[32];
+    int count = 0;
+    for (db::Bitboard b = occupied & ~position.by_type[db::KING]; b; b &= b - 1) {
+        const db::Square square = db::Square(std::countr_zero(b));
+        const int index = feature(perspective, king, position.board[square], square);
+        rows[count++] = network.ft_weights + size_t(index) * HIDDEN;
+    }
+    apply_rows(state.accumulator[perspective], network.ft_biases, rows, count, nullptr, 0);
+    state.computed[perspective] = true;
+}
+
+void Evaluator::update(const Network &network, State &state, const State &parent, db::Color perspective,
+                       db::Square king)
+{
+    const int16_t *added[3];
+    const int16_t *removed[3];
+    int add_count = 0;
+    int remove_count = 0;
+    for (int i = 0; i < state.dirty_count; ++i) {
+        const DirtyPiece &dirty = state.dirty[i];
+        if (db::type_of(dirty.piece) == db::KING)
+            continue;
+        if (dirty.from != db::SQUARE_NONE)
+            removed[remove_count++] =
+                network.ft_weights + size_t(feature(perspective, king, dirty.piece, dirty.from)) * HIDDEN;
+        if (dirty.to != db::SQUARE_NONE)
+            added[add_count++] =
+                network.ft_weights + size_t(feature(perspective, king, dirty.piece, dirty.to)) * HIDDEN;
+    }
+    apply_rows(state.accumulator[perspective], parent.accumulator[perspective], added, add_count, removed,
+               remove_count);
+    state.computed[perspective] = true;
+}
+
+int Evaluator::forward(const Network &network, const State &state, db::Color stm)
+{
+    alignas(64) uint8_t input[2 * HIDDEN];
+    alignas(64) uint8_t hidden1[L1];
+    alignas(64) uint8_t hidden2[L2];
+    // the side to move always comes first
+    clipped_relu(input, state.accumulator[stm]);
+    clipped_relu(input + HIDDEN, state.accumulator[db::opposite(stm)]);
+    affine(hidden1, input, network.l1_weights, network.l1_biases, 2 * HIDDEN, L1);
+    affine(hidden2, hidden1, network.l2_weights, network.l2_biases, L1, L2);
+    return (network.out_bias[0] + dot(hidden2, network.out_weights, L2)) / OUTPUT_SCALE;
+}
+
+} // namespace engine::nnue
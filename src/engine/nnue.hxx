@@ -0,0 +1,107 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bitboard.hxx"
+
+// Efficiently updatable neural network evaluation. The input layer is HalfKP: for each side a one-hot encoding of
+// every non-king piece on its square relative to that side's king, so that a move only changes a couple of inputs and
+// the first layer's output (the accumulator) is updated by adding and subtracting weight rows. The rest is a small
+// quantized network: 2x256 -> 32 -> 32 -> 1 with clipped ReLU activations, int16 first layer and int8 weights after.
+namespace engine::nnue {
+constexpr int PIECE_INPUTS = 10 * 64; // own and enemy pawn ... queen on every square
+constexpr int INPUTS = 64 * PIECE_INPUTS;
+constexpr int HIDDEN = 256;
+constexpr int L1 = 32;
+constexpr int L2 = 32;
+constexpr int WEIGHT_SCALE_BITS = 6;
+constexpr int OUTPUT_SCALE = 16;
+
+// name of the SIMD kernels this build uses: "avx512", "avx2" or "scalar"
+const char *kernel_name();
+
+// Weights of a network, either mapped read only from a file or owned. File layout (little endian): a 64 byte header
+// starting with the magic "CHNNUE1" followed by the dimensions as four uint32, then the arrays in the order of the
+// members below. Every array starts 64 byte aligned.
+class Network
+{
+public:
+    ~Network();
+    Network(const Network &) = delete;
+    Network &operator=(const Network &) = delete;
+
+    // throws std::runtime_error if the file cannot be read or does not match the architecture
+    static std::unique_ptr<Network> load(const std::string &path);
+    // small random weights, for benchmarks and as a starting point for training
+    static std::unique_ptr<Network> random(uint64_t seed);
+    void save(const std::string &path) const;
+    [[nodiscard]] bool is_mapped() const { return m_mapped; }
+
+    const int16_t *ft_biases;  // [HIDDEN]
+    const int16_t *ft_weights; // [INPUTS][HIDDEN]
+    const int32_t *l1_biases;  // [L1]
+    const int8_t *l1_weights;  // [L1][2 * HIDDEN]
+    const int32_t *l2_biases;  // [L2]
+    const int8_t *l2_weights;  // [L2][L1]
+    const int8_t *out_weights; // [L2]
+    const int32_t *out_bias;   // [1]
+
+private:
+    Network() = default;
+    void assign(const uint8_t *data);
+
+    const uint8_t *m_data{nullptr};
+    size_t m_size{0};
+    bool m_mapped{false};
+    std::vector<uint8_t> m_owned;
+};
+
+// Evaluates the positions of one search path, one per searching thread. push() and pop() follow do_move() and
+// undo_move(); accumulators are only brought up to date when a position is evaluated, from the closest computed
+// ancestor, so interior nodes that are never evaluated cost nothing.
+class Evaluator
+{
+public:
+    explicit Evaluator(const Network &network);
+
+    // starts a new path at position, its accumulators are computed on the first evaluation
+    void reset(const db::Position &position);
+    // move has just been made on the board
+    void push(const db::Move &move);
+    void pop();
+    // centipawns from the point of view of the side to move, position is the one at the end of the path
+    int evaluate(const db::Position &position);
+
+    // computes the accumulators from scratch, to check the incremental updates against
+    static int evaluate_from_scratch(const Network &network, const db::Position &position);
+
+private:
+    struct DirtyPiece
+    {
+        db::Piece piece;
+        db::Square from; // SQUARE_NONE if the piece was added
+        db::Square to;   // SQUARE_NONE if the piece was removed
+    };
+    struct alignas(64) State
+    {
+        int16_t accumulator[2][HIDDEN];
+        bool computed[2];
+        // changes made by the move leading here
+        DirtyPiece dirty[3];
+        int dirty_count;
+        db::Color king_moved; // COLOR_NONE unless the move was made by a king
+    };
+
+    static void refresh(const Network &network, State &state, db::Color perspective, const db::Position &position);
+    static void update(const Network &network, State &state, const State &parent, db::Color perspective,
+                       db::Square king);
+    static int forward(const Network &network, const State &state, db::Color stm);
+
+    const Network &m_network;
+    std::vector<State> m_states;
+    size_t m_ply;
+};
+} // namespace engine::nnue
@@ -0,0 +1,309 @@
+#include "search.hxx"
+
+#include <algorithm>
+
+#include "evaluate.hxx"
+
+namespace engine {
+
+// mate and tablebase scores are stored relative to the node so that they stay valid wherever the position is reached
+// again
+static int score_to_tt(int score, int ply)
+{
+    return score >= VALUE_TB_WIN_IN_MAX_PLY ? score + ply : score <= -VALUE_TB_WIN_IN_MAX_PLY ? score - ply : score;
+}
+
+static int score_from_tt(int score, int ply)
+{
+    return score >= VALUE_TB_WIN_IN_MAX_PLY ? score - ply : score <= -VALUE_TB_WIN_IN_MAX_PLY ? score + ply : score;
+}
+
+static bool is_tt_move(const db::Move &move, const TTEntry &entry)
+{
+    return move.from == entry.from && move.to == entry.to &&
+           (move.promoted == db::PIECE_NONE ? entry.promoted == db::PIECE_TYPE_NONE
+                                            : db::type_of(move.promoted) == entry.promoted);
+}
+
+// iteration skipping of the helper threads, helper i searches depth d unless ((d + phase) / size) is odd
+static constexpr int skip_size[] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+static constexpr int skip_phase[] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+Search::Search()
+    : m_tt(nullptr)
+    , m_thread_index(0)
+    , m_tablebases(nullptr)
+    , m_stop(nullptr)
+    , m_aborted(false)
+    , m_nodes(0)
+    , m_pv_length{0}
+    , m_follow_pv(false)
+{}
+
+SearchInfo Search::go(const SearchLimits &limits, const std::atomic<bool> &stop, const InfoCallback &on_info)
+{
+    m_limits = limits;
+    m_stop = &stop;
+    m_aborted = false;
+    m_nodes = 0;
+    m_start = std::chrono::steady_clock::now();
+    m_prev_pv.clear();
+    if (m_nnue)
+        m_nnue->reset(m_board.get_position());
+    for (auto &killers : m_killers)
+        killers[0] = killers[1] = db::Move();
+
+    SearchInfo result;
+    const int max_depth = m_limits.depth > 0 ? std::min(m_limits.depth, MAX_PLY - 1) : MAX_PLY - 1;
+    for (int depth = 1; depth <= max_depth; ++depth) {
+        if (m_thread_index > 0) {
+            size_t i = (m_thread_index - 1) % std::size(skip_size);
+            if (depth < max_depth && ((depth + skip_phase[i]) / skip_size[i]) % 2)
+                continue;
+        }
+        m_follow_pv = true;
+        int score = negamax(depth, 0, -VALUE_INFINITE, VALUE_INFINITE);
+        // a partial iteration is never trusted, the result of the previous one is kept
+        if (m_aborted)
+            break;
+
+        result.depth = depth;
+        result.nodes = nodes();
+        result.time_ms = elapsed_ms();
+        result.is_mate = std::abs(score) >= VALUE_MATE_IN_MAX_PLY;
+        result.score = !result.is_mate ? score
+                       : score > 0     ? (VALUE_MATE - score + 1) / 2
+                                       : -(VALUE_MATE + score) / 2;
+        result.pv.assign(&m_pv[0][0], &m_pv[0][0] + m_pv_length[0]);
+        m_prev_pv = result.pv;
+        if (on_info)
+            on_info(result);
+        // no point in searching deeper once a forced mate has been found or there is nothing to play
+        if (result.is_mate || result.pv.empty())
+            break;
+    }
+    m_stop = nullptr;
+    return result;
+}
+
+int Search::negamax(int depth, int ply, int alpha, int beta)
+{
+    m_pv_length[ply] = 0;
+    if (should_stop())
+        return 0;
+    if (depth <= 0 || ply >= MAX_PLY - 1)
+        return quiescence(ply, alpha, beta);
+    count_node();
+
+    const db::Position &position = m_board.get_position();
+    if (ply > 0 && (m_board.is_fifty_move_draw() || m_board.is_repetition() || m_board.is_insufficient_material()))
+        return 0;
+
+    const uint64_t key = position.key();
+    TTEntry tt_entry;
+    const bool tt_hit = m_tt && m_tt->probe(key, tt_entry);
+    if (tt_hit && ply > 0 && tt_entry.depth >= depth) {
+        int score = score_from_tt(tt_entry.score, ply);
+        if (tt_entry.bound == Bound::EXACT || (tt_entry.bound == Bound::LOWER && score >= beta) ||
+            (tt_entry.bound == Bound::UPPER && score <= alpha))
+            return score;
+    }
+
+    // material only shrinks with captures, so the search enters the tables right after a zeroing move. There the
+    // WDL result is exact with respect to the 50 move rule and far cheaper than a DTZ probe. Other positions in the
+    // tables are only reached when the root is one already, they are the root moves and take the DTZ probe.
+    if (m_tablebases && ply > 0) {
+        const std::optional<tb::ProbeResult> result = position.half_move_clock == 0 ? m_tablebases->probe_wdl(position)
+                                                                                    : m_tablebases->probe(position);
+        if (result) {
+            // a result that takes longer than the 50 move rule allows is a draw over the board
+            if (result->wdl == tb::Wdl::DRAW || result->dtz + int(position.half_move_clock) > 100)
+                return 0;
+            return result->wdl == tb::Wdl::WIN ? VALUE_TB_WIN - ply : -VALUE_TB_WIN + ply;
+        }
+    }
+
+    std::vector<db::Move> moves = m_board.generate_moves();
+    if (moves.empty())
+        return m_board.is_check() ? -VALUE_MATE + ply : 0;
+    order_moves(moves, ply, tt_hit ? &tt_entry : nullptr);
+
+    const int original_alpha = alpha;
+    int best_score = -VALUE_INFINITE;
+    const db::Move *best_move = &moves.front();
+    for (const auto &move : moves) {
+        make_move(move);
+        int score = -negamax(depth - 1, ply + 1, -beta, -alpha);
+        unmake_move(move);
+        if (m_aborted)
+            return 0;
+        if (score <= best_score)
+            continue;
+        best_score = score;
+        best_move = &move;
+        if (score > alpha) {
+            alpha = score;
+            m_pv[ply][0] = move;
+            std::copy_n(&m_pv[ply + 1][0], m_pv_length[ply + 1], &m_pv[ply][1]);
+            m_pv_length[ply] = m_pv_length[ply + 1] + 1;
+            if (score >= beta) {
+                if (move.captured == db::PIECE_NONE && !same_move(move, m_killers[ply][0])) {
+                    m_killers[ply][1] = m_killers[ply][0];
+                    m_killers[ply][0] = move;
+                }
+                break;
+            }
+        }
+    }
+
+    if (m_tt) {
+        TTEntry entry;
+        entry.from = best_move->from;
+        entry.to = best_move->to;
+        entry.promoted =
+            best_move->promoted == db::PIECE_NONE ? db::PIECE_TYPE_NONE : db::type_of(best_move->promoted);
+        entry.score = score_to_tt(best_score, ply);
+        entry.depth = depth;
+        entry.bound = best_score >= beta             ? Bound::LOWER
+                      : best_score > original_alpha ? Bound::EXACT
+                                                    : Bound::UPPER;
+        m_tt->store(key, entry);
+    }
+    return best_score;
+}
+
+int Search::quiescence(int ply, int alpha, int beta)
+{
+    m_pv_length[ply] = 0;
+    if (should_stop())
+        return 0;
+    count_node();
+
+    const bool in_check = m_board.is_check();
+    // the pv and killer tables end at MAX_PLY, evasions must not recurse past it either
+    if (ply >= MAX_PLY - 1)
+        return in_check ? 0 : static_eval();
+    if (!in_check) {
+        int stand_pat = static_eval();
+        if (stand_pat >= beta)
+            return stand_pat;
+        alpha = std::max(alpha, stand_pat);
+    }
+
+    std::vector<db::Move> moves = m_board.generate_moves();
+    if (moves.empty())
+        return in_check ? -VALUE_MATE + ply : 0;
+    if (!in_check) {
+        // only captures and promotions that do not lose material, every evasion is searched while in check
+        std::erase_if(moves, [this](const db::Move &move) {
+            if (move.promoted != db::PIECE_NONE)
+                return false;
+            return move.captured == db::PIECE_NONE || m_board.see(move) < 0;
+        });
+    }
+    order_moves(moves, ply);
+
+    for (const auto &move : moves) {
+        make_move(move);
+        int score = -quiescence(ply + 1, -beta, -alpha);
+        unmake_move(move);
+        if (m_aborted)
+            return 0;
+        if (score > alpha) {
+            alpha = score;
+            if (score >= beta)
+                return score;
+        }
+    }
+    return alpha;
+}
+
+void Search::order_moves(std::vector<db::Move> &moves, int ply, const TTEntry *tt_entry)
+{
+    const db::Move *pv_move = nullptr;
+    if (m_follow_pv && ply < int(m_prev_pv.size()))
+        pv_move = &m_prev_pv[ply];
+    bool pv_move_found = false;
+
+    std::vector<std::pair<int, size_t>> scores;
+    scores.reserve(moves.size());
+    for (size_t i = 0; i < moves.size(); ++i) {
+        const db::Move &move = moves[i];
+        int score = 0;
+        if (tt_entry && is_tt_move(move, *tt_entry)) {
+            score = 2'000'000;
+            pv_move_found |= pv_move && same_move(move, *pv_move);
+        } else if (pv_move && same_move(move, *pv_move)) {
+            score = 1'000'000;
+            pv_move_found = true;
+        } else if (move.captured != db::PIECE_NONE) {
+            // most valuable victim, least valuable attacker. Captures that lose material by exchange go after the
+            // killers
+            score = (m_board.see(move) >= 0 ? 100'000 : 60'000) +
+                    10 * db::psqt::piece_value_mg[db::type_of(move.captured)] - db::type_of(move.piece_moved);
+        } else if (move.promoted != db::PIECE_NONE) {
+            score = 90'000 + db::psqt::piece_value_mg[db::type_of(move.promoted)];
+        } else if (same_move(move, m_killers[ply][0])) {
+            score = 80'000;
+        } else if (same_move(move, m_killers[ply][1])) {
+            score = 70'000;
+        } else if (m_thread_index > 0) {
+            // a fixed per thread shuffle of the remaining quiet moves
+            score = int(((uint32_t(move.from) * 64 + move.to) * 2654435761u + uint32_t(m_thread_index) * 40503u) >> 26);
+        }
+        scores.emplace_back(-score, i);
+    }
+    // once the path leaves the previous principal variation the rest of the tree has no hint
+    m_follow_pv = pv_move_found;
+
+    std::stable_sort(scores.begin(), scores.end(),
+                     [](const auto &lhs, const auto &rhs) { return lhs.first < rhs.first; });
+    std::vector<db::Move> ordered;
+    ordered.reserve(moves.size());
+    for (const auto &[score, index] : scores)
+        ordered.push_back(moves[index]);
+    moves.swap(ordered);
+}
+
+void Search::set_network(const nnue::Network *network)
+{
+    m_nnue = network ? std::make_unique<nnue::Evaluator>(*network) : nullptr;
+}
+
+void Search::make_move(const db::Move &move)
+{
+    m_board.do_move(move);
+    if (m_nnue)
+        m_nnue->push(move);
+}
+
+void Search::unmake_move(const db::Move &move)
+{
+    m_board.undo_move(move);
+    if (m_nnue)
+        m_nnue->pop();
+}
+
+int Search::static_eval()
+{
+    return m_nnue ? m_nnue->evaluate(m_board.get_position()) : evaluate(m_board.get_position());
+}
+
+bool Search::should_stop()
+{
+    if (m_aborted)
+        return true;
+    const uint64_t nodes = this->nodes();
+    if (m_stop->load(std::memory_order_relaxed) || (m_limits.nodes && nodes >= m_limits.nodes) ||
+        (m_limits.movetime_ms && (nodes & 1023) == 0 && elapsed_ms() >= m_limits.movetime_ms))
+        m_aborted = true;
+    return m_aborted;
+}
+
+int64_t Search::elapsed_ms() const
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_start)
+        .count();
+}
+
+} // namespace engine
@@ -0,0 +1,112 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "bitboard.hxx"
+#include "nnue.hxx"
+#include "tablebase.hxx"
+#include "transpositiontable.hxx"
+
+namespace engine {
+constexpr int MAX_PLY = 64;
+constexpr int VALUE_MATE = 32000;
+constexpr int VALUE_INFINITE = VALUE_MATE + 1;
+constexpr int VALUE_MATE_IN_MAX_PLY = VALUE_MATE - MAX_PLY;
+// tablebase wins rank below every mate the search finds itself
+constexpr int VALUE_TB_WIN = VALUE_MATE_IN_MAX_PLY - 1;
+constexpr int VALUE_TB_WIN_IN_MAX_PLY = VALUE_TB_WIN - MAX_PLY;
+
+// a limit of zero means unlimited
+struct SearchLimits
+{
+    int depth{MAX_PLY};
+    int64_t movetime_ms{0};
+    uint64_t nodes{0};
+};
+
+struct SearchInfo
+{
+    int depth{0};
+    int score{0}; // centipawns from the side to move, moves to mate (negative when mated) if is_mate
+    bool is_mate{false};
+    uint64_t nodes{0};
+    int64_t time_ms{0};
+    std::vector<db::Move> pv;
+};
+
+// Iterative deepening alpha-beta search over its own copy of the board. go() blocks the calling thread, the owner
+// cancels it from any other thread through the stop flag.
+class Search
+{
+public:
+    using InfoCallback = std::function<void(const SearchInfo &)>;
+
+    Search();
+
+    // history holds the keys of the game's earlier positions as Board::history() keeps them, a position of the
+    // search repeating one of them or one of its own path is a draw
+    void set_position(const db::Position &position, const std::vector<uint64_t> &history = {})
+    {
+        m_board.set_position(position);
+        m_board.set_history(history);
+    }
+    // the table may be shared with searches running on other threads, nullptr searches without one
+    void set_transposition_table(TranspositionTable *tt) { m_tt = tt; }
+    // helpers of a parallel search (index > 0) skip some iterations and shuffle quiet moves so that the threads
+    // spread over different parts of the tree
+    void set_thread_index(size_t index) { m_thread_index = index; }
+    // evaluates with the network instead of the piece square tables, nullptr switches back. The network must
+    // outlive the search.
+    void set_network(const nnue::Network *network);
+    // positions covered by the tables are scored from them below the root, nullptr searches without
+    void set_tablebases(const tb::Tablebases *tablebases) { m_tablebases = tablebases; }
+    const db::Position &position() const { return m_board.get_position(); }
+    const std::vector<uint64_t> &history() const { return m_board.history(); }
+    // nodes of the running or last search, readable from other threads
+    uint64_t nodes() const { return m_nodes.load(std::memory_order_relaxed); }
+
+    // reports every completed iteration through on_info and returns the last one
+    SearchInfo go(const SearchLimits &limits, const std::atomic<bool> &stop, const InfoCallback &on_info = {});
+
+    static bool same_move(const db::Move &lhs, const db::Move &rhs)
+    {
+        return lhs.from == rhs.from && lhs.to == rhs.to && lhs.promoted == rhs.promoted;
+    }
+
+private:
+    int negamax(int depth, int ply, int alpha, int beta);
+    int quiescence(int ply, int alpha, int beta);
+    void order_moves(std::vector<db::Move> &moves, int ply, const TTEntry *tt_entry = nullptr);
+    void make_move(const db::Move &move);
+    void unmake_move(const db::Move &move);
+    int static_eval();
+    bool should_stop();
+    // only the searching thread writes the counter, a plain load and store is enough
+    void count_node() { m_nodes.store(m_nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+    int64_t elapsed_ms() const;
+
+    db::Board m_board;
+    TranspositionTable *m_tt;
+    size_t m_thread_index;
+    std::unique_ptr<nnue::Evaluator> m_nnue;
+    const tb::Tablebases *m_tablebases;
+
+    SearchLimits m_limits;
+    const std::atomic<bool> *m_stop;
+    bool m_aborted;
+    std::atomic<uint64_t> m_nodes;
+    std::chrono::steady_clock::time_point m_start;
+
+    // triangular principal variation table, m_pv[ply] holds the line found from ply onwards
+    db::Move m_pv[MAX_PLY][MAX_PLY];
+    int m_pv_length[MAX_PLY];
+    // line of the previous iteration, searched first while the current path still follows it
+    std::vector<db::Move> m_prev_pv;
+    bool m_follow_pv;
+    db::Move m_killers[MAX_PLY][2];
+};
+} // namespace engine
@@ -0,0 +1,106 @@
+#include "smpsearch.hxx"
+
+#include <algorithm>
+#include <thread>
+
+namespace engine {
+
+SmpSearch::SmpSearch(size_t threads, size_t hash_mb)
+    : m_tt(hash_mb)
+    , m_network(nullptr)
+    , m_tablebases(nullptr)
+    , m_stop_helpers(false)
+{
+    set_threads(threads);
+}
+
+void SmpSearch::set_threads(size_t threads)
+{
+    threads = std::max<size_t>(1, threads);
+    while (m_searches.size() > threads)
+        m_searches.pop_back();
+    while (m_searches.size() < threads) {
+        auto search = std::make_unique<Search>();
+        search->set_transposition_table(&m_tt);
+        search->set_thread_index(m_searches.size());
+        search->set_network(m_network);
+        search->set_tablebases(m_tablebases);
+        if (!m_searches.empty())
+            search->set_position(position(), m_searches.front()->history());
+        m_searches.push_back(std::move(search));
+    }
+}
+
+void SmpSearch::set_network(const nnue::Network *network)
+{
+    m_network = network;
+    for (auto &search : m_searches)
+        search->set_network(network);
+}
+
+void SmpSearch::set_tablebases(const tb::Tablebases *tablebases)
+{
+    m_tablebases = tablebases;
+    for (auto &search : m_searches)
+        search->set_tablebases(tablebases);
+}
+
+void SmpSearch::set_position(const db::Position &position, const std::vector<uint64_t> &history)
+{
+    for (auto &search : m_searches)
+        search->set_position(position, history);
+}
+
+SearchInfo SmpSearch::go(const SearchLimits &limits, const std::atomic<bool> &stop, const Search::InfoCallback &on_info)
+{
+    m_tt.new_search();
+    m_stop_helpers = false;
+
+    // helpers are bounded by the depth only, the main thread stops them once it returns
+    SearchLimits helper_limits;
+    helper_limits.depth = limits.depth;
+    std::vector<SearchInfo> helper_results(m_searches.size());
+    std::vector<std::thread> helpers;
+    for (size_t i = 1; i < m_searches.size(); ++i)
+        helpers.emplace_back([&, i] { helper_results[i] = m_searches[i]->go(helper_limits, m_stop_helpers); });
+
+    SearchInfo result = m_searches.front()->go(limits, stop, [&](const SearchInfo &info) {
+        if (!on_info)
+            return;
+        SearchInfo total = info;
+        total.nodes = nodes();
+        on_info(total);
+    });
+    m_stop_helpers = true;
+    for (auto &helper : helpers)
+        helper.join();
+
+    // a helper that completed a deeper iteration than the main thread has the better move
+    for (size_t i = 1; i < helper_results.size(); ++i) {
+        if (helper_results[i].depth > result.depth && !helper_results[i].pv.empty()) {
+            int64_t time_ms = result.time_ms;
+            result = std::move(helper_results[i]);
+            result.time_ms = time_ms;
+        }
+    }
+    result.nodes = nodes();
+    return result;
+}
+
+std::vector<uint64_t> SmpSearch::thread_nodes() const
+{
+    std::vector<uint64_t> nodes;
+    for (const auto &search : m_searches)
+        nodes.push_back(search->nodes());
+    return nodes;
+}
+
+uint64_t SmpSearch::nodes() const
+{
+    uint64_t nodes = 0;
+    for (const auto &search : m_searches)
+        nodes += search->nodes();
+    return nodes;
+}
+
+} // namespace engine
@@ -0,0 +1,42 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "search.hxx"
+#include "transpositiontable.hxx"
+
+namespace engine {
+// Lazy SMP: every thread runs its own Search, with its own board, on the same root and they only cooperate through
+// the shared transposition table. Thread 0 follows the limits and reports, the helpers search until it is done.
+// Their differing iteration depths and move orders fill the table with results the main thread picks up.
+class SmpSearch
+{
+public:
+    explicit SmpSearch(size_t threads = 1, size_t hash_mb = 16);
+
+    void set_threads(size_t threads);
+    [[nodiscard]] size_t threads() const { return m_searches.size(); }
+    // history as for Search::set_position
+    void set_position(const db::Position &position, const std::vector<uint64_t> &history = {});
+    void set_network(const nnue::Network *network);
+    void set_tablebases(const tb::Tablebases *tablebases);
+    const db::Position &position() const { return m_searches.front()->position(); }
+    TranspositionTable &transposition_table() { return m_tt; }
+
+    // like Search::go, the nodes reported are those of all threads together
+    SearchInfo go(const SearchLimits &limits, const std::atomic<bool> &stop, const Search::InfoCallback &on_info = {});
+    // nodes searched by every thread during the last go()
+    [[nodiscard]] std::vector<uint64_t> thread_nodes() const;
+    [[nodiscard]] uint64_t nodes() const;
+
+private:
+    TranspositionTable m_tt;
+    std::vector<std::unique_ptr<Search>> m_searches;
+    const nnue::Network *m_network;
+    const tb::Tablebases *m_tablebases;
+    std::atomic<bool> m_stop_helpers;
+};
+} // namespace engine
@@ -0,0 +1,874 @@
+#include "syzygy.hxx"
+
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace engine::tb {
+
+namespace {
+constexpr uint8_t WDL_MAGIC[4] = {0x71, 0xe8, 0x23, 0x5d};
+constexpr uint8_t DTZ_MAGIC[4] = {0xd7, 0x66, 0x0c, 0xa5};
+
+// flags of the first byte of a file
+constexpr uint8_t FILE_SPLIT = 1;
+constexpr uint8_t FILE_HAS_PAWNS = 2;
+
+// flags of a table (one side to move and leading pawn file)
+constexpr uint8_t TABLE_STM = 1;
+constexpr uint8_t TABLE_MAPPED = 2;
+constexpr uint8_t TABLE_WIN_PLIES = 4;
+constexpr uint8_t TABLE_LOSS_PLIES = 8;
+constexpr uint8_t TABLE_WIDE = 16;
+constexpr uint8_t TABLE_SINGLE_VALUE = 128;
+
+// pieces are stored as 1 to 6 for white pawn to king and 9 to 14 for black
+constexpr int BLACK_BIT = 8;
+
+int piece_code(db::Piece piece)
+{
+    return (db::type_of(piece) + 1) | (db::color_of(piece) == db::BLACK ? BLACK_BIT : 0);
+}
+
+uint64_t read_le(const uint8_t *data, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = bytes; i-- > 0;)
+        value = value << 8 | data[i];
+    return value;
+}
+
+uint64_t read_be(const uint8_t *data, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i)
+        value = value << 8 | data[i];
+    return value;
+}
+
+int off_diagonal(int square)
+{
+    return (square >> 3) - (square & 7);
+}
+
+int flip_file(int square)
+{
+    return square ^ 7;
+}
+
+int flip_rank(int square)
+{
+    return square ^ 56;
+}
+
+// The tables of the index encoding. Without pawns the leading piece is in the a1-d1-d4 triangle; the first three
+// distinct pieces are encoded together in 31332 ways, or both kings in 462 when there are fewer. With pawns the
+// leading pawns are the ones furthest toward the edge and then lowest, their file selects one of four tables.
+struct Indexing
+{
+    int binomial[6][64]{};
+    int map_pawns[64]{};
+    int lead_pawn_index[6][64]{};
+    int lead_pawns_size[6][4]{};
+    int map_b1h1h7[64]{};
+    int map_a1d1d4[64]{};
+    int map_kk[10][64]{};
+
+    Indexing()
+    {
+        int code = 0;
+        for (int square = 0; square < 64; ++square) {
+            if (off_diagonal(square) < 0)
+                map_b1h1h7[square] = code++;
+        }
+
+        // the squares of the triangle below the diagonal first, then those on it
+        std::vector<int> diagonal;
+        code = 0;
+        for (int square = db::A1; square <= db::D4; ++square) {
+            if (off_diagonal(square) < 0 && (square & 7) <= db::FILE_D)
+                map_a1d1d4[square] = code++;
+            else if (!off_diagonal(square) && (square & 7) <= db::FILE_D)
+                diagonal.push_back(square);
+        }
+        for (int square : diagonal)
+            map_a1d1d4[square] = code++;
+
+        // both kings with the first in the triangle, not next to each other and the second not above the diagonal
+        // when the first is on it. Both kings on the diagonal come last.
+        std::vector<std::pair<int, int>> both_on_diagonal;
+        code = 0;
+        for (int index = 0; index < 10; ++index) {
+            for (int first = db::A1; first <= db::D4; ++first) {
+                if (map_a1d1d4[first] != index || (!index && first != db::B1))
+                    continue;
+                for (int second = 0; second < 64; ++second) {
+                    if (std::abs((first & 7) - (second & 7)) <= 1 && std::abs((first >> 3) - (second >> 3)) <= 1)
+                        continue;
+                    if (!off_diagonal(first) && off_diagonal(second) > 0)
+                        continue;
+                    if (!off_diagonal(first) && !off_diagonal(second))
+                        both_on_diagonal.emplace_back(index, second);
+                    else
+                        map_kk[index][second] = code++;
+                }
+            }
+        }
+        for (const auto &[index, second] : both_on_diagonal)
+            map_kk[index][second] = code++;
+
+        binomial[0][0] = 1;
+        for (int n = 1; n < 64; ++n) {
+            for (int k = 0; k < 6 && k <= n; ++k)
+                binomial[k][n] = (k > 0 ? binomial[k - 1][n - 1] : 0) + (k < n ? binomial[k][n - 1] : 0);
+        }
+
+        // map_pawns counts the squares left to the other pawns when the leading one stands on a square
+        int available = 47;
+        for (int lead_pawns = 1; lead_pawns <= 5; ++lead_pawns) {
+            for (int file = db::FILE_A; file <= db::FILE_D; ++file) {
+                int index = 0;
+                for (int rank = db::RANK_2; rank <= db::RANK_7; ++rank) {
+                    const int square = rank * 8 + file;
+                    if (lead_pawns == 1) {
+                        map_pawns[square] = available--;
+                        map_pawns[flip_file(square)] = available--;
+                    }
+                    lead_pawn_index[lead_pawns][square] = index;
+                    index += binomial[lead_pawns - 1][map_pawns[square]];
+                }
+                lead_pawns_size[lead_pawns][file] = index;
+            }
+        }
+    }
+};
+
+const Indexing &indexing()
+{
+    static const Indexing instance;
+    return instance;
+}
+
+// The compressed values of one side to move and leading pawn file. A block of block_size bytes holds the Huffman
+// codes of block_lengths[n] + 1 values, the sparse index points to the block and offset of every span-th value.
+struct PairsData
+{
+    uint8_t flags{0};
+    int min_symbol_length{0}; // or the value of a table with a single value
+    const uint8_t *lowest_symbol{nullptr};
+    const uint8_t *tree{nullptr};
+    const uint8_t *block_lengths{nullptr};
+    uint64_t block_lengths_size{0};
+    const uint8_t *sparse_index{nullptr};
+    uint64_t sparse_index_size{0};
+    const uint8_t *data{nullptr};
+    uint64_t blocks{0};
+    uint64_t block_size{0};
+    uint64_t span{0};
+    // lowest code of each length left aligned in 64 bits, from the minimum length up
+    std::vector<uint64_t> base;
+    // number of values less one that a symbol expands to
+    std::vector<uint8_t> symbol_length;
+    int pieces[MAX_PIECES]{};
+    uint64_t group_index[MAX_PIECES + 1]{};
+    int group_length[MAX_PIECES + 1]{};
+    // where the value maps of win, loss, cursed win and blessed loss start (DTZ only)
+    uint16_t map_index[4]{};
+
+    [[nodiscard]] int left(int symbol) const
+    {
+        const uint8_t *node = tree + 3 * symbol;
+        return (node[1] & 0xf) << 8 | node[0];
+    }
+
+    [[nodiscard]] int right(int symbol) const
+    {
+        const uint8_t *node = tree + 3 * symbol;
+        return node[2] << 4 | node[1] >> 4;
+    }
+
+    // number of values less one behind symbol, filled in for every symbol of the tree below it
+    uint8_t set_symbol_length(int symbol, std::vector<bool> &visited)
+    {
+        visited[symbol] = true;
+        const int second = right(symbol);
+        if (second == 0xfff)
+            return 0;
+        const int first = left(symbol);
+        if (!visited[first])
+            symbol_length[first] = set_symbol_length(first, visited);
+        if (!visited[second])
+            symbol_length[second] = set_symbol_length(second, visited);
+        return uint8_t(symbol_length[first] + symbol_length[second] + 1);
+    }
+
+    [[nodiscard]] int value(uint64_t index) const
+    {
+        if (flags & TABLE_SINGLE_VALUE)
+            return min_symbol_length;
+
+        // the sparse entry closest to the index, then block by block to the one that holds it
+        const uint64_t entry = index / span;
+        uint64_t block = read_le(sparse_index + 6 * entry, 4);
+        int64_t offset = int64_t(read_le(sparse_index + 6 * entry + 4, 2)) + int64_t(index % span) - int64_t(span / 2);
+        while (offset < 0)
+            offset += int64_t(read_le(block_lengths + 2 * --block, 2)) + 1;
+        while (offset > int64_t(read_le(block_lengths + 2 * block, 2)))
+            offset -= int64_t(read_le(block_lengths + 2 * block++, 2)) + 1;
+
+        // codes of the same length are consecutive numbers, longer codes are smaller
+        const uint8_t *code = data + block * block_size;
+        uint64_t buffer = read_be(code, 8);
+        code += 8;
+        int buffered = 64;
+        int symbol;
+        for (;;) {
+            size_t length = 0;
+            while (buffer < base[length])
+                ++length;
+            symbol = int((buffer - base[length]) >> (64 - length - min_symbol_length));
+            symbol += int(read_le(lowest_symbol + 2 * length, 2));
+            if (offset < symbol_length[symbol] + 1)
+                break;
+            offset -= symbol_length[symbol] + 1;
+            length += min_symbol_length;
+            buffer <<= length;
+            buffered -= int(length);
+            if (buffered <= 32) {
+                buffered += 32;
+                buffer |= read_be(code, 4) << (64 - buffered);
+                code += 4;
+            }
+        }
+
+        // the symbol stands for a pair of symbols, down the tree to the single value at the offset
+        while (symbol_length[symbol]) {
+            const int first = left(symbol);
+            if (offset < symbol_length[first] + 1) {
+                symbol = first;
+            } else {
+                offset -= symbol_length[first] + 1;
+                symbol = right(symbol);
+            }
+        }
+        return left(symbol);
+    }
+};
+
+uint64_t swap_key_colors(uint64_t key)
+{
+    return key >> 24 | (key & 0xffffff) << 24;
+}
+
+int sign(int value)
+{
+    return (value > 0) - (value < 0);
+}
+
+// dtz of a position whose best move zeroes the counter
+int dtz_before_zeroing(int wdl)
+{
+    switch (wdl) {
+    case 2:
+        return 1;
+    case 1:
+        return 101;
+    case -1:
+        return -101;
+    case -2:
+        return -1;
+    default:
+        return 0;
+    }
+}
+} // namespace
+
+enum class Syzygy::State
+{
+    OK,
+    FAIL,
+    // the best move zeroes the counter, the DTZ files hold no value for the position
+    ZEROING_BEST_MOVE,
+    // the DTZ file only has the other side to move
+    CHANGE_STM,
+};
+
+struct Syzygy::Table
+{
+    Table(std::string path, bool dtz)
+        : path(std::move(path))
+        , dtz(dtz)
+    {}
+
+    ~Table()
+    {
+#ifdef __unix__
+        if (mapping)
+            munmap(const_cast<uint8_t *>(mapping), mapping_size);
+#endif
+    }
+
+    // maps the file and sets up its tables, ready stays false if that fails
+    void open(const Material &material);
+    // offset of a pointer into the file, alignments are relative to its start
+    [[nodiscard]] uint64_t offset(const uint8_t *data) const { return uint64_t(data - mapping); }
+    PairsData &pairs(int stm, int file) { return tables[dtz ? 0 : stm][file]; }
+
+    std::string path;
+    bool dtz;
+    std::once_flag opened;
+    bool ready{false};
+    const uint8_t *mapping{nullptr};
+    size_t mapping_size{0};
+    std::vector<uint8_t> owned;
+    // start of the value maps of a DTZ file
+    const uint8_t *map{nullptr};
+    PairsData tables[2][4];
+};
+
+struct Syzygy::Material
+{
+    Material(const std::string &stem, const std::string &directory, bool has_dtz);
+
+    // material key with the side named first as white, and with it as black
+    uint64_t key{0};
+    uint64_t key2{0};
+    int piece_count{0};
+    bool has_pawns{false};
+    bool has_unique_pieces{false};
+    // pawns of the leading color (the one with fewer pawns if both have some) and of the other
+    int pawn_count[2]{0, 0};
+    Table wdl;
+    std::unique_ptr<Table> dtz;
+};
+
+Syzygy::Material::Material(const std::string &stem, const std::string &directory, bool has_dtz)
+    : wdl(directory + "/" + stem + ".rtbw", false)
+{
+    if (has_dtz)
+        dtz = std::make_unique<Table>(directory + "/" + stem + ".rtbz", true);
+    int counts[2][db::PIECE_TYPES] = {};
+    db::Color color = db::WHITE;
+    for (char c : stem) {
+        if (c == 'v') {
+            color = db::BLACK;
+            continue;
+        }
+        const size_t type = db::fen_char_pieces.find(c);
+        ++counts[color][type];
+        key += uint64_t(1) << 4 * (6 * color + type);
+        ++piece_count;
+    }
+    key2 = swap_key_colors(key);
+    has_pawns = counts[db::WHITE][db::PAWN] + counts[db::BLACK][db::PAWN] > 0;
+    for (int side = db::WHITE; side <= db::BLACK; ++side) {
+        for (int type = db::PAWN; type < db::KING; ++type)
+            has_unique_pieces |= counts[side][type] == 1;
+    }
+    const int white_pawns = counts[db::WHITE][db::PAWN], black_pawns = counts[db::BLACK][db::PAWN];
+    const bool white_leads = !black_pawns || (white_pawns && black_pawns >= white_pawns);
+    pawn_count[0] = white_leads ? white_pawns : black_pawns;
+    pawn_count[1] = white_leads ? black_pawns : white_pawns;
+}
+
+namespace {
+// The groups of pieces encoded together and the factor of each group in the index. The order of the groups in the
+// index is a parameter of the table: the leading group is at order[0], the other side's pawns at order[1].
+void set_groups(PairsData &d, const int order[2], int file, int piece_count, bool has_pawns, bool has_unique_pieces,
+                bool pawns_on_both_sides)
+{
+    const Indexing &ix = indexing();
+    int n = 0, first_length = has_pawns ? 0 : has_unique_pieces ? 3 : 2;
+    d.group_length[n] = 1;
+    for (int i = 1; i < piece_count; ++i) {
+        if (--first_length > 0 || d.pieces[i] == d.pieces[i - 1])
+            d.group_length[n]++;
+        else
+            d.group_length[++n] = 1;
+    }
+    d.group_length[++n] = 0;
+
+    int next = pawns_on_both_sides ? 2 : 1;
+    int free_squares = 64 - d.group_length[0] - (pawns_on_both_sides ? d.group_length[1] : 0);
+    uint64_t index = 1;
+    for (int k = 0; next < n || k == order[0] || k == order[1]; ++k) {
+        if (k == order[0]) {
+            d.group_index[0] = index;
+            index *= has_pawns           ? ix.lead_pawns_size[d.group_length[0]][file]
+                     : has_unique_pieces ? 31332
+                                         : 462;
+        } else if (k == order[1]) {
+            d.group_index[1] = index;
+            index *= ix.binomial[d.group_length[1]][48 - d.group_length[0]];
+        } else {
+            d.group_index[next] = index;
+            index *= ix.binomial[d.group_length[next]][free_squares];
+            free_squares -= d.group_length[next++];
+        }
+    }
+    d.group_index[n] = index;
+}
+
+// the sizes and the Huffman code of a table, returns the data after them
+const uint8_t *set_sizes(PairsData &d, const uint8_t *data)
+{
+    d.flags = *data++;
+    if (d.flags & TABLE_SINGLE_VALUE) {
+        d.min_symbol_length = *data++;
+        return data;
+    }
+
+    const uint64_t size = d.group_index[std::find(d.group_length, d.group_length + MAX_PIECES, 0) - d.group_length];
+    d.block_size = uint64_t(1) << *data++;
+    d.span = uint64_t(1) << *data++;
+    d.sparse_index_size = (size + d.span - 1) / d.span;
+    const uint8_t padding = *data++;
+    d.blocks = read_le(data, 4);
+    data += 4;
+    // padded so that the sparse index never points past the end
+    d.block_lengths_size = d.blocks + padding;
+    const int max_symbol_length = *data++;
+    d.min_symbol_length = *data++;
+    d.lowest_symbol = data;
+    d.base.assign(size_t(max_symbol_length - d.min_symbol_length + 1), 0);
+    for (int i = int(d.base.size()) - 2; i >= 0; --i) {
+        const uint64_t lowest = read_le(d.lowest_symbol + 2 * i, 2);
+        d.base[i] = (d.base[i + 1] + lowest - read_le(d.lowest_symbol + 2 * (i + 1), 2)) / 2;
+    }
+    for (size_t i = 0; i < d.base.size(); ++i)
+        d.base[i] <<= 64 - i - d.min_symbol_length;
+    data += 2 * d.base.size();
+
+    d.symbol_length.assign(size_t(read_le(data, 2)), 0);
+    data += 2;
+    d.tree = data;
+    std::vector<bool> visited(d.symbol_length.size());
+    for (size_t symbol = 0; symbol < d.symbol_length.size(); ++symbol) {
+        if (!visited[symbol])
+            d.symbol_length[symbol] = d.set_symbol_length(int(symbol), visited);
+    }
+    return data + 3 * d.symbol_length.size() + (d.symbol_length.size() & 1);
+}
+} // namespace
+
+void Syzygy::Table::open(const Material &material)
+{
+    const uint8_t *data = nullptr;
+    size_t file_size = 0;
+#ifdef __unix__
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size < 16) {
+        close(fd);
+        return;
+    }
+    file_size = size_t(status.st_size);
+    void *file_map = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file_map == MAP_FAILED)
+        return;
+    // probes land anywhere in the file
+    madvise(file_map, file_size, MADV_RANDOM);
+    mapping = static_cast<const uint8_t *>(file_map);
+    mapping_size = file_size;
+    data = mapping;
+#else
+    std::ifstream in(path, std::ios::binary);
+    owned.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    file_size = owned.size();
+    if (file_size < 16)
+        return;
+    mapping = data = owned.data();
+#endif
+    if (!std::equal(data, data + 4, dtz ? DTZ_MAGIC : WDL_MAGIC))
+        return;
+    data += 4;
+    const bool split = material.key != material.key2;
+    if (bool(*data & FILE_HAS_PAWNS) != material.has_pawns || bool(*data & FILE_SPLIT) != split)
+        return;
+    ++data;
+
+    const int sides = !dtz && split ? 2 : 1;
+    const int files = material.has_pawns ? 4 : 1;
+    const bool both_pawns = material.has_pawns && material.pawn_count[1];
+    for (int file = 0; file < files; ++file) {
+        const int order[2][2] = {{*data & 0xf, both_pawns ? *(data + 1) & 0xf : 0xf},
+                                 {*data >> 4, both_pawns ? *(data + 1) >> 4 : 0xf}};
+        data += 1 + both_pawns;
+        for (int k = 0; k < material.piece_count; ++k, ++data) {
+            for (int side = 0; side < sides; ++side)
+                tables[side][file].pieces[k] = side ? *data >> 4 : *data & 0xf;
+        }
+        for (int side = 0; side < sides; ++side)
+            set_groups(tables[side][file], order[side], file, material.piece_count, material.has_pawns,
+                       material.has_unique_pieces, both_pawns);
+    }
+    data += offset(data) & 1;
+
+    for (int file = 0; file < files; ++file) {
+        for (int side = 0; side < sides; ++side)
+            data = set_sizes(tables[side][file], data);
+    }
+
+    if (dtz) {
+        map = data;
+        for (int file = 0; file < files; ++file) {
+            PairsData &d = tables[0][file];
+            if (!(d.flags & TABLE_MAPPED))
+                continue;
+            if (d.flags & TABLE_WIDE) {
+                data += offset(data) & 1;
+                for (int i = 0; i < 4; ++i) {
+                    d.map_index[i] = uint16_t((data - map) / 2 + 1);
+                    data += 2 * read_le(data, 2) + 2;
+                }
+            } else {
+                for (int i = 0; i < 4; ++i) {
+                    d.map_index[i] = uint16_t(data - map + 1);
+                    data += *data + 1;
+                }
+            }
+        }
+        data += offset(data) & 1;
+    }
+
+    for (int file = 0; file < files; ++file) {
+        for (int side = 0; side < sides; ++side) {
+            tables[side][file].sparse_index = data;
+            data += 6 * tables[side][file].sparse_index_size;
+        }
+    }
+    for (int file = 0; file < files; ++file) {
+        for (int side = 0; side < sides; ++side) {
+            tables[side][file].block_lengths = data;
+            data += 2 * tables[side][file].block_lengths_size;
+        }
+    }
+    for (int file = 0; file < files; ++file) {
+        for (int side = 0; side < sides; ++side) {
+            data += (64 - offset(data) % 64) % 64;
+            tables[side][file].data = data;
+            data += tables[side][file].blocks * tables[side][file].block_size;
+        }
+    }
+    ready = offset(data) <= file_size;
+}
+
+Syzygy::Syzygy()
+    : m_max_pieces(0)
+{}
+
+Syzygy::~Syzygy() = default;
+
+size_t Syzygy::add_directory(const std::string &directory)
+{
+    namespace fs = std::filesystem;
+    size_t added = 0;
+    std::error_code error;
+    for (const auto &entry : fs::directory_iterator(directory, error)) {
+        if (!entry.is_regular_file(error) || entry.path().extension() != ".rtbw")
+            continue;
+        const std::string stem = entry.path().stem().string();
+        const size_t separator = stem.find('v');
+        if (separator == std::string::npos || stem.size() - 1 > size_t(MAX_PIECES) || stem[0] != 'K' ||
+            stem[separator + 1] != 'K' || stem.find_first_not_of("KQRBNPv") != std::string::npos ||
+            std::count(stem.begin(), stem.end(), 'K') != 2)
+            continue;
+        auto material = std::make_unique<Material>(
+            stem, directory, fs::is_regular_file(entry.path().parent_path() / (stem + ".rtbz"), error));
+        if (m_keys.contains(material->key))
+            continue;
+        m_max_pieces = std::max(m_max_pieces, material->piece_count);
+        m_keys.emplace(material->key, material.get());
+        m_keys.emplace(material->key2, material.get());
+        m_materials.push_back(std::move(material));
+        ++added;
+    }
+    return added;
+}
+
+int Syzygy::probe_wdl_table(const db::Position &position, State &state) const
+{
+    return probe_table(position, false, 0, state);
+}
+
+int Syzygy::probe_dtz_table(const db::Position &position, int wdl, State &state) const
+{
+    return probe_table(position, true, wdl, state);
+}
+
+int Syzygy::probe_table(const db::Position &position, bool dtz, int wdl, State &state) const
+{
+    const db::Bitboard occupied = position.by_color[db::WHITE] | position.by_color[db::BLACK];
+    if (std::popcount(occupied) == 2)
+        return 0;
+    const auto it = m_keys.find(material_key(position));
+    if (it == m_keys.end() || (dtz && !it->second->dtz)) {
+        state = State::FAIL;
+        return 0;
+    }
+    Material &material = *it->second;
+    Table &table = dtz ? *material.dtz : material.wdl;
+    std::call_once(table.opened, [&table, &material] { table.open(material); });
+    if (!table.ready) {
+        state = State::FAIL;
+        return 0;
+    }
+
+    // the tables are stored with the side named first as white, and only with white to move when both sides have
+    // the same material
+    const bool flip = (material.key == material.key2 && position.stm == db::BLACK) ||
+                      material_key(position) != material.key;
+    const int flip_color = flip ? BLACK_BIT : 0;
+    const int flip_squares = flip ? 56 : 0;
+    const int stm = int(flip) ^ int(position.stm == db::BLACK);
+
+    const Indexing &ix = indexing();
+    auto pawns_order = [&ix](int lhs, int rhs) { return ix.map_pawns[lhs] < ix.map_pawns[rhs]; };
+    int squares[MAX_PIECES];
+    int pieces[MAX_PIECES];
+    int size = 0, lead_pawns_count = 0, file = 0;
+    db::Bitboard lead_pawns = 0;
+    if (material.has_pawns) {
+        // the pawns of the leading color, the one of them furthest toward the edge first
+        const int lead_code = table.pairs(0, 0).pieces[0] ^ flip_color;
+        const db::Color lead_color = lead_code & BLACK_BIT ? db::BLACK : db::WHITE;
+        lead_pawns = position.by_type[db::PAWN] & position.by_color[lead_color];
+        for (db::Bitboard b = lead_pawns; b; b &= b - 1)
+            squares[size++] = std::countr_zero(b) ^ flip_squares;
+        lead_pawns_count = size;
+        std::swap(squares[0], *std::max_element(squares, squares + lead_pawns_count, pawns_order));
+        file = squares[0] & 7;
+        if (file > db::FILE_D)
+            file = flip_file(squares[0]) & 7;
+    }
+
+    if (dtz && (table.pairs(stm, file).flags & TABLE_STM) != stm &&
+        !(material.key == material.key2 && !material.has_pawns)) {
+        state = State::CHANGE_STM;
+        return 0;
+    }
+
+    for (db::Bitboard b = occupied ^ lead_pawns; b; b &= b - 1) {
+        const int square = std::countr_zero(b);
+        squares[size] = square ^ flip_squares;
+        pieces[size++] = piece_code(position.board[square]) ^ flip_color;
+    }
+
+    // the pieces in the order of the table
+    const PairsData &d = table.pairs(stm, file);
+    for (int i = lead_pawns_count; i < size - 1; ++i) {
+        for (int j = i + 1; j < size; ++j) {
+            if (d.pieces[i] == pieces[j]) {
+                std::swap(pieces[i], pieces[j]);
+                std::swap(squares[i], squares[j]);
+                break;
+            }
+        }
+    }
+
+    if ((squares[0] & 7) > db::FILE_D) {
+        for (int i = 0; i < size; ++i)
+            squares[i] = flip_file(squares[i]);
+    }
+
+    uint64_t index;
+    if (material.has_pawns) {
+        index = uint64_t(ix.lead_pawn_index[lead_pawns_count][squares[0]]);
+        std::stable_sort(squares + 1, squares + lead_pawns_count, pawns_order);
+        for (int i = 1; i < lead_pawns_count; ++i)
+            index += uint64_t(ix.binomial[i][ix.map_pawns[squares[i]]]);
+    } else {
+        if (squares[0] >> 3 > db::RANK_4) {
+            for (int i = 0; i < size; ++i)
+                squares[i] = flip_rank(squares[i]);
+        }
+        // the first piece of the leading group off the a1-h8 diagonal goes below it
+        for (int i = 0; i < d.group_length[0]; ++i) {
+            if (!off_diagonal(squares[i]))
+                continue;
+            if (off_diagonal(squares[i]) > 0) {
+                for (int j = i; j < size; ++j)
+                    squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+            }
+            break;
+        }
+
+        if (material.has_unique_pieces) {
+            const int adjust1 = squares[1] > squares[0];
+            const int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+            if (off_diagonal(squares[0]))
+                index = (uint64_t(ix.map_a1d1d4[squares[0]]) * 63 + uint64_t(squares[1] - adjust1)) * 62 +
+                        uint64_t(squares[2] - adjust2);
+            else if (off_diagonal(squares[1]))
+                index = (6 * 63 + uint64_t(squares[0] >> 3) * 28 + uint64_t(ix.map_b1h1h7[squares[1]])) * 62 +
+                        uint64_t(squares[2] - adjust2);
+            else if (off_diagonal(squares[2]))
+                index = 6 * 63 * 62 + 4 * 28 * 62 + uint64_t(squares[0] >> 3) * 7 * 28 +
+                        uint64_t((squares[1] >> 3) - adjust1) * 28 + uint64_t(ix.map_b1h1h7[squares[2]]);
+            else
+                index = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + uint64_t(squares[0] >> 3) * 7 * 6 +
+                        uint64_t((squares[1] >> 3) - adjust1) * 6 + uint64_t((squares[2] >> 3) - adjust2);
+        } else {
+            index = uint64_t(ix.map_kk[ix.map_a1d1d4[squares[0]]][squares[1]]);
+        }
+    }
+
+    // the other groups in ascending square order, counting only the squares the groups before leave free
+    index *= d.group_index[0];
+    int *group = squares + d.group_length[0];
+    bool remaining_pawns = material.has_pawns && material.pawn_count[1];
+    for (int next = 1; d.group_length[next]; ++next) {
+        std::stable_sort(group, group + d.group_length[next]);
+        uint64_t n = 0;
+        for (int i = 0; i < d.group_length[next]; ++i) {
+            const int adjust = int(std::count_if(squares, group, [&](int square) { return group[i] > square; }));
+            n += uint64_t(ix.binomial[i + 1][group[i] - adjust - 8 * remaining_pawns]);
+        }
+        remaining_pawns = false;
+        index += n * d.group_index[next];
+        group += d.group_length[next];
+    }
+
+    int value = d.value(index);
+    if (!dtz)
+        return value - 2;
+
+    // DTZ values are mapped per result and counted in moves unless the flags say plies
+    constexpr int map_slot[] = {1, 3, 0, 2, 0};
+    if (d.flags & TABLE_MAPPED) {
+        const size_t slot = size_t(d.map_index[map_slot[wdl + 2]]) + size_t(value);
+        value = d.flags & TABLE_WIDE ? int(read_le(table.map + 2 * slot, 2)) : table.map[slot];
+    }
+    if ((wdl == 2 && !(d.flags & TABLE_WIN_PLIES)) || (wdl == -2 && !(d.flags & TABLE_LOSS_PLIES)) || wdl == 1 ||
+        wdl == -1)
+        value *= 2;
+    return value + 1;
+}
+
+int Syzygy::search(db::Board &board, bool zeroing_moves, State &state) const
+{
+    // the tables may hold any value where the best move is a capture (or for DTZ a pawn move), those are searched
+    int best = -2;
+    const std::vector<db::Move> moves = board.generate_moves();
+    size_t searched = 0;
+    for (const auto &move : moves) {
+        if (move.captured == db::PIECE_NONE && (!zeroing_moves || db::type_of(move.piece_moved) != db::PAWN))
+            continue;
+        ++searched;
+        board.do_move(move);
+        const int value = -search(board, false, state);
+        board.undo_move(move);
+        if (state == State::FAIL)
+            return 0;
+        if (value > best) {
+            best = value;
+            if (value >= 2) {
+                state = State::ZEROING_BEST_MOVE;
+                return value;
+            }
+        }
+    }
+
+    // with every move searched the stored value is not needed, and may be wrong (en passant rights)
+    const bool all_searched = searched && searched == moves.size();
+    int value = best;
+    if (!all_searched) {
+        value = probe_wdl_table(board.get_position(), state);
+        if (state == State::FAIL)
+            return 0;
+    }
+    if (best >= value) {
+        state = best > 0 || all_searched ? State::ZEROING_BEST_MOVE : State::OK;
+        return best;
+    }
+    state = State::OK;
+    return value;
+}
+
+int Syzygy::probe_dtz(db::Board &board, State &state) const
+{
+    state = State::OK;
+    const int wdl = search(board, true, state);
+    if (state == State::FAIL || wdl == 0)
+        return 0;
+    if (state == State::ZEROING_BEST_MOVE)
+        return dtz_before_zeroing(wdl);
+
+    int dtz = probe_dtz_table(board.get_position(), wdl, state);
+    if (state == State::FAIL)
+        return 0;
+    if (state != State::CHANGE_STM)
+        return (dtz + (wdl == 1 || wdl == -1 ? 100 : 0)) * sign(wdl);
+
+    // the file has the other side to move: the best of the moves by their distances one ply later
+    int best = 0xffff;
+    for (const auto &move : board.generate_moves()) {
+        const bool zeroing = move.captured != db::PIECE_NONE || db::type_of(move.piece_moved) == db::PAWN;
+        board.do_move(move);
+        // for zeroing moves the distance before the move, with the sign of the result after it
+        dtz = zeroing ? -dtz_before_zeroing(search(board, false, state)) : -probe_dtz(board, state);
+        if (dtz == 1 && board.is_check() && board.generate_moves().empty())
+            best = 1;
+        if (!zeroing)
+            dtz += sign(dtz);
+        if (dtz < best && sign(dtz) == sign(wdl))
+            best = dtz;
+        board.undo_move(move);
+        if (state == State::FAIL)
+            return 0;
+    }
+    return best == 0xffff ? -1 : best;
+}
+
+std::optional<ProbeResult> Syzygy::probe(const db::Position &position) const
+{
+    if (position.castling_rights != db::CASTLING_NONE ||
+        std::popcount(position.by_color[db::WHITE] | position.by_color[db::BLACK]) > m_max_pieces)
+        return std::nullopt;
+    db::Board board;
+    board.set_position(position);
+    if (board.generate_moves().empty())
+        return board.is_check() ? ProbeResult{Wdl::LOSS, 0} : ProbeResult{};
+
+    State state = State::OK;
+    const int dtz = probe_dtz(board, state);
+    if (state == State::FAIL) {
+        // no DTZ file, the WDL result only tells whether the 50 move rule allows it
+        return probe_wdl(position);
+    }
+    if (dtz == 0)
+        return ProbeResult{};
+    return ProbeResult{dtz > 0 ? Wdl::WIN : Wdl::LOSS, std::abs(dtz)};
+}
+
+std::optional<ProbeResult> Syzygy::probe_wdl(const db::Position &position) const
+{
+    if (position.castling_rights != db::CASTLING_NONE ||
+        std::popcount(position.by_color[db::WHITE] | position.by_color[db::BLACK]) > m_max_pieces)
+        return std::nullopt;
+    db::Board board;
+    board.set_position(position);
+    State state = State::OK;
+    const int wdl = search(board, false, state);
+    if (state == State::FAIL)
+        return std::nullopt;
+    if (wdl == 0)
+        return ProbeResult{};
+    return ProbeResult{wdl > 0 ? Wdl::WIN : Wdl::LOSS, std::abs(wdl) == 2 ? 0 : 101};
+}
+
+} // namespace engine::tb
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tablebase.hxx"
+
+// Syzygy tables: a WDL file (KRPvKR.rtbw) with the result of every position of a material combination and a DTZ
+// file (KRPvKR.rtbz) with the distance to the next zeroing move, for one side to move only. Values are stored
+// compressed with recursive pairing and canonical Huffman codes, in blocks that a sparse index finds.
+//
+// The generator leaves positions whose best move is a capture (or a pawn move, for DTZ) undefined when that helps
+// the compression, so a probe searches the captures with their own tables and takes the better of them and the
+// stored value. DTZ files of the side not stored are answered by a one ply search. Some DTZ files count moves
+// instead of plies, their distances may be one ply too long.
+namespace engine::tb {
+class Syzygy
+{
+public:
+    Syzygy();
+    ~Syzygy();
+    Syzygy(const Syzygy &) = delete;
+    Syzygy &operator=(const Syzygy &) = delete;
+
+    // registers the WDL files found in directory, with the DTZ files next to them, and returns their number. Not
+    // thread safe, call it before probing.
+    size_t add_directory(const std::string &directory);
+    [[nodiscard]] size_t size() const { return m_materials.size(); }
+    [[nodiscard]] int max_pieces() const { return m_max_pieces; }
+
+    // nullopt unless the tables of the position and of every capture the probe looks at are there. Without the DTZ
+    // file dtz is only 0 for results the 50 move rule allows and 101 for those it turns into draws. Thread safe.
+    [[nodiscard]] std::optional<ProbeResult> probe(const db::Position &position) const;
+    // the WDL files only, dtz is 0 for results the 50 move rule allows and 101 for those it turns into draws. That
+    // is exact right after a zeroing move and far cheaper than probe, which walks the moves for the DTZ file.
+    [[nodiscard]] std::optional<ProbeResult> probe_wdl(const db::Position &position) const;
+
+private:
+    struct Table;
+    struct Material;
+    enum class State;
+
+    // results -2 to 2: loss, loss the 50 move rule saves, draw, win the 50 move rule spoils, win
+    int probe_wdl_table(const db::Position &position, State &state) const;
+    int probe_dtz_table(const db::Position &position, int wdl, State &state) const;
+    int probe_table(const db::Position &position, bool dtz, int wdl, State &state) const;
+    int search(db::Board &board, bool zeroing_moves, State &state) const;
+    int probe_dtz(db::Board &board, State &state) const;
+
+    std::vector<std::unique_ptr<Material>> m_materials;
+    // material key of both color assignments
+    std::unordered_map<uint64_t, Material *> m_keys;
+    int m_max_pieces;
+};
+} // namespace engine::tb
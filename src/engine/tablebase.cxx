@@ -0,0 +1,559 @@
+#include "tablebase.hxx"
+#include "syzygy.hxx"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace engine::tb {
+
+namespace {
+// File layout (little endian): a 64 byte header with the magic, the number of pieces as uint32, the pieces in table
+// order as one byte each, the number of indices per side to move as uint64 at offset 24 and the number of blocks per
+// side as uint64 at offset 32. The offsets of the blocks with white to move follow, then those with black to move,
+// each side with one more offset for the end of its last block, then the blocks. Every block holds BLOCK_SIZE values
+// (the last one of a side less) in the smallest of three encodings: raw, runs of a value and a varint length, or the
+// number of distinct values, the values, and the index of every value among them packed into as few bits as they need.
+constexpr char MAGIC[8] = "CHTB2";
+constexpr size_t HEADER_SIZE = 64;
+constexpr size_t PIECES_OFFSET = 12;
+constexpr size_t SIZE_OFFSET = 24;
+constexpr size_t BLOCKS_OFFSET = 32;
+constexpr uint64_t BLOCK_SIZE = 4096;
+constexpr uint8_t BLOCK_RAW = 0;
+constexpr uint8_t BLOCK_RUNS = 1;
+constexpr uint8_t BLOCK_PACKED = 2;
+
+uint64_t read_u64(const uint8_t *data)
+{
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+// one block of values, ILLEGAL entries are nobody's business and take the value before them
+std::vector<uint8_t> encode_block(const uint8_t *values, size_t count)
+{
+    const uint8_t *first_legal = std::find_if(values, values + count, [](uint8_t value) { return value != ILLEGAL; });
+    std::vector<uint8_t> filled(values, values + count);
+    uint8_t current = first_legal == values + count ? DRAW : *first_legal;
+    for (uint8_t &value : filled) {
+        if (value == ILLEGAL)
+            value = current;
+        current = value;
+    }
+
+    std::vector<uint8_t> raw = {BLOCK_RAW};
+    raw.insert(raw.end(), filled.begin(), filled.end());
+
+    std::vector<uint8_t> runs = {BLOCK_RUNS};
+    for (size_t begin = 0; begin < count;) {
+        size_t end = begin + 1;
+        while (end < count && filled[end] == filled[begin])
+            ++end;
+        runs.push_back(filled[begin]);
+        for (uint64_t rest = end - begin - 1;; rest >>= 7) {
+            runs.push_back(uint8_t(rest & 0x7f) | (rest >= 0x80 ? 0x80 : 0));
+            if (rest < 0x80)
+                break;
+        }
+        begin = end;
+    }
+
+    std::array<int, 256> slot;
+    slot.fill(-1);
+    std::vector<uint8_t> dictionary;
+    for (uint8_t value : filled) {
+        if (slot[value] < 0) {
+            slot[value] = int(dictionary.size());
+            dictionary.push_back(value);
+        }
+    }
+    const int bits = std::bit_width(dictionary.size() - 1);
+    std::vector<uint8_t> packed = {BLOCK_PACKED, uint8_t(dictionary.size() - 1)};
+    packed.insert(packed.end(), dictionary.begin(), dictionary.end());
+    const size_t data_begin = packed.size();
+    packed.resize(data_begin + (count * bits + 7) / 8);
+    for (size_t i = 0; i < count; ++i) {
+        for (int bit = 0; bit < bits; ++bit) {
+            if (slot[filled[i]] >> bit & 1)
+                packed[data_begin + (i * bits + bit) / 8] |= uint8_t(1 << (i * bits + bit) % 8);
+        }
+    }
+
+    return std::min({raw, runs, packed}, [](const auto &lhs, const auto &rhs) { return lhs.size() < rhs.size(); });
+}
+
+// value at offset of an encoded block
+uint8_t block_value(const uint8_t *block, uint64_t offset)
+{
+    if (block[0] == BLOCK_RAW)
+        return block[1 + offset];
+    if (block[0] == BLOCK_PACKED) {
+        const int distinct = block[1] + 1;
+        const int bits = std::bit_width(unsigned(distinct - 1));
+        const uint8_t *data = block + 2 + distinct;
+        int slot = 0;
+        for (int bit = 0; bit < bits; ++bit)
+            slot |= (data[(offset * bits + bit) / 8] >> (offset * bits + bit) % 8 & 1) << bit;
+        return block[2 + slot];
+    }
+    for (const uint8_t *run = block + 1;;) {
+        const uint8_t value = *run++;
+        uint64_t length = 0;
+        for (int shift = 0;; shift += 7) {
+            const uint8_t byte = *run++;
+            length |= uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                break;
+        }
+        if (offset <= length)
+            return value;
+        offset -= length + 1;
+    }
+}
+
+constexpr int piece_values[] = {1, 3, 3, 5, 9, 0};
+
+// the a1-d1-d4 triangle the white king is moved into without pawns
+constexpr db::Square triangle[] = {db::A1, db::B1, db::C1, db::D1, db::B2, db::C2, db::D2, db::C3, db::D3, db::D4};
+constexpr int TRIANGLE_SIZE = int(std::size(triangle));
+constexpr std::array<int, 64> triangle_index = [] {
+    std::array<int, 64> index{};
+    index.fill(-1);
+    for (int i = 0; i < TRIANGLE_SIZE; ++i)
+        index[triangle[i]] = i;
+    return index;
+}();
+
+db::Square mirror_file(db::Square square)
+{
+    return db::Square(square ^ 7);
+}
+
+db::Square mirror_rank(db::Square square)
+{
+    return db::Square(square ^ 56);
+}
+
+db::Square transpose(db::Square square)
+{
+    return db::Square((square & 7) << 3 | square >> 3);
+}
+
+db::Piece swap_color(db::Piece piece)
+{
+    return db::make_piece(db::type_of(piece), db::opposite(db::color_of(piece)));
+}
+
+// material of one side, kings first, then from queen down to pawn
+std::vector<db::PieceType> side_types(const std::vector<db::Piece> &pieces, db::Color color)
+{
+    std::vector<db::PieceType> types;
+    for (db::Piece piece : pieces) {
+        if (db::color_of(piece) == color)
+            types.push_back(db::type_of(piece));
+    }
+    std::sort(types.begin(), types.end(), [](db::PieceType lhs, db::PieceType rhs) { return lhs > rhs; });
+    return types;
+}
+
+// ordering of the two sides' material, the stronger one plays white in the table
+int compare_sides(const std::vector<db::PieceType> &lhs, const std::vector<db::PieceType> &rhs)
+{
+    int lhs_value = 0, rhs_value = 0;
+    for (db::PieceType type : lhs)
+        lhs_value += piece_values[type];
+    for (db::PieceType type : rhs)
+        rhs_value += piece_values[type];
+    if (lhs_value != rhs_value)
+        return lhs_value < rhs_value ? -1 : 1;
+    if (lhs != rhs)
+        return lhs < rhs ? -1 : 1;
+    return 0;
+}
+
+uint64_t swap_key_colors(uint64_t key)
+{
+    return key >> 24 | (key & 0xffffff) << 24;
+}
+} // namespace
+
+uint64_t material_key(const db::Position &position)
+{
+    uint64_t key = 0;
+    for (int color = db::WHITE; color <= db::BLACK; ++color) {
+        for (int type = db::PAWN; type <= db::KING; ++type)
+            key |= uint64_t(std::popcount(position.by_type[type] & position.by_color[color]))
+                   << 4 * (6 * color + type);
+    }
+    return key;
+}
+
+Layout::Layout(std::vector<db::Piece> pieces)
+    : m_pieces(std::move(pieces))
+    , m_has_pawns(false)
+    , m_size(0)
+{
+    for (db::Piece piece : m_pieces)
+        m_has_pawns |= db::type_of(piece) == db::PAWN;
+    m_size = (m_has_pawns ? 32 : TRIANGLE_SIZE) * 64;
+    for (size_t i = 2; i < m_pieces.size(); ++i)
+        m_size *= db::type_of(m_pieces[i]) == db::PAWN ? 48 : 64;
+}
+
+std::optional<Layout> Layout::parse(std::string_view name)
+{
+    const size_t separator = name.find('v');
+    if (separator == std::string_view::npos)
+        return std::nullopt;
+    std::vector<db::Piece> pieces;
+    int kings[2] = {0, 0};
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (i == separator)
+            continue;
+        const size_t type = db::fen_char_pieces.find(name[i]);
+        if (type >= db::PIECE_TYPES)
+            return std::nullopt;
+        const db::Color color = i < separator ? db::WHITE : db::BLACK;
+        kings[color] += type == db::KING;
+        pieces.push_back(db::make_piece(db::PieceType(type), color));
+    }
+    if (kings[db::WHITE] != 1 || kings[db::BLACK] != 1 || pieces.size() > size_t(MAX_PIECES))
+        return std::nullopt;
+
+    std::vector<db::PieceType> white = side_types(pieces, db::WHITE);
+    std::vector<db::PieceType> black = side_types(pieces, db::BLACK);
+    if (compare_sides(white, black) < 0)
+        std::swap(white, black);
+    std::vector<db::Piece> ordered = {db::WHITE_KING, db::BLACK_KING};
+    for (size_t i = 1; i < white.size(); ++i)
+        ordered.push_back(db::make_piece(white[i], db::WHITE));
+    for (size_t i = 1; i < black.size(); ++i)
+        ordered.push_back(db::make_piece(black[i], db::BLACK));
+    return Layout(std::move(ordered));
+}
+
+std::string Layout::name() const
+{
+    std::string name;
+    for (db::Color color : {db::WHITE, db::BLACK}) {
+        if (color == db::BLACK)
+            name.push_back('v');
+        for (db::PieceType type : side_types(m_pieces, color))
+            name.push_back(db::fen_char_pieces[type]);
+    }
+    return name;
+}
+
+uint64_t Layout::material_key() const
+{
+    uint64_t key = 0;
+    for (db::Piece piece : m_pieces)
+        key += uint64_t(1) << 4 * (6 * db::color_of(piece) + db::type_of(piece));
+    return key;
+}
+
+void Layout::squares(const db::Position &position, bool flipped, db::Square *squares) const
+{
+    db::Bitboard remaining[12];
+    for (int piece = db::WHITE_PAWN; piece <= db::BLACK_KING; ++piece)
+        remaining[piece] = position.by_type[db::type_of(db::Piece(piece))] &
+                           position.by_color[db::color_of(db::Piece(piece))];
+    for (size_t i = 0; i < m_pieces.size(); ++i) {
+        db::Bitboard &bitboard = remaining[flipped ? swap_color(m_pieces[i]) : m_pieces[i]];
+        const db::Square square = db::Square(std::countr_zero(bitboard));
+        bitboard &= bitboard - 1;
+        squares[i] = flipped ? mirror_rank(square) : square;
+    }
+}
+
+uint64_t Layout::index(const db::Square *squares) const
+{
+    const size_t count = m_pieces.size();
+    db::Square normalized[MAX_PIECES]{};
+    std::copy_n(squares, count, normalized);
+    auto apply = [&](db::Square (*transform)(db::Square)) {
+        for (size_t i = 0; i < count; ++i)
+            normalized[i] = transform(normalized[i]);
+    };
+    if (db::file_of(normalized[0]) > db::FILE_D)
+        apply(mirror_file);
+    if (m_has_pawns)
+        return raw_index(normalized);
+    if (db::rank_of(normalized[0]) > db::RANK_4)
+        apply(mirror_rank);
+    const int king_rank = db::rank_of(normalized[0]), king_file = db::file_of(normalized[0]);
+    if (king_rank > king_file)
+        apply(transpose);
+    if (king_rank != king_file)
+        return raw_index(normalized);
+    // the transposition keeps a king on the diagonal where it is, the smaller index of the two stands for both
+    const uint64_t index = raw_index(normalized);
+    apply(transpose);
+    return std::min(index, raw_index(normalized));
+}
+
+uint64_t Layout::raw_index(const db::Square *squares) const
+{
+    uint64_t index =
+        m_has_pawns ? db::rank_of(squares[0]) * 4 + db::file_of(squares[0]) : uint64_t(triangle_index[squares[0]]);
+    index = index * 64 + squares[1];
+    for (size_t i = 2; i < m_pieces.size(); ++i) {
+        if (db::type_of(m_pieces[i]) != db::PAWN) {
+            index = index * 64 + squares[i];
+            continue;
+        }
+        // a pawn on the first or last rank has no index
+        if (squares[i] < db::A2 || squares[i] > db::H7)
+            return m_size;
+        index = index * 48 + (squares[i] - db::A2);
+    }
+    return index;
+}
+
+bool Layout::decode(uint64_t index, db::Square *squares) const
+{
+    if (index >= m_size)
+        return false;
+    uint64_t rest = index;
+    for (size_t i = m_pieces.size() - 1; i >= 2; --i) {
+        if (db::type_of(m_pieces[i]) == db::PAWN) {
+            squares[i] = db::Square(db::A2 + rest % 48);
+            rest /= 48;
+        } else {
+            squares[i] = db::Square(rest % 64);
+            rest /= 64;
+        }
+    }
+    squares[1] = db::Square(rest % 64);
+    rest /= 64;
+    squares[0] = m_has_pawns ? db::Square(rest / 4 * 8 + rest % 4) : triangle[rest];
+
+    db::Bitboard occupied = 0;
+    for (size_t i = 0; i < m_pieces.size(); ++i) {
+        if (occupied & db::square_bitboard(squares[i]))
+            return false;
+        occupied |= db::square_bitboard(squares[i]);
+    }
+    return this->index(squares) == index;
+}
+
+uint64_t write_table(const std::string &path, const Layout &layout, const std::vector<uint8_t> &white_to_move,
+                     const std::vector<uint8_t> &black_to_move)
+{
+    const uint64_t size = layout.size();
+    if (white_to_move.size() != size || black_to_move.size() != size)
+        throw std::invalid_argument("values do not match the table " + layout.name());
+    const uint64_t blocks = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    uint8_t header[HEADER_SIZE] = {};
+    std::memcpy(header, MAGIC, sizeof(MAGIC));
+    const uint32_t piece_count = uint32_t(layout.pieces().size());
+    std::memcpy(header + sizeof(MAGIC), &piece_count, sizeof(piece_count));
+    for (size_t i = 0; i < piece_count; ++i)
+        header[PIECES_OFFSET + i] = uint8_t(layout.pieces()[i]);
+    std::memcpy(header + SIZE_OFFSET, &size, sizeof(size));
+    std::memcpy(header + BLOCKS_OFFSET, &blocks, sizeof(blocks));
+
+    std::vector<uint64_t> offsets;
+    std::vector<uint8_t> data;
+    for (const auto *side : {&white_to_move, &black_to_move}) {
+        for (uint64_t begin = 0; begin < size; begin += BLOCK_SIZE) {
+            offsets.push_back(data.size());
+            const std::vector<uint8_t> block = encode_block(side->data() + begin, std::min(BLOCK_SIZE, size - begin));
+            data.insert(data.end(), block.begin(), block.end());
+        }
+        offsets.push_back(data.size());
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(offsets.data()), std::streamsize(offsets.size() * sizeof(uint64_t)));
+    out.write(reinterpret_cast<const char *>(data.data()), std::streamsize(data.size()));
+    if (!out)
+        throw std::runtime_error("cannot write " + path);
+    return sizeof(header) + offsets.size() * sizeof(uint64_t) + data.size();
+}
+
+struct Tablebases::File
+{
+    File(std::string path, Layout layout)
+        : path(std::move(path))
+        , layout(std::move(layout))
+    {}
+
+    ~File()
+    {
+#ifdef __unix__
+        if (mapping)
+            munmap(const_cast<uint8_t *>(mapping), mapping_size);
+#endif
+    }
+
+    // maps the file and checks its header and block offsets, blocks stays null if that fails
+    void open()
+    {
+        const uint8_t *data = nullptr;
+        size_t file_size = 0;
+#ifdef __unix__
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat status;
+        if (fstat(fd, &status) != 0 || size_t(status.st_size) < HEADER_SIZE) {
+            close(fd);
+            return;
+        }
+        file_size = size_t(status.st_size);
+        void *map = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED)
+            return;
+        // probes land anywhere in the file
+        madvise(map, file_size, MADV_RANDOM);
+        mapping = static_cast<const uint8_t *>(map);
+        mapping_size = file_size;
+        data = mapping;
+#else
+        std::ifstream in(path, std::ios::binary);
+        owned.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        file_size = owned.size();
+        if (file_size < HEADER_SIZE)
+            return;
+        data = owned.data();
+#endif
+        uint32_t piece_count;
+        std::memcpy(&piece_count, data + sizeof(MAGIC), sizeof(piece_count));
+        const uint64_t size = read_u64(data + SIZE_OFFSET);
+        const uint64_t blocks = read_u64(data + BLOCKS_OFFSET);
+        if (std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0 || piece_count != layout.pieces().size() ||
+            size != layout.size() || blocks != (size + BLOCK_SIZE - 1) / BLOCK_SIZE)
+            return;
+        for (size_t i = 0; i < piece_count; ++i) {
+            if (data[PIECES_OFFSET + i] != layout.pieces()[i])
+                return;
+        }
+        const size_t blocks_begin = HEADER_SIZE + 2 * (blocks + 1) * sizeof(uint64_t);
+        if (file_size < blocks_begin ||
+            read_u64(data + HEADER_SIZE + (2 * blocks + 1) * sizeof(uint64_t)) != file_size - blocks_begin)
+            return;
+        offsets[db::WHITE] = data + HEADER_SIZE;
+        offsets[db::BLACK] = data + HEADER_SIZE + (blocks + 1) * sizeof(uint64_t);
+        this->blocks = data + blocks_begin;
+    }
+
+    [[nodiscard]] uint8_t value(db::Color stm, uint64_t index) const
+    {
+        const uint8_t *block = blocks + read_u64(offsets[stm] + index / BLOCK_SIZE * sizeof(uint64_t));
+        return block_value(block, index % BLOCK_SIZE);
+    }
+
+    std::string path;
+    Layout layout;
+    std::once_flag opened;
+    const uint8_t *offsets[2]{nullptr, nullptr};
+    const uint8_t *blocks{nullptr};
+    const uint8_t *mapping{nullptr};
+    size_t mapping_size{0};
+    std::vector<uint8_t> owned;
+};
+
+Tablebases::Tablebases()
+    : m_syzygy(std::make_unique<Syzygy>())
+    , m_max_pieces(0)
+{}
+
+Tablebases::~Tablebases() = default;
+
+size_t Tablebases::add_directory(const std::string &directory)
+{
+    namespace fs = std::filesystem;
+    size_t added = 0;
+    std::error_code error;
+    for (const auto &entry : fs::directory_iterator(directory, error)) {
+        if (!entry.is_regular_file(error) || entry.path().extension() != ".ctb")
+            continue;
+        const std::string name = entry.path().stem().string();
+        std::optional<Layout> layout = Layout::parse(name);
+        // only the canonical name, a table exists once
+        if (!layout || layout->name() != name || m_tables.contains(layout->material_key()))
+            continue;
+        const uint64_t key = layout->material_key();
+        m_max_pieces = std::max(m_max_pieces, int(layout->pieces().size()));
+        m_files.push_back(std::make_unique<File>(entry.path().string(), std::move(*layout)));
+        m_tables.emplace(key, std::make_pair(m_files.back().get(), false));
+        m_tables.emplace(swap_key_colors(key), std::make_pair(m_files.back().get(), true));
+        ++added;
+    }
+    added += m_syzygy->add_directory(directory);
+    m_max_pieces = std::max(m_max_pieces, m_syzygy->max_pieces());
+    return added;
+}
+
+size_t Tablebases::size() const
+{
+    return m_files.size() + m_syzygy->size();
+}
+
+std::optional<ProbeResult> Tablebases::probe(const db::Position &position) const
+{
+    return probe(position, true);
+}
+
+std::optional<ProbeResult> Tablebases::probe_wdl(const db::Position &position) const
+{
+    return probe(position, false);
+}
+
+std::optional<ProbeResult> Tablebases::probe(const db::Position &position, bool dtz) const
+{
+    const auto probe_syzygy = [&] { return dtz ? m_syzygy->probe(position) : m_syzygy->probe_wdl(position); };
+    if (position.castling_rights != db::CASTLING_NONE)
+        return std::nullopt;
+    // both kings alone are a draw without a table
+    const int pieces = std::popcount(position.by_color[db::WHITE] | position.by_color[db::BLACK]);
+    if (pieces == 2)
+        return ProbeResult{};
+    if (pieces > m_max_pieces)
+        return std::nullopt;
+    // the en passant square only matters when a pawn can take, the tables have no positions where one can. The
+    // Syzygy probe searches the capture.
+    if (position.ep != db::SQUARE_NONE) {
+        const db::Square pushed = db::Square(position.stm == db::WHITE ? position.ep - 8 : position.ep + 8);
+        const db::File file = db::file_of(pushed);
+        const db::Bitboard neighbours = (file > db::FILE_A ? db::square_bitboard(db::Square(pushed - 1)) : 0) |
+                                        (file < db::FILE_H ? db::square_bitboard(db::Square(pushed + 1)) : 0);
+        if (neighbours & position.by_type[db::PAWN] & position.by_color[position.stm])
+            return probe_syzygy();
+    }
+    const auto it = m_tables.find(material_key(position));
+    if (it == m_tables.end())
+        return probe_syzygy();
+
+    File &file = *it->second.first;
+    const bool flipped = it->second.second;
+    std::call_once(file.opened, [&file] { file.open(); });
+    if (!file.blocks)
+        return probe_syzygy();
+    db::Square squares[MAX_PIECES];
+    file.layout.squares(position, flipped, squares);
+    const uint64_t index = file.layout.index(squares);
+    if (index >= file.layout.size())
+        return std::nullopt;
+    return decode_value(file.value(flipped ? db::opposite(position.stm) : position.stm, index));
+}
+
+} // namespace engine::tb
@@ -0,0 +1,131 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "bitboard.hxx"
+
+// Endgame tablebases: for every position of a material combination the game theoretic result and the distance to
+// the next capture or pawn move (DTZ) with best play, both from the side to move. The 50 move rule is not part of the
+// result, a caller compares dtz plus the half move clock with 100 to tell the wins that are still wins over the board.
+// Tables cover positions without castling rights and without an en passant square.
+namespace engine::tb {
+class Syzygy;
+constexpr int MAX_PIECES = 7;
+
+// one byte per position: DRAW, WIN + dtz for dtz 1 to MAX_DTZ and LOSS + dtz for dtz 0 to MAX_DTZ, longer distances
+// are saturated. ILLEGAL marks indices that do not stand for a reachable position, the files keep any value for them.
+constexpr uint8_t DRAW = 0;
+constexpr uint8_t WIN = 0;
+constexpr uint8_t LOSS = 128;
+constexpr uint8_t ILLEGAL = 255;
+constexpr int MAX_DTZ = 126;
+
+// material of a position packed into a nibble per piece and color
+uint64_t material_key(const db::Position &position);
+
+// The pieces of a table and the mapping between positions and table indices. Pieces are ordered white king, black
+// king, then white's other pieces from queen down to pawn and black's in the same order; white is the side with more
+// material. Positions are reduced by symmetry before indexing: without pawns the white king is moved into the
+// a1-d1-d4 triangle (on the diagonal the smaller index of the position and its transposition counts), with pawns the
+// white king is mirrored onto the a-d files. Kings index 64 squares, pawns the 48 squares of ranks 2 to 7.
+class Layout
+{
+public:
+    explicit Layout(std::vector<db::Piece> pieces);
+    // "KRPvKR", nullopt if the name does not describe material with both kings and at most MAX_PIECES pieces
+    static std::optional<Layout> parse(std::string_view name);
+
+    [[nodiscard]] const std::vector<db::Piece> &pieces() const { return m_pieces; }
+    [[nodiscard]] bool has_pawns() const { return m_has_pawns; }
+    [[nodiscard]] std::string name() const;
+    [[nodiscard]] uint64_t material_key() const;
+    // indices per side to move
+    [[nodiscard]] uint64_t size() const { return m_size; }
+
+    // squares of the position's pieces in table order, flipped swaps the colors and mirrors the ranks for positions
+    // of the material with colors reversed
+    void squares(const db::Position &position, bool flipped, db::Square *squares) const;
+    // index of the (not yet normalized) squares in table order
+    [[nodiscard]] uint64_t index(const db::Square *squares) const;
+    // squares of the index; false for indices no position maps to, because pieces overlap or the symmetry
+    // reduction would have moved them elsewhere
+    bool decode(uint64_t index, db::Square *squares) const;
+
+private:
+    // index of squares that are already normalized
+    [[nodiscard]] uint64_t raw_index(const db::Square *squares) const;
+
+    std::vector<db::Piece> m_pieces;
+    bool m_has_pawns;
+    uint64_t m_size;
+};
+
+// WDL and DTZ from the side to move
+enum class Wdl : int8_t
+{
+    LOSS = -1,
+    DRAW = 0,
+    WIN = 1,
+};
+
+struct ProbeResult
+{
+    Wdl wdl{Wdl::DRAW};
+    int dtz{0}; // plies to the next zeroing move with best play, 0 for draws and when mated
+};
+
+// inverse of the value encoding
+inline ProbeResult decode_value(uint8_t value)
+{
+    if (value == DRAW)
+        return {};
+    if (value < LOSS)
+        return {Wdl::WIN, value - WIN};
+    return {Wdl::LOSS, value - LOSS};
+}
+
+// writes a compressed table file from the value of every index with white and with black to move, returns its size
+uint64_t write_table(const std::string &path, const Layout &layout, const std::vector<uint8_t> &white_to_move,
+                     const std::vector<uint8_t> &black_to_move);
+
+// A directory of table files ("KQvK.ctb"), each one holds both sides to move of one material combination and is
+// used for the mirrored material as well. Syzygy files (KQvK.rtbw and KQvK.rtbz) in the same directories answer the
+// positions no table file covers. Files are only memory mapped on the first probe that needs them.
+class Tablebases
+{
+public:
+    Tablebases();
+    ~Tablebases();
+    Tablebases(const Tablebases &) = delete;
+    Tablebases &operator=(const Tablebases &) = delete;
+
+    // registers the tables and Syzygy WDL files found in directory and returns their number. Not thread safe, call
+    // it before probing.
+    size_t add_directory(const std::string &directory);
+    [[nodiscard]] size_t size() const;
+    // most pieces of any table, 0 without tables
+    [[nodiscard]] int max_pieces() const { return m_max_pieces; }
+
+    // nullopt unless a table covers the position, the result of positions that cannot arise is undefined. Thread safe.
+    [[nodiscard]] std::optional<ProbeResult> probe(const db::Position &position) const;
+    // probe for the search: the same for table files, Syzygy positions only read the WDL file (see Syzygy::probe_wdl)
+    [[nodiscard]] std::optional<ProbeResult> probe_wdl(const db::Position &position) const;
+
+private:
+    struct File;
+
+    std::optional<ProbeResult> probe(const db::Position &position, bool dtz) const;
+
+    std::vector<std::unique_ptr<File>> m_files;
+    // material key of both color assignments to the file and whether the position needs flipping
+    std::unordered_map<uint64_t, std::pair<File *, bool>> m_tables;
+    std::unique_ptr<Syzygy> m_syzygy;
+    int m_max_pieces;
+};
+} // namespace engine::tb
@@ -0,0 +1,446 @@
+#include "tbgen.hxx"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <exception>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+namespace engine::tb {
+
+namespace {
+// a multiple of 64 so that every chunk owns whole words of the bitsets
+constexpr uint64_t CHUNK_SIZE = 1 << 14;
+// results of the first pass, before the distances are known
+constexpr uint8_t WON = WIN + 1;
+constexpr uint8_t LOST = LOSS;
+
+bool is_win(uint8_t value)
+{
+    return value != DRAW && value < LOSS;
+}
+
+bool is_loss(uint8_t value)
+{
+    return value >= LOSS && value != ILLEGAL;
+}
+
+uint8_t load(const uint8_t &value)
+{
+    return std::atomic_ref<const uint8_t>(value).load(std::memory_order_relaxed);
+}
+
+void store(uint8_t &value, uint8_t new_value)
+{
+    std::atomic_ref<uint8_t>(value).store(new_value, std::memory_order_relaxed);
+}
+
+// returns whether the bit was not set before
+bool set_bit(std::vector<uint64_t> &bitset, uint64_t index)
+{
+    const uint64_t bit = uint64_t(1) << (index % 64);
+    return !(std::atomic_ref<uint64_t>(bitset[index / 64]).fetch_or(bit, std::memory_order_relaxed) & bit);
+}
+
+bool test_bit(const std::vector<uint64_t> &bitset, uint64_t index)
+{
+    return std::atomic_ref<const uint64_t>(bitset[index / 64]).load(std::memory_order_relaxed) >> (index % 64) & 1;
+}
+
+// takes the counter one down unless it is zero, returns whether this call took it to zero
+bool decrement(uint8_t &count)
+{
+    std::atomic_ref<uint8_t> counter(count);
+    uint8_t current = counter.load(std::memory_order_relaxed);
+    while (current > 0 && !counter.compare_exchange_weak(current, current - 1, std::memory_order_relaxed)) {
+    }
+    return current == 1;
+}
+
+bool leaves_table(const db::Move &move)
+{
+    return move.captured != db::PIECE_NONE || move.promoted != db::PIECE_NONE;
+}
+
+bool is_zeroing(const db::Move &move)
+{
+    return move.captured != db::PIECE_NONE || db::type_of(move.piece_moved) == db::PAWN;
+}
+
+bool in_check(const db::Position &position)
+{
+    return position.by_type[db::KING] & position.by_color[position.stm] & position.attacks[db::opposite(position.stm)];
+}
+
+// index of the position of squares with the piece on from moved to to
+uint64_t moved_index(const Layout &layout, const db::Square *squares, db::Square from, db::Square to)
+{
+    db::Square moved[MAX_PIECES];
+    const size_t count = layout.pieces().size();
+    std::copy_n(squares, count, moved);
+    *std::find(moved, moved + count, from) = to;
+    return layout.index(moved);
+}
+
+void add_unique(std::vector<uint64_t> &indices, uint64_t index)
+{
+    if (std::find(indices.begin(), indices.end(), index) == indices.end())
+        indices.push_back(index);
+}
+
+// canonical name of the material of a position, for error messages
+std::string material_name(const db::Position &position)
+{
+    std::vector<db::Piece> pieces;
+    for (int square = db::A1; square <= db::H8; ++square) {
+        if (position.board[square] != db::PIECE_NONE)
+            pieces.push_back(position.board[square]);
+    }
+    std::optional<Layout> layout = Layout::parse(Layout(pieces).name());
+    return layout ? layout->name() : Layout(pieces).name();
+}
+} // namespace
+
+struct Generator::Worker
+{
+    db::Board board;
+    db::Position position;
+    db::Square squares[MAX_PIECES];
+    std::vector<uint64_t> indices; // distinct successors or predecessors of the current position
+};
+
+Generator::Generator(Layout layout, const Tablebases &subtables, size_t threads)
+    : m_layout(std::move(layout))
+    , m_subtables(subtables)
+{
+    for (size_t i = 0; i < std::max<size_t>(1, threads); ++i)
+        m_workers.push_back(std::make_unique<Worker>());
+}
+
+Generator::~Generator() = default;
+
+template <typename Work>
+void Generator::parallel_for(const Work &work)
+{
+    const uint64_t size = m_layout.size();
+    std::atomic<uint64_t> next{0};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    std::vector<std::thread> threads;
+    for (auto &worker : m_workers) {
+        threads.emplace_back([&, worker = worker.get()] {
+            try {
+                for (uint64_t begin; (begin = next.fetch_add(CHUNK_SIZE)) < size;)
+                    work(*worker, begin, std::min(begin + CHUNK_SIZE, size));
+            } catch (...) {
+                std::lock_guard lock(error_mutex);
+                error = std::current_exception();
+                next = size;
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    if (error)
+        std::rethrow_exception(error);
+}
+
+bool Generator::setup(Worker &worker, uint64_t index, db::Color stm) const
+{
+    if (!m_layout.decode(index, worker.squares))
+        return false;
+    db::Position &position = worker.position;
+    position = db::Position();
+    for (size_t i = 0; i < m_layout.pieces().size(); ++i)
+        worker.board.set_piece_at(m_layout.pieces()[i], worker.squares[i], position);
+    position.stm = stm;
+    worker.board.update_attacks(position);
+    // the side that has just moved cannot be in check
+    const db::Bitboard king = position.by_type[db::KING] & position.by_color[db::opposite(stm)];
+    const db::Bitboard occupied = position.by_color[db::WHITE] | position.by_color[db::BLACK];
+    return !(worker.board.attackers_to(db::Square(std::countr_zero(king)), occupied, position) &
+             position.by_color[stm]);
+}
+
+Wdl Generator::probe_exit(const db::Position &position) const
+{
+    const std::optional<ProbeResult> result = m_subtables.probe(position);
+    if (!result)
+        throw std::runtime_error("the table " + material_name(position) + " is needed first");
+    return result->wdl;
+}
+
+void Generator::init_wdl(Worker &worker, uint64_t begin, uint64_t end)
+{
+    for (db::Color stm : {db::WHITE, db::BLACK}) {
+        for (uint64_t index = begin; index < end; ++index) {
+            uint8_t &value = m_values[stm][index];
+            m_counts[stm][index] = 0;
+            if (!setup(worker, index, stm)) {
+                value = ILLEGAL;
+                continue;
+            }
+            const db::Position &position = worker.position;
+            value = DRAW;
+            const std::vector<db::Move> moves = worker.board.generate_moves(position);
+            if (moves.empty()) {
+                if (in_check(position)) {
+                    value = LOST;
+                    set_bit(m_frontier[stm], index);
+                }
+                continue;
+            }
+
+            bool won = false, drawn_exit = false;
+            worker.indices.clear();
+            for (const auto &move : moves) {
+                if (!leaves_table(move)) {
+                    add_unique(worker.indices, moved_index(m_layout, worker.squares, move.from, move.to));
+                    continue;
+                }
+                const Wdl wdl = probe_exit(worker.board.test_move(move, position));
+                won |= wdl == Wdl::LOSS;
+                drawn_exit |= wdl == Wdl::DRAW;
+                if (won)
+                    break;
+            }
+            if (won) {
+                value = WON;
+                set_bit(m_frontier[stm], index);
+                continue;
+            }
+            // a drawing capture is a move that never turns out to lose
+            m_counts[stm][index] = uint8_t(worker.indices.size() + drawn_exit);
+            if (m_counts[stm][index] == 0) {
+                value = LOST;
+                set_bit(m_frontier[stm], index);
+            }
+        }
+    }
+}
+
+void Generator::propagate_wdl(Worker &worker, uint64_t begin, uint64_t end)
+{
+    for (db::Color stm : {db::WHITE, db::BLACK}) {
+        const db::Color before = db::opposite(stm);
+        for (uint64_t word = begin / 64; word < (end + 63) / 64; ++word) {
+            for (uint64_t bits = m_frontier[stm][word]; bits; bits &= bits - 1) {
+                const uint64_t index = word * 64 + std::countr_zero(bits);
+                setup(worker, index, stm);
+                const bool lost = is_loss(load(m_values[stm][index]));
+                worker.indices.clear();
+                for (const auto &unmove : worker.board.generate_unmoves(worker.position))
+                    add_unique(worker.indices, moved_index(m_layout, worker.squares, unmove.to, unmove.from));
+
+                for (uint64_t predecessor : worker.indices) {
+                    // positions that are decided, drawn without moves or illegal have no counter
+                    uint8_t &count = m_counts[before][predecessor];
+                    if (load(count) == 0)
+                        continue;
+                    if (lost) {
+                        uint8_t expected = DRAW;
+                        if (std::atomic_ref<uint8_t>(m_values[before][predecessor]).compare_exchange_strong(expected,
+                                                                                                           WON)) {
+                            store(count, 0);
+                            set_bit(m_next[before], predecessor);
+                        }
+                    } else if (decrement(count)) {
+                        // the move to a lost position would have kept the counter above zero
+                        store(m_values[before][predecessor], LOST);
+                        set_bit(m_next[before], predecessor);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void Generator::init_dtz(Worker &worker, uint64_t begin, uint64_t end)
+{
+    for (db::Color stm : {db::WHITE, db::BLACK}) {
+        for (uint64_t index = begin; index < end; ++index) {
+            const uint8_t value = load(m_values[stm][index]);
+            m_counts[stm][index] = 0;
+            if (value == DRAW || value == ILLEGAL)
+                continue;
+            setup(worker, index, stm);
+            const db::Position &position = worker.position;
+            const std::vector<db::Move> moves = worker.board.generate_moves(position);
+            if (moves.empty()) {
+                set_bit(m_resolved[stm], index);
+                set_bit(m_frontier[stm], index);
+                continue;
+            }
+
+            if (is_win(value)) {
+                // a capture or pawn move into a lost position wins at once
+                for (const auto &move : moves) {
+                    if (!is_zeroing(move))
+                        continue;
+                    const bool wins =
+                        leaves_table(move)
+                            ? probe_exit(worker.board.test_move(move, position)) == Wdl::LOSS
+                            : is_loss(load(m_values[db::opposite(stm)][moved_index(m_layout, worker.squares, move.from,
+                                                                                 move.to)]));
+                    if (wins) {
+                        store(m_values[stm][index], WIN + 1);
+                        set_bit(m_resolved[stm], index);
+                        set_bit(m_next[stm], index);
+                        break;
+                    }
+                }
+                continue;
+            }
+
+            // a lost position waits for all of its moves that keep the counter going
+            worker.indices.clear();
+            for (const auto &move : moves) {
+                if (!is_zeroing(move))
+                    add_unique(worker.indices, moved_index(m_layout, worker.squares, move.from, move.to));
+            }
+            if (worker.indices.empty()) {
+                store(m_values[stm][index], LOSS + 1);
+                set_bit(m_resolved[stm], index);
+                set_bit(m_next[stm], index);
+            } else {
+                m_counts[stm][index] = uint8_t(worker.indices.size());
+            }
+        }
+    }
+}
+
+void Generator::propagate_dtz(Worker &worker, uint64_t begin, uint64_t end, int level)
+{
+    const int dtz = std::min(level + 1, MAX_DTZ);
+    for (db::Color stm : {db::WHITE, db::BLACK}) {
+        const db::Color before = db::opposite(stm);
+        for (uint64_t word = begin / 64; word < (end + 63) / 64; ++word) {
+            for (uint64_t bits = m_frontier[stm][word]; bits; bits &= bits - 1) {
+                const uint64_t index = word * 64 + std::countr_zero(bits);
+                setup(worker, index, stm);
+                const bool lost = is_loss(load(m_values[stm][index]));
+                worker.indices.clear();
+                for (const auto &unmove : worker.board.generate_unmoves(worker.position)) {
+                    if (db::type_of(unmove.piece_moved) != db::PAWN)
+                        add_unique(worker.indices, moved_index(m_layout, worker.squares, unmove.to, unmove.from));
+                }
+
+                for (uint64_t predecessor : worker.indices) {
+                    if (test_bit(m_resolved[before], predecessor))
+                        continue;
+                    const uint8_t value = load(m_values[before][predecessor]);
+                    if (lost) {
+                        if (is_win(value) && set_bit(m_resolved[before], predecessor)) {
+                            store(m_values[before][predecessor], uint8_t(WIN + dtz));
+                            set_bit(m_next[before], predecessor);
+                        }
+                    } else if (is_loss(value) && decrement(m_counts[before][predecessor])) {
+                        set_bit(m_resolved[before], predecessor);
+                        store(m_values[before][predecessor], uint8_t(LOSS + dtz));
+                        set_bit(m_next[before], predecessor);
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool Generator::frontier_empty() const
+{
+    for (const auto &frontier : m_frontier) {
+        if (std::any_of(frontier.begin(), frontier.end(), [](uint64_t word) { return word != 0; }))
+            return false;
+    }
+    return true;
+}
+
+void Generator::next_level()
+{
+    for (int color = db::WHITE; color <= db::BLACK; ++color) {
+        m_frontier[color].swap(m_next[color]);
+        std::fill(m_next[color].begin(), m_next[color].end(), 0);
+    }
+}
+
+Generator::Stats Generator::run()
+{
+    const uint64_t size = m_layout.size();
+    for (int color = db::WHITE; color <= db::BLACK; ++color) {
+        m_values[color].assign(size, DRAW);
+        m_counts[color].assign(size, 0);
+        m_frontier[color].assign((size + 63) / 64, 0);
+        m_next[color].assign((size + 63) / 64, 0);
+        m_resolved[color].assign((size + 63) / 64, 0);
+    }
+
+    Stats stats;
+    parallel_for([this](Worker &worker, uint64_t begin, uint64_t end) { init_wdl(worker, begin, end); });
+    while (!frontier_empty()) {
+        parallel_for([this](Worker &worker, uint64_t begin, uint64_t end) { propagate_wdl(worker, begin, end); });
+        next_level();
+        ++stats.wdl_iterations;
+    }
+
+    // the mates start out at level 0 in the frontier, the positions decided by a zeroing move at level 1 in next
+    parallel_for([this](Worker &worker, uint64_t begin, uint64_t end) { init_dtz(worker, begin, end); });
+    do {
+        const int level = stats.dtz_iterations;
+        parallel_for([this, level](Worker &worker, uint64_t begin, uint64_t end) {
+            propagate_dtz(worker, begin, end, level);
+        });
+        next_level();
+        ++stats.dtz_iterations;
+    } while (!frontier_empty());
+
+    for (const auto &values : m_values) {
+        for (uint8_t value : values) {
+            stats.positions += value != ILLEGAL;
+            stats.wins += is_win(value);
+            stats.draws += value == DRAW;
+            stats.losses += is_loss(value);
+        }
+    }
+    m_counts[db::WHITE] = m_counts[db::BLACK] = {};
+    return stats;
+}
+
+std::vector<Layout> Generator::dependencies(const Layout &layout)
+{
+    std::vector<Layout> dependencies;
+    std::set<std::string> names;
+    auto add = [&](const std::vector<db::Piece> &pieces) {
+        // both kings alone need no table
+        if (pieces.size() <= 2)
+            return;
+        std::optional<Layout> dependency = Layout::parse(Layout(pieces).name());
+        if (names.insert(dependency->name()).second)
+            dependencies.push_back(std::move(*dependency));
+    };
+
+    const std::vector<db::Piece> &pieces = layout.pieces();
+    for (size_t i = 2; i < pieces.size(); ++i) {
+        std::vector<db::Piece> captured = pieces;
+        captured.erase(captured.begin() + i);
+        add(captured);
+        if (db::type_of(pieces[i]) != db::PAWN)
+            continue;
+        for (db::PieceType type : {db::QUEEN, db::ROOK, db::BISHOP, db::KNIGHT}) {
+            std::vector<db::Piece> promoted = pieces;
+            promoted[i] = db::make_piece(type, db::color_of(pieces[i]));
+            add(promoted);
+            for (size_t j = 2; j < pieces.size(); ++j) {
+                if (db::color_of(pieces[j]) == db::color_of(pieces[i]))
+                    continue;
+                std::vector<db::Piece> promoted_capture = promoted;
+                promoted_capture.erase(promoted_capture.begin() + j);
+                add(promoted_capture);
+            }
+        }
+    }
+    return dependencies;
+}
+
+} // namespace engine::tb
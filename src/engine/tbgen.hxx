@@ -0,0 +1,71 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "tablebase.hxx"
+
+namespace engine::tb {
+// Retrograde analysis of one table. The result of every position is resolved backwards from the mates: a position
+// is won once one move reaches a lost position, and lost once a counter of its moves not yet known to win for the
+// opponent runs out. DTZ follows with the same scheme over the moves that do not reset the 50 move counter, seeded by
+// the positions a capture or pawn move decides. Captures and promotions leave the table and are looked up in the
+// tables of the smaller material, which have to be found in subtables. Both passes go level by level over bitsets of
+// the positions resolved in the previous level, every level is split over the threads.
+class Generator
+{
+public:
+    struct Stats
+    {
+        uint64_t positions{0}; // legal positions of both sides to move
+        uint64_t wins{0};
+        uint64_t draws{0};
+        uint64_t losses{0};
+        int wdl_iterations{0};
+        int dtz_iterations{0};
+    };
+
+    Generator(Layout layout, const Tablebases &subtables, size_t threads);
+    ~Generator();
+
+    // throws std::runtime_error if a table a capture or promotion leads to is missing
+    Stats run();
+    // value of every index with stm to move, in the encoding of the table files
+    [[nodiscard]] const std::vector<uint8_t> &values(db::Color stm) const { return m_values[stm]; }
+
+    // materials reached by a capture or a promotion, the tables that have to exist before this one is generated
+    static std::vector<Layout> dependencies(const Layout &layout);
+
+private:
+    struct Worker;
+    using Bitset = std::vector<uint64_t>;
+
+    // runs work(worker, begin, end) over chunks of the index range on every thread
+    template <typename Work>
+    void parallel_for(const Work &work);
+    // builds the position of index, false if it is not legal
+    bool setup(Worker &worker, uint64_t index, db::Color stm) const;
+    // the result of a position outside the table
+    Wdl probe_exit(const db::Position &position) const;
+
+    void init_wdl(Worker &worker, uint64_t begin, uint64_t end);
+    void propagate_wdl(Worker &worker, uint64_t begin, uint64_t end);
+    void init_dtz(Worker &worker, uint64_t begin, uint64_t end);
+    void propagate_dtz(Worker &worker, uint64_t begin, uint64_t end, int level);
+    // no bit set in either side's frontier
+    [[nodiscard]] bool frontier_empty() const;
+    void next_level();
+
+    Layout m_layout;
+    const Tablebases &m_subtables;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+
+    std::vector<uint8_t> m_values[2];
+    // moves of an undecided position not known to lose yet, then the moves a lost position still waits for
+    std::vector<uint8_t> m_counts[2];
+    Bitset m_frontier[2];
+    Bitset m_next[2];
+    Bitset m_resolved[2];
+};
+} // namespace engine::tb
@@ -0,0 +1,31 @@
+#include "trainingdata.hxx"
+
+#include <fstream>
+#include <stdexcept>
+
+namespace engine {
+
+void write_training_chunk(const std::string &path, const std::vector<TrainingRecord> &records)
+{
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(records.data()), std::streamsize(records.size() * sizeof(TrainingRecord)));
+    if (!out)
+        throw std::runtime_error("cannot write " + path);
+}
+
+std::vector<TrainingRecord> read_training_chunk(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in)
+        throw std::runtime_error("cannot open " + path);
+    const auto size = size_t(in.tellg());
+    if (size % sizeof(TrainingRecord) != 0)
+        throw std::runtime_error(path + " is not a training chunk");
+    std::vector<TrainingRecord> records(size / sizeof(TrainingRecord));
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char *>(records.data()), std::streamsize(size)))
+        throw std::runtime_error("cannot read " + path);
+    return records;
+}
+
+} // namespace engine
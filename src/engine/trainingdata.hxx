@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "packedposition.hxx"
+
+// Labelled positions for fitting the evaluation. A chunk file is a plain array of records in no particular order,
+// chesscli datagen writes them shuffled so that any slice of a chunk mixes positions of many games.
+namespace engine {
+struct TrainingRecord
+{
+    db::PackedPosition position;
+    int16_t score{0};  // search score in centipawns from the side to move
+    int8_t result{0};  // game result from the side to move: -1 lost, 0 drawn, 1 won
+    uint8_t reserved{0};
+    uint16_t ply{0};   // plies played in the game before the position
+    uint16_t reserved2{0};
+};
+
+static_assert(sizeof(TrainingRecord) == 40 && std::is_trivially_copyable_v<TrainingRecord>);
+
+// throws std::runtime_error on I/O errors and on files that are not a whole number of records
+void write_training_chunk(const std::string &path, const std::vector<TrainingRecord> &records);
+std::vector<TrainingRecord> read_training_chunk(const std::string &path);
+} // namespace engine
@@ -0,0 +1,134 @@
+#include "transpositiontable.hxx"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace engine {
+
+static constexpr size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+
+// data layout: from 6 bits, to 6 bits, promoted piece type 3 bits, bound 2 bits, depth 8 bits, score 16 bits,
+// generation 8 bits
+TranspositionTable::TranspositionTable(size_t size_mb, bool huge_pages)
+    : m_cluster_count(std::max<size_t>(1, (size_mb << 20) / sizeof(Cluster)))
+    , m_huge_pages(false)
+    , m_generation(0)
+{
+    size_t bytes = m_cluster_count * sizeof(Cluster);
+    void *memory = nullptr;
+#ifdef __linux__
+    if (huge_pages && bytes >= HUGE_PAGE_SIZE) {
+        // huge pages need the mapping aligned to them, the size must be a multiple of the alignment
+        size_t aligned_bytes = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        memory = std::aligned_alloc(HUGE_PAGE_SIZE, aligned_bytes);
+        if (memory)
+            m_huge_pages = madvise(memory, aligned_bytes, MADV_HUGEPAGE) == 0;
+    }
+#endif
+    if (!memory)
+        memory = std::aligned_alloc(alignof(Cluster), bytes);
+    if (!memory)
+        throw std::bad_alloc();
+    m_clusters = static_cast<Cluster *>(memory);
+    for (size_t i = 0; i < m_cluster_count; ++i)
+        new (&m_clusters[i]) Cluster();
+    clear();
+}
+
+TranspositionTable::~TranspositionTable()
+{
+    std::free(m_clusters);
+}
+
+bool TranspositionTable::probe(uint64_t key, TTEntry &entry) const
+{
+    for (const Slot &slot : cluster(key).slots) {
+        uint64_t data = slot.data.load(std::memory_order_relaxed);
+        uint64_t check = slot.check.load(std::memory_order_relaxed);
+        if ((check ^ data) == key && data != 0) {
+            entry = unpack(data);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TranspositionTable::store(uint64_t key, const TTEntry &entry)
+{
+    const uint8_t generation = m_generation.load(std::memory_order_relaxed);
+    Slot *replace = nullptr;
+    int replace_value = 0;
+    for (Slot &slot : cluster(key).slots) {
+        uint64_t data = slot.data.load(std::memory_order_relaxed);
+        uint64_t check = slot.check.load(std::memory_order_relaxed);
+        if (data == 0 || (check ^ data) == key) {
+            replace = &slot;
+            break;
+        }
+        // the shallowest entry goes first, every generation of age counts like several plies of depth
+        int value = depth_of(data) - 8 * uint8_t(generation - generation_of(data));
+        if (!replace || value < replace_value) {
+            replace = &slot;
+            replace_value = value;
+        }
+    }
+    uint64_t data = pack(entry, generation);
+    replace->check.store(key ^ data, std::memory_order_relaxed);
+    replace->data.store(data, std::memory_order_relaxed);
+}
+
+void TranspositionTable::clear()
+{
+    for (size_t i = 0; i < m_cluster_count; ++i) {
+        for (Slot &slot : m_clusters[i].slots) {
+            slot.check.store(0, std::memory_order_relaxed);
+            slot.data.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+int TranspositionTable::hashfull() const
+{
+    const uint8_t generation = m_generation.load(std::memory_order_relaxed);
+    const size_t clusters = std::min<size_t>(m_cluster_count, 1000 / CLUSTER_SIZE);
+    int used = 0;
+    for (size_t i = 0; i < clusters; ++i) {
+        for (const Slot &slot : m_clusters[i].slots) {
+            uint64_t data = slot.data.load(std::memory_order_relaxed);
+            used += data != 0 && generation_of(data) == generation;
+        }
+    }
+    return int(used * 1000 / (clusters * CLUSTER_SIZE));
+}
+
+uint64_t TranspositionTable::pack(const TTEntry &entry, uint8_t generation)
+{
+    uint64_t data = uint64_t(entry.from & 63);
+    data |= uint64_t(entry.to & 63) << 6;
+    data |= uint64_t(entry.promoted == db::PIECE_TYPE_NONE ? 0 : entry.promoted) << 12;
+    data |= uint64_t(entry.bound) << 15;
+    data |= uint64_t(uint8_t(entry.depth)) << 17;
+    data |= uint64_t(uint16_t(int16_t(entry.score))) << 25;
+    data |= uint64_t(generation) << GENERATION_SHIFT;
+    return data;
+}
+
+TTEntry TranspositionTable::unpack(uint64_t data)
+{
+    TTEntry entry;
+    entry.from = db::Square(data & 63);
+    entry.to = db::Square((data >> 6) & 63);
+    uint64_t promoted = (data >> 12) & 7;
+    entry.promoted = promoted == 0 ? db::PIECE_TYPE_NONE : db::PieceType(promoted);
+    entry.bound = Bound((data >> 15) & 3);
+    entry.depth = depth_of(data);
+    entry.score = int16_t(uint16_t((data >> 25) & 0xffff));
+    return entry;
+}
+
+} // namespace engine
@@ -0,0 +1,81 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "types.hxx"
+
+namespace engine {
+enum class Bound : uint8_t
+{
+    NONE,
+    UPPER,
+    LOWER,
+    EXACT,
+};
+
+struct TTEntry
+{
+    db::Square from{db::SQUARE_NONE};
+    db::Square to{db::SQUARE_NONE};
+    db::PieceType promoted{db::PIECE_TYPE_NONE};
+    int score{0};
+    int depth{0};
+    Bound bound{Bound::NONE};
+};
+
+// Transposition table shared by any number of searching threads without locks. Every slot holds the packed entry
+// and the zobrist key xored with it; a slot that was torn by a concurrent write no longer validates against the key
+// and reads as a miss. Slots are grouped in clusters of one cache line, a key may live in any slot of its cluster.
+// Entries are aged by a generation counter that the owner advances once per search (or per batch of searches), so
+// that results of earlier searches give way first.
+class TranspositionTable
+{
+public:
+    static constexpr size_t CLUSTER_SIZE = 4;
+
+    // size_mb is rounded down to whole clusters, huge_pages asks the kernel for transparent huge pages where it can
+    explicit TranspositionTable(size_t size_mb = 16, bool huge_pages = false);
+    ~TranspositionTable();
+    TranspositionTable(const TranspositionTable &) = delete;
+    TranspositionTable &operator=(const TranspositionTable &) = delete;
+
+    bool probe(uint64_t key, TTEntry &entry) const;
+    void store(uint64_t key, const TTEntry &entry);
+    void new_search() { m_generation.fetch_add(1, std::memory_order_relaxed); }
+    void clear();
+    // permille of sampled slots written during the current generation
+    [[nodiscard]] int hashfull() const;
+    [[nodiscard]] size_t size() const { return m_cluster_count * CLUSTER_SIZE; }
+    [[nodiscard]] bool uses_huge_pages() const { return m_huge_pages; }
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> check; // key ^ data
+        std::atomic<uint64_t> data;
+    };
+    struct alignas(64) Cluster
+    {
+        Slot slots[CLUSTER_SIZE];
+    };
+    static_assert(sizeof(Cluster) == 64);
+
+    Cluster &cluster(uint64_t key) const
+    {
+        // the upper half of the key scaled to the cluster count, the table does not need a power of two size
+        return m_clusters[(uint64_t(uint32_t(key >> 32)) * m_cluster_count) >> 32];
+    }
+    static uint64_t pack(const TTEntry &entry, uint8_t generation);
+    static TTEntry unpack(uint64_t data);
+    static uint8_t generation_of(uint64_t data) { return uint8_t(data >> GENERATION_SHIFT); }
+    static int depth_of(uint64_t data) { return int((data >> 17) & 0xff); }
+
+    static constexpr int GENERATION_SHIFT = 41;
+
+    Cluster *m_clusters;
+    size_t m_cluster_count;
+    bool m_huge_pages;
+    std::atomic<uint8_t> m_generation;
+};
+} // namespace engine
@@ -0,0 +1,426 @@
+#include "tuner.hxx"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+namespace engine {
+
+namespace {
+// samples a thread takes at a time and evaluates before it computes any sigmoid
+constexpr size_t BLOCK_SIZE = 256;
+constexpr size_t CHUNK_SIZE = 64 * BLOCK_SIZE;
+constexpr double ADAM_BETA1 = 0.9;
+constexpr double ADAM_BETA2 = 0.999;
+constexpr double ADAM_EPSILON = 1e-8;
+constexpr db::Bitboard FILE_A_BB = 0x0101010101010101ULL;
+constexpr db::Bitboard FILE_H_BB = FILE_A_BB << 7;
+const char *const piece_names[db::PIECE_TYPES] = {"pawn", "knight", "bishop", "rook", "queen", "king"};
+
+constexpr std::array<db::Bitboard, 64> generate_knight_attacks()
+{
+    std::array<db::Bitboard, 64> attacks{};
+    constexpr int steps[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+    for (int square = 0; square < 64; ++square) {
+        for (const auto &[file_step, rank_step] : steps) {
+            const int file = square % 8 + file_step;
+            const int rank = square / 8 + rank_step;
+            if (file >= 0 && file < 8 && rank >= 0 && rank < 8)
+                attacks[square] |= db::Bitboard(1) << (8 * rank + file);
+        }
+    }
+    return attacks;
+}
+
+constexpr std::array<db::Bitboard, 64> knight_attacks = generate_knight_attacks();
+
+db::Bitboard pawn_attacks(db::Bitboard pawns, db::Color color)
+{
+    return color == db::WHITE ? ((pawns & ~FILE_A_BB) << 7) | ((pawns & ~FILE_H_BB) << 9)
+                              : ((pawns & ~FILE_A_BB) >> 9) | ((pawns & ~FILE_H_BB) >> 7);
+}
+
+// squares a piece of type on square reaches, through the same Pext lookups as the move generator
+db::Bitboard piece_attacks(db::PieceType type, db::Square square, db::Bitboard occupancy)
+{
+    switch (type) {
+    case db::KNIGHT:
+        return knight_attacks[square];
+    case db::BISHOP:
+        return Chess_Lookup::Lookup_Pext::Bishop(square, occupancy);
+    case db::ROOK:
+        return Chess_Lookup::Lookup_Pext::Rook(square, occupancy);
+    case db::QUEEN:
+        return Chess_Lookup::Lookup_Pext::Queen(square, occupancy);
+    default:
+        return 0;
+    }
+}
+
+// e^x to about 4e-6 relative error, for the sigmoids of the error loop. std::exp is a library call that keeps the
+// loop scalar, this is arithmetic only so the loop over a block vectorizes. The exponent is clamped to the range of
+// normal floats, far beyond any evaluation the sigmoid tells apart.
+inline float exp_approx(float x)
+{
+    // e^x = 2^n * 2^f with n the nearest integer to x * log2(e) and f in [-0.5, 0.5]
+    float y = x * 1.44269504f;
+    y = y < -126.0f ? -126.0f : y;
+    y = y > 126.0f ? 126.0f : y;
+    // adding 1.5 * 2^23 rounds y to an integer that lands in the low mantissa bits. A float to int conversion would
+    // do as well but may trap, which keeps the compiler from vectorizing the clamp before it.
+    const float rounded = y + 12582912.0f;
+    const int n = std::bit_cast<int>(rounded) - 0x4b400000;
+    const float f = y - (rounded - 12582912.0f);
+    // Taylor series of 2^f to the sixth power
+    float p = 1.540353e-4f;
+    p = p * f + 1.3333558e-3f;
+    p = p * f + 9.6181291e-3f;
+    p = p * f + 5.5504109e-2f;
+    p = p * f + 2.4022651e-1f;
+    p = p * f + 6.9314718e-1f;
+    p = p * f + 1.0f;
+    return p * std::bit_cast<float>((n + 127) << 23);
+}
+
+float sigmoid(float x)
+{
+    return 1 / (1 + exp_approx(-x));
+}
+
+// features of one position summed densely and emitted in the order they were first touched
+class FeatureBuilder
+{
+public:
+    void add(size_t parameter, int coefficient)
+    {
+        if (m_dense[parameter] == 0 && std::find(m_touched.begin(), m_touched.end(), parameter) == m_touched.end())
+            m_touched.push_back(uint16_t(parameter));
+        m_dense[parameter] = int16_t(m_dense[parameter] + coefficient);
+    }
+
+    void flush(std::vector<uint16_t> &indices, std::vector<int16_t> &coefficients)
+    {
+        for (uint16_t parameter : m_touched) {
+            if (m_dense[parameter] != 0) {
+                indices.push_back(parameter);
+                coefficients.push_back(m_dense[parameter]);
+            }
+            m_dense[parameter] = 0;
+        }
+        m_touched.clear();
+    }
+
+private:
+    int16_t m_dense[Tuner::PARAMETERS]{};
+    std::vector<uint16_t> m_touched;
+};
+} // namespace
+
+struct Tuner::Gradient
+{
+    std::vector<double> values = std::vector<double>(2 * PARAMETERS);
+    double error{0.0};
+};
+
+Tuner::Tuner(const Settings &settings)
+    : m_settings(settings)
+    , m_scaling(std::log(10.0) / 400)
+    , m_weights(2 * PARAMETERS)
+    , m_moment1(2 * PARAMETERS)
+    , m_moment2(2 * PARAMETERS)
+    , m_steps(0)
+{
+    m_settings.threads = std::max<size_t>(1, m_settings.threads);
+    // the evaluation's own values to start from, mobility has none
+    for (int type = 0; type < db::PIECE_TYPES; ++type) {
+        for (int square = 0; square < 64; ++square) {
+            const db::psqt::Score score = db::psqt::score(db::Piece(type), db::Square(square));
+            m_weights[2 * (64 * type + square)] = score.mg;
+            m_weights[2 * (64 * type + square) + 1] = score.eg;
+        }
+    }
+}
+
+size_t Tuner::add(const std::vector<TrainingRecord> &records)
+{
+    struct Part
+    {
+        std::vector<Sample> samples;
+        std::vector<uint16_t> indices;
+        std::vector<int16_t> coefficients;
+    };
+    const size_t threads = std::min(m_settings.threads, std::max<size_t>(1, records.size() / CHUNK_SIZE));
+    std::vector<Part> parts(threads);
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            Part &part = parts[t];
+            FeatureBuilder features;
+            db::Position position;
+            for (size_t i = records.size() * t / threads; i < records.size() * (t + 1) / threads; ++i) {
+                const TrainingRecord &record = records[i];
+                if (!record.position.unpack(position))
+                    continue;
+                const db::Bitboard occupancy = position.by_color[db::WHITE] | position.by_color[db::BLACK];
+                for (db::Bitboard b = occupancy; b; b &= b - 1) {
+                    const auto square = db::Square(std::countr_zero(b));
+                    const db::Piece piece = position.board[square];
+                    const bool white = db::color_of(piece) == db::WHITE;
+                    features.add(64 * db::type_of(piece) + (white ? square : square ^ 56), white ? 1 : -1);
+                }
+                if (m_settings.mobility) {
+                    for (int color = db::WHITE; color <= db::BLACK; ++color) {
+                        const auto us = db::Color(color);
+                        const db::Color them = db::opposite(us);
+                        // squares not held by our pieces nor attacked by their pawns
+                        const db::Bitboard safe = ~position.by_color[us] &
+                                                  ~pawn_attacks(position.by_type[db::PAWN] & position.by_color[them],
+                                                                them);
+                        for (int type = db::KNIGHT; type <= db::QUEEN; ++type) {
+                            int mobility = 0;
+                            for (db::Bitboard b = position.by_type[type] & position.by_color[us]; b; b &= b - 1)
+                                mobility += std::popcount(
+                                    piece_attacks(db::PieceType(type), db::Square(std::countr_zero(b)), occupancy) &
+                                    safe);
+                            if (mobility)
+                                features.add(PSQT_PARAMETERS + type - db::KNIGHT, us == db::WHITE ? mobility
+                                                                                                  : -mobility);
+                        }
+                    }
+                }
+                Sample sample;
+                sample.begin = part.indices.size();
+                features.flush(part.indices, part.coefficients);
+                const bool white = position.stm == db::WHITE;
+                sample.phase = float(std::min(position.phase, db::psqt::PHASE_MAX)) / db::psqt::PHASE_MAX;
+                sample.result = (white ? record.result : -record.result) * 0.5f + 0.5f;
+                sample.score = white ? record.score : -record.score;
+                part.samples.push_back(sample);
+            }
+        });
+    }
+    for (auto &worker : workers)
+        worker.join();
+
+    size_t added = 0;
+    for (Part &part : parts) {
+        const uint64_t offset = m_indices.size();
+        for (Sample &sample : part.samples)
+            sample.begin += offset;
+        m_samples.insert(m_samples.end(), part.samples.begin(), part.samples.end());
+        m_indices.insert(m_indices.end(), part.indices.begin(), part.indices.end());
+        m_coefficients.insert(m_coefficients.end(), part.coefficients.begin(), part.coefficients.end());
+        added += part.samples.size();
+    }
+    return added;
+}
+
+template <typename Work>
+void Tuner::parallel_for(const Work &work) const
+{
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < m_settings.threads; ++t) {
+        threads.emplace_back([&, t] {
+            for (size_t begin; (begin = next.fetch_add(CHUNK_SIZE)) < m_samples.size();)
+                work(t, begin, std::min(begin + CHUNK_SIZE, m_samples.size()));
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+}
+
+void Tuner::accumulate(size_t begin, size_t end, Gradient &gradient) const
+{
+    const float *weights = m_weights.data();
+    const uint16_t *indices = m_indices.data();
+    const int16_t *coefficients = m_coefficients.data();
+    const float scaling = float(m_scaling);
+    const float lambda = float(m_settings.lambda);
+    const bool with_gradient = !gradient.values.empty();
+    float evaluation[BLOCK_SIZE];
+    // the sample fields the error loop reads, contiguous so that it vectorizes
+    float score[BLOCK_SIZE];
+    float result[BLOCK_SIZE];
+    float squared_error[BLOCK_SIZE];
+    float factor[BLOCK_SIZE];
+
+    for (size_t block = begin; block < end; block += BLOCK_SIZE) {
+        const size_t count = std::min(BLOCK_SIZE, end - block);
+        const Sample *samples = &m_samples[block];
+        const auto features_end = [&](size_t i) {
+            return block + i + 1 < m_samples.size() ? samples[i + 1].begin : m_indices.size();
+        };
+
+        // the feature lists differ in length and index the weights indirectly, so this gather stays scalar
+        for (size_t i = 0; i < count; ++i) {
+            float mg = 0, eg = 0;
+            for (uint64_t f = samples[i].begin, last = features_end(i); f < last; ++f) {
+                mg += coefficients[f] * weights[2 * indices[f]];
+                eg += coefficients[f] * weights[2 * indices[f] + 1];
+            }
+            evaluation[i] = mg * samples[i].phase + eg * (1 - samples[i].phase);
+            score[i] = samples[i].score;
+            result[i] = samples[i].result;
+        }
+
+        // error and the derivative of the error by the evaluation. This loop vectorizes; the sum is kept out of it
+        // because a floating point reduction only vectorizes when the compiler may reorder the additions.
+        for (size_t i = 0; i < count; ++i) {
+            const float s = sigmoid(scaling * evaluation[i]);
+            const float target = lambda * sigmoid(scaling * score[i]) + (1 - lambda) * result[i];
+            squared_error[i] = (s - target) * (s - target);
+            factor[i] = 2 * (s - target) * s * (1 - s) * scaling;
+        }
+        double error = 0;
+        for (size_t i = 0; i < count; ++i)
+            error += squared_error[i];
+        gradient.error += error;
+
+        if (!with_gradient)
+            continue;
+        double *values = gradient.values.data();
+        for (size_t i = 0; i < count; ++i) {
+            const double mg = factor[i] * samples[i].phase;
+            const double eg = factor[i] * (1 - samples[i].phase);
+            for (uint64_t f = samples[i].begin, last = features_end(i); f < last; ++f) {
+                values[2 * indices[f]] += mg * coefficients[f];
+                values[2 * indices[f] + 1] += eg * coefficients[f];
+            }
+        }
+    }
+}
+
+double Tuner::error() const
+{
+    if (m_samples.empty())
+        return 0;
+    std::vector<Gradient> parts(m_settings.threads);
+    for (Gradient &part : parts)
+        part.values.clear();
+    parallel_for([&](size_t thread, size_t begin, size_t end) { accumulate(begin, end, parts[thread]); });
+    double error = 0;
+    for (const Gradient &part : parts)
+        error += part.error;
+    return error / double(m_samples.size());
+}
+
+double Tuner::fit_scaling()
+{
+    // the error is unimodal in the scaling, golden section search between very flat and very steep sigmoids
+    const double ratio = (std::sqrt(5.0) - 1) / 2;
+    double low = 1e-4, high = 0.05;
+    const auto error_at = [this](double scaling) {
+        m_scaling = scaling;
+        return error();
+    };
+    double left = high - ratio * (high - low), right = low + ratio * (high - low);
+    double left_error = error_at(left), right_error = error_at(right);
+    while (high - low > 1e-6) {
+        if (left_error < right_error) {
+            high = right;
+            right = left;
+            right_error = left_error;
+            left = high - ratio * (high - low);
+            left_error = error_at(left);
+        } else {
+            low = left;
+            left = right;
+            left_error = right_error;
+            right = low + ratio * (high - low);
+            right_error = error_at(right);
+        }
+    }
+    m_scaling = (low + high) / 2;
+    return m_scaling;
+}
+
+double Tuner::epoch()
+{
+    if (m_samples.empty())
+        return 0;
+    std::vector<Gradient> parts(m_settings.threads);
+    parallel_for([&](size_t thread, size_t begin, size_t end) { accumulate(begin, end, parts[thread]); });
+    Gradient total;
+    for (const Gradient &part : parts) {
+        total.error += part.error;
+        for (size_t i = 0; i < total.values.size(); ++i)
+            total.values[i] += part.values[i];
+    }
+
+    ++m_steps;
+    const double correction1 = 1 - std::pow(ADAM_BETA1, double(m_steps));
+    const double correction2 = 1 - std::pow(ADAM_BETA2, double(m_steps));
+    for (size_t i = 0; i < m_weights.size(); ++i) {
+        const double gradient = total.values[i] / double(m_samples.size());
+        m_moment1[i] = ADAM_BETA1 * m_moment1[i] + (1 - ADAM_BETA1) * gradient;
+        m_moment2[i] = ADAM_BETA2 * m_moment2[i] + (1 - ADAM_BETA2) * gradient * gradient;
+        m_weights[i] -= float(m_settings.learning_rate * (m_moment1[i] / correction1) /
+                              (std::sqrt(m_moment2[i] / correction2) + ADAM_EPSILON));
+    }
+    return total.error / double(m_samples.size());
+}
+
+void Tuner::write(std::ostream &out) const
+{
+    // the tables take the value of each piece relative to its mean over the squares it can stand on, pawns never
+    // stand on the first or last rank and kings have no material value
+    int material[2][db::PIECE_TYPES] = {};
+    int tables[2][db::PIECE_TYPES][64] = {};
+    for (int phase = 0; phase < 2; ++phase) {
+        for (int type = 0; type < db::PIECE_TYPES; ++type) {
+            const int first = type == db::PAWN ? db::A2 : db::A1;
+            const int last = type == db::PAWN ? db::H7 : db::H8;
+            double sum = 0;
+            for (int square = first; square <= last; ++square)
+                sum += weight(64 * type + square, phase);
+            material[phase][type] = type == db::KING ? 0 : int(std::lround(sum / (last - first + 1)));
+            for (int square = first; square <= last; ++square)
+                tables[phase][type][square] = int(std::lround(weight(64 * type + square, phase))) -
+                                              material[phase][type];
+        }
+    }
+
+    char line[128];
+    const char *const phase_names[2] = {"mg", "eg"};
+    std::snprintf(line, sizeof(line), "// tuned on %zu positions, sigmoid scaling %.6f, error %.6f\n", m_samples.size(),
+                  m_scaling, error());
+    out << line;
+    for (int phase = 0; phase < 2; ++phase) {
+        out << "constexpr int piece_value_" << phase_names[phase] << "[PIECE_TYPES] = {";
+        for (int type = 0; type < db::PIECE_TYPES; ++type)
+            out << (type ? ", " : "") << material[phase][type];
+        out << "};\n";
+    }
+    for (int phase = 0; phase < 2; ++phase) {
+        out << "\nconstexpr int table_" << phase_names[phase] << "[PIECE_TYPES][64] =\n{\n";
+        for (int type = 0; type < db::PIECE_TYPES; ++type) {
+            out << "    { // " << piece_names[type] << "\n";
+            // rank 8 on top like the tables in psqt.hxx
+            for (int rank = 7; rank >= 0; --rank) {
+                out << "       ";
+                for (int file = 0; file < 8; ++file) {
+                    std::snprintf(line, sizeof(line), " %4d,", tables[phase][type][8 * rank + file]);
+                    out << line;
+                }
+                out << "\n";
+            }
+            out << "    },\n";
+        }
+        out << "};\n";
+    }
+    if (m_settings.mobility) {
+        out << "\n// per safe square reached by knights, bishops, rooks and queens\n";
+        for (int phase = 0; phase < 2; ++phase) {
+            out << "constexpr int mobility_" << phase_names[phase] << "[4] = {";
+            for (size_t i = 0; i < MOBILITY_PARAMETERS; ++i)
+                out << (i ? ", " : "") << std::lround(weight(PSQT_PARAMETERS + i, phase));
+            out << "};\n";
+        }
+    }
+}
+
+} // namespace engine
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "trainingdata.hxx"
+
+namespace engine {
+// Fits the material and piece square values, and optionally a mobility term per piece, to labelled positions by
+// minimizing the squared error between the sigmoid of the evaluation and the game result (Texel's method), with the
+// search score blended into the target by lambda. Every position is reduced once to the sparse list of its features
+// with white's count minus black's as coefficient, so an evaluation is a dot product over some 35 entries. Epochs
+// are full batch Adam steps, the positions are split over the threads and each one sums the gradient of its part in
+// blocks: the evaluations of a block first (a scalar gather over the features), then the sigmoid terms in one loop
+// with a polynomial exp that the compiler vectorizes, then the gradient.
+class Tuner
+{
+public:
+    // parameters of one phase: material and piece square value of each piece on each square from white's point of
+    // view, then a mobility weight per safe square reached by knights, bishops, rooks and queens
+    static constexpr size_t PSQT_PARAMETERS = db::PIECE_TYPES * 64;
+    static constexpr size_t MOBILITY_PARAMETERS = 4;
+    static constexpr size_t PARAMETERS = PSQT_PARAMETERS + MOBILITY_PARAMETERS;
+
+    struct Settings
+    {
+        bool mobility{false};
+        double lambda{0.0}; // weight of the search score in the target, 1 - lambda goes to the result
+        double learning_rate{1.0};
+        size_t threads{1};
+    };
+
+    explicit Tuner(const Settings &settings);
+
+    // positions that do not unpack are skipped, returns the number added
+    size_t add(const std::vector<TrainingRecord> &records);
+    [[nodiscard]] size_t size() const { return m_samples.size(); }
+
+    // the scaling of the sigmoid that fits the current weights best, used by every later epoch
+    double fit_scaling();
+    [[nodiscard]] double scaling() const { return m_scaling; }
+    void set_scaling(double scaling) { m_scaling = scaling; }
+    // mean squared error over all positions
+    [[nodiscard]] double error() const;
+    // one optimizer step, returns the error before it
+    double epoch();
+
+    // weight of a parameter in centipawns, mg or eg
+    [[nodiscard]] double weight(size_t parameter, bool endgame) const { return m_weights[2 * parameter + endgame]; }
+    // writes the tuned values as C++ tables in the layout of psqt.hxx, the material split off as the mean value
+    void write(std::ostream &out) const;
+
+private:
+    struct Sample
+    {
+        uint64_t begin; // first feature in m_indices and m_coefficients
+        float phase;    // middlegame share, 1 with all pieces on the board
+        float result;   // from white's point of view: 0, 0.5 or 1
+        float score;    // search score from white's point of view
+    };
+    struct Gradient;
+
+    template <typename Work>
+    void parallel_for(const Work &work) const;
+    // sums error and gradient over samples [begin, end)
+    void accumulate(size_t begin, size_t end, Gradient &gradient) const;
+
+    Settings m_settings;
+    double m_scaling;
+    std::vector<Sample> m_samples;
+    // the features of sample i are [m_samples[i].begin, m_samples[i + 1].begin), the last one ends at the end
+    std::vector<uint16_t> m_indices;
+    std::vector<int16_t> m_coefficients;
+    // mg and eg weight of each parameter next to each other, one load per feature
+    std::vector<float> m_weights;
+    std::vector<double> m_moment1;
+    std::vector<double> m_moment2;
+    uint64_t m_steps;
+};
+} // namespace engine
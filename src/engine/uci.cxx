@@ -0,0 +1,153 @@
+#include "uci.hxx"
+
+#include <charconv>
+
+namespace engine::uci {
+
+std::string_view next_token(std::string_view &line)
+{
+    size_t begin = line.find_first_not_of(" \t\r");
+    if (begin == std::string_view::npos) {
+        line = {};
+        return {};
+    }
+    size_t end = line.find_first_of(" \t\r", begin);
+    std::string_view token = line.substr(begin, end == std::string_view::npos ? line.size() - begin : end - begin);
+    line.remove_prefix(end == std::string_view::npos ? line.size() : end);
+    return token;
+}
+
+template <typename T>
+static T to_number(std::string_view token)
+{
+    T value = 0;
+    std::from_chars(token.data(), token.data() + token.size(), value);
+    return value;
+}
+
+bool parse_info(std::string_view line, Info &info)
+{
+    if (next_token(line) != "info")
+        return false;
+    info = {};
+    bool has_line = false;
+    for (std::string_view token = next_token(line); !token.empty(); token = next_token(line)) {
+        if (token == "depth") {
+            info.depth = to_number<int>(next_token(line));
+            has_line = true;
+        } else if (token == "seldepth") {
+            info.seldepth = to_number<int>(next_token(line));
+        } else if (token == "multipv") {
+            info.multipv = to_number<int>(next_token(line));
+        } else if (token == "score") {
+            std::string_view kind = next_token(line);
+            info.is_mate = kind == "mate";
+            info.score = to_number<int>(next_token(line));
+            info.has_score = true;
+        } else if (token == "lowerbound") {
+            info.lowerbound = true;
+        } else if (token == "upperbound") {
+            info.upperbound = true;
+        } else if (token == "nodes") {
+            info.nodes = to_number<uint64_t>(next_token(line));
+        } else if (token == "nps") {
+            info.nps = to_number<uint64_t>(next_token(line));
+        } else if (token == "time") {
+            info.time_ms = to_number<int64_t>(next_token(line));
+        } else if (token == "hashfull") {
+            info.hashfull = to_number<int>(next_token(line));
+        } else if (token == "pv") {
+            size_t begin = line.find_first_not_of(' ');
+            info.pv = begin == std::string_view::npos ? std::string_view() : line.substr(begin);
+            while (!info.pv.empty() && (info.pv.back() == '\r' || info.pv.back() == ' '))
+                info.pv.remove_suffix(1);
+            break;
+        } else if (token == "string") {
+            // free text up to the end of the line
+            break;
+        } else if (token == "currmove" || token == "currmovenumber" || token == "tbhits" || token == "cpuload" ||
+                   token == "refutation" || token == "currline") {
+            next_token(line);
+        }
+    }
+    return has_line && info.has_score;
+}
+
+bool parse_option(std::string_view line, Option &option)
+{
+    if (next_token(line) != "option" || next_token(line) != "name")
+        return false;
+    option = {};
+    // names may contain spaces, they run up to the type keyword
+    size_t type = line.find(" type ");
+    if (type == std::string_view::npos)
+        return false;
+    option.name = line.substr(0, type);
+    while (!option.name.empty() && option.name.front() == ' ')
+        option.name.remove_prefix(1);
+    line.remove_prefix(type + 6);
+    option.type = next_token(line);
+    for (std::string_view token = next_token(line); !token.empty(); token = next_token(line)) {
+        if (token == "default")
+            option.default_value = next_token(line);
+        else if (token == "min")
+            option.min = to_number<int64_t>(next_token(line));
+        else if (token == "max")
+            option.max = to_number<int64_t>(next_token(line));
+    }
+    return true;
+}
+
+bool parse_bestmove(std::string_view line, std::string_view &move)
+{
+    if (next_token(line) != "bestmove")
+        return false;
+    move = next_token(line);
+    return true;
+}
+
+std::string move_to_uci(const db::Move &move, bool chess960)
+{
+    std::string uci;
+    uci.push_back(char('a' + db::file_of(move.from)));
+    uci.push_back(char('1' + db::rank_of(move.from)));
+    // castling is stored as king takes rook
+    db::Square to = move.to;
+    if (move.is_castling && !chess960 && db::file_of(move.from) == db::FILE_E &&
+        (db::file_of(move.to) == db::FILE_A || db::file_of(move.to) == db::FILE_H))
+        to = move.castling_king_to();
+    uci.push_back(char('a' + db::file_of(to)));
+    uci.push_back(char('1' + db::rank_of(to)));
+    if (move.promoted != db::PIECE_NONE)
+        uci.push_back(db::fen_char_pieces[db::type_of(move.promoted) + db::PIECE_TYPES]);
+    return uci;
+}
+
+db::Move move_from_uci(db::Board &board, std::string_view uci)
+{
+    db::Move none;
+    // make_square does not range check, a file or rank outside the board would land on another square
+    const auto on_board = [](char file, char rank) { return file >= 'a' && file <= 'h' && rank >= '1' && rank <= '8'; };
+    if (uci.size() < 4 || !on_board(uci[0], uci[1]) || !on_board(uci[2], uci[3]))
+        return none;
+    db::Square from = db::make_square(db::File(uci[0] - 'a'), db::Rank(uci[1] - '1'));
+    db::Square to = db::make_square(db::File(uci[2] - 'a'), db::Rank(uci[3] - '1'));
+    const db::Square rook = board.castling_rook(from, to);
+    if (rook != db::SQUARE_NONE)
+        to = rook;
+    db::PieceType promoted = db::PIECE_TYPE_NONE;
+    if (uci.size() > 4) {
+        size_t index = db::fen_char_pieces.find(uci[4]);
+        if (index != std::string::npos)
+            promoted = db::type_of(db::Piece(index));
+    }
+    for (const auto &move : board.generate_moves()) {
+        if (move.from == from && move.to == to &&
+            (move.promoted == db::PIECE_NONE ? promoted == db::PIECE_TYPE_NONE
+                                             : db::type_of(move.promoted) == promoted))
+            return move;
+    }
+    return none;
+}
+
+} // namespace engine::uci
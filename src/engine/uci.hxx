@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "bitboard.hxx"
+
+// Parsing of the engine side of the UCI protocol. Everything works on views into the line it was given and never
+// allocates, engines emit thousands of info lines per second.
+namespace engine::uci {
+
+struct Info
+{
+    int depth{0};
+    int seldepth{0};
+    int multipv{1};
+    int score{0};
+    bool is_mate{false};
+    bool lowerbound{false};
+    bool upperbound{false};
+    bool has_score{false};
+    uint64_t nodes{0};
+    uint64_t nps{0};
+    int64_t time_ms{0};
+    int hashfull{0};
+    std::string_view pv; // moves in coordinate notation separated by spaces, points into the parsed line
+};
+
+struct Option
+{
+    std::string_view name;
+    std::string_view type;
+    std::string_view default_value;
+    int64_t min{0};
+    int64_t max{0};
+};
+
+// returns the next space separated token and advances line past it
+std::string_view next_token(std::string_view &line);
+// "info ..." lines, returns false for anything else and for info lines that only carry a string or currmove
+bool parse_info(std::string_view line, Info &info);
+// "option name ... type ..." lines
+bool parse_option(std::string_view line, Option &option);
+// "bestmove <move> [ponder <move>]" lines, move is set to the best move
+bool parse_bestmove(std::string_view line, std::string_view &move);
+
+// castling as the king's destination square when king and rooks start from their standard squares, as king takes
+// rook otherwise and for engines in UCI_Chess960 mode
+std::string move_to_uci(const db::Move &move, bool chess960 = false);
+// finds the legal move of the board's position that matches a coordinate notation move, is_legal is false if none.
+// Castling may be given either way.
+db::Move move_from_uci(db::Board &board, std::string_view uci);
+} // namespace engine::uci
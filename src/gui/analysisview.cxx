@@ -0,0 +1,139 @@
+#include "analysisview.hxx"
+
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QPushButton>
+#include <QVBoxLayout>
+#include <bit>
+
+AnalysisView::AnalysisView(QWidget *parent)
+    : QWidget{parent}
+    , m_worker(new AnalysisWorker)
+    , m_generation(0)
+    , m_valid(false)
+    , m_running(false)
+{
+    m_toggle = new QPushButton(QStringLiteral("Analyse"), this);
+    m_toggle->setCheckable(true);
+    m_score = new QLabel(this);
+    m_details = new QLabel(this);
+    m_pv = new QLabel(this);
+    m_pv->setWordWrap(true);
+    m_pv->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    m_tablebase = new QLabel(this);
+    m_tablebase->hide();
+    QFont score_font = m_score->font();
+    score_font.setBold(true);
+    m_score->setFont(score_font);
+
+    auto *header = new QHBoxLayout();
+    header->addWidget(m_toggle);
+    header->addWidget(m_score);
+    header->addStretch();
+    header->addWidget(m_details);
+    auto *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addLayout(header);
+    layout->addWidget(m_pv);
+    layout->addWidget(m_tablebase);
+
+    m_worker->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    connect(this, &AnalysisView::analyse_requested, m_worker, &AnalysisWorker::analyse);
+    connect(m_worker, &AnalysisWorker::info, this, &AnalysisView::show_info);
+    connect(m_toggle, &QPushButton::toggled, this, &AnalysisView::set_running);
+    m_thread.start(QThread::LowPriority);
+}
+
+AnalysisView::~AnalysisView()
+{
+    m_worker->cancel(++m_generation);
+    m_thread.quit();
+    m_thread.wait();
+}
+
+void AnalysisView::set_fen(const QString &fen)
+{
+    if (fen == m_fen)
+        return;
+    m_fen = fen;
+    db::Board board;
+    m_valid = board.set_fen(fen.toStdString());
+    m_position = db::PackedPosition::pack(board.get_position());
+    show_tablebase();
+    if (m_running)
+        request_analysis();
+}
+
+void AnalysisView::set_tablebase_directory(const QString &directory)
+{
+    auto tablebases = std::make_unique<engine::tb::Tablebases>();
+    tablebases->add_directory(directory.toStdString());
+    m_tablebases = std::move(tablebases);
+    show_tablebase();
+}
+
+void AnalysisView::set_running(bool running)
+{
+    if (running == m_running)
+        return;
+    m_running = running;
+    m_toggle->setChecked(running);
+    if (running) {
+        request_analysis();
+    } else {
+        m_worker->cancel(++m_generation);
+        m_score->clear();
+        m_details->clear();
+        m_pv->clear();
+    }
+}
+
+void AnalysisView::request_analysis()
+{
+    m_worker->cancel(++m_generation);
+    m_score->setText(QStringLiteral("..."));
+    m_details->clear();
+    m_pv->clear();
+    if (m_valid)
+        emit analyse_requested(m_position, m_generation);
+}
+
+void AnalysisView::show_info(const AnalysisInfo &info)
+{
+    // queued infos of a cancelled search can still arrive after the position changed
+    if (info.generation != m_generation)
+        return;
+    if (info.is_mate)
+        m_score->setText(info.score > 0 ? QStringLiteral("#%1").arg(info.score)
+                                        : QStringLiteral("#-%1").arg(-info.score));
+    else
+        m_score->setText(QStringLiteral("%1%2").arg(info.score >= 0 ? "+" : "").arg(info.score / 100.0, 0, 'f', 2));
+    m_details->setText(QStringLiteral("depth %1  %2 kN/s")
+                           .arg(info.depth)
+                           .arg(info.time_ms > 0 ? info.nodes / info.time_ms : info.nodes));
+    m_pv->setText(info.pv);
+}
+
+void AnalysisView::show_tablebase()
+{
+    m_tablebase->hide();
+    db::Position position;
+    if (!m_tablebases || m_tablebases->size() == 0 || !m_valid || !m_position.unpack(position))
+        return;
+    if (std::popcount(position.by_color[db::WHITE] | position.by_color[db::BLACK]) > engine::tb::MAX_PIECES)
+        return;
+    // a lookup is a few page reads of a mapped file, cheap enough for the GUI thread
+    const std::optional<engine::tb::ProbeResult> result = m_tablebases->probe(position);
+    if (!result)
+        m_tablebase->setText(QStringLiteral("Tablebase: no table for this position"));
+    else if (result->wdl == engine::tb::Wdl::DRAW)
+        m_tablebase->setText(QStringLiteral("Tablebase: draw"));
+    else
+        m_tablebase->setText(QStringLiteral("Tablebase: %1 wins, DTZ %2")
+                                 .arg((result->wdl == engine::tb::Wdl::WIN) == (position.stm == db::WHITE)
+                                          ? QStringLiteral("white")
+                                          : QStringLiteral("black"))
+                                 .arg(result->dtz));
+    m_tablebase->show();
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <QThread>
+#include <QWidget>
+#include <memory>
+
+#include "analysisworker.hxx"
+#include "tablebase.hxx"
+
+class QLabel;
+class QPushButton;
+
+// Pane showing the live evaluation of the board position. The search runs in an AnalysisWorker on m_thread. Endgame
+// positions covered by the tablebases show their exact result as well, whether or not the analysis runs.
+class AnalysisView : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit AnalysisView(QWidget *parent = nullptr);
+    ~AnalysisView() override;
+
+    // cheap to call on every position change, the running search is cancelled and never waited for
+    void set_fen(const QString &fen);
+    void set_running(bool running);
+    // replaces the tables in use by those found in directory
+    void set_tablebase_directory(const QString &directory);
+
+signals:
+    void analyse_requested(const db::PackedPosition &position, quint64 generation);
+
+private:
+    void request_analysis();
+    void show_info(const AnalysisInfo &info);
+    void show_tablebase();
+
+    QThread m_thread;
+    AnalysisWorker *m_worker;
+    quint64 m_generation;
+    QString m_fen;
+    // m_fen parsed once, false for FENs that do not parse
+    db::PackedPosition m_position;
+    bool m_valid;
+    bool m_running;
+
+    QPushButton *m_toggle;
+    QLabel *m_score;
+    QLabel *m_details;
+    QLabel *m_pv;
+    QLabel *m_tablebase;
+    std::unique_ptr<engine::tb::Tablebases> m_tablebases;
+};
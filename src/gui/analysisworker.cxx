@@ -0,0 +1,72 @@
+#include "analysisworker.hxx"
+
+#include <algorithm>
+#include <thread>
+
+#include "game.hxx"
+
+AnalysisWorker::AnalysisWorker(QObject *parent)
+    : QObject{parent}
+    , m_stop(false)
+    , m_latest_generation(0)
+    , m_search(std::max(1u, std::thread::hardware_concurrency()), 64)
+{}
+
+void AnalysisWorker::analyse(const db::PackedPosition &position, quint64 generation)
+{
+    // the flag is cleared before the staleness check so that a cancel racing with it is never lost
+    m_stop = false;
+    if (generation != m_latest_generation)
+        return;
+    db::Position unpacked;
+    if (!position.unpack(unpacked))
+        return;
+    m_board.update_attacks(unpacked);
+    m_board.set_position(unpacked);
+    m_search.set_position(m_board.get_position());
+
+    QElapsedTimer since_report;
+    since_report.start();
+    AnalysisInfo pending;
+    bool has_pending = false;
+    m_search.go({0, 0, 0}, m_stop, [&](const engine::SearchInfo &search_info) {
+        pending = make_info(search_info, generation);
+        has_pending = true;
+        if (since_report.elapsed() < s_report_interval_ms)
+            return;
+        emit info(pending);
+        has_pending = false;
+        since_report.restart();
+    });
+    // the deepest iteration may have been held back by the throttle
+    if (has_pending && generation == m_latest_generation)
+        emit info(pending);
+}
+
+AnalysisInfo AnalysisWorker::make_info(const engine::SearchInfo &search_info, quint64 generation)
+{
+    AnalysisInfo info;
+    info.generation = generation;
+    info.depth = search_info.depth;
+    info.is_mate = search_info.is_mate;
+    info.score = m_board.get_stm() == db::WHITE ? search_info.score : -search_info.score;
+    info.nodes = search_info.nodes;
+    info.time_ms = search_info.time_ms;
+
+    // m_board still holds the analysed position, it is walked along the line to get SAN and restored afterwards
+    std::string pv;
+    bool first = true;
+    for (db::Move move : search_info.pv) {
+        m_board.prepare_for_print(move);
+        if (!first)
+            pv += ' ';
+        pv += db::Game::move_number_text(move, first);
+        pv += move.to_san();
+        m_board.do_move(move);
+        first = false;
+    }
+    for (auto move = search_info.pv.rbegin(); move != search_info.pv.rend(); ++move)
+        m_board.undo_move(*move);
+    info.pv = QString::fromStdString(pv);
+    return info;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <QElapsedTimer>
+#include <QMetaType>
+#include <QObject>
+#include <QString>
+#include <atomic>
+
+#include "packedposition.hxx"
+#include "smpsearch.hxx"
+
+struct AnalysisInfo
+{
+    quint64 generation{0}; // request the info belongs to, the GUI drops anything older than its latest request
+    int depth{0};
+    int score{0}; // from white's point of view
+    bool is_mate{false};
+    quint64 nodes{0};
+    qint64 time_ms{0};
+    QString pv;
+};
+Q_DECLARE_METATYPE(AnalysisInfo)
+Q_DECLARE_METATYPE(db::PackedPosition)
+
+// Runs the search on a thread of its own, helper threads on the remaining cores join it. The GUI never waits on it: a
+// new request raises the stop flag of the running search from the GUI thread and is then delivered through a queued
+// call, requests that have already been superseded by the time the worker gets to them are skipped. Results travel
+// back as queued signals, at most one every s_report_interval_ms while a search is running.
+class AnalysisWorker : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr qint64 s_report_interval_ms = 100;
+
+    explicit AnalysisWorker(QObject *parent = nullptr);
+
+    // thread safe, aborts the running search and makes every request older than generation stale
+    void cancel(quint64 generation)
+    {
+        m_latest_generation = generation;
+        m_stop = true;
+    }
+
+public slots:
+    void analyse(const db::PackedPosition &position, quint64 generation);
+
+signals:
+    void info(const AnalysisInfo &info);
+
+private:
+    AnalysisInfo make_info(const engine::SearchInfo &search_info, quint64 generation);
+
+    std::atomic<bool> m_stop;
+    std::atomic<quint64> m_latest_generation;
+
+    db::Board m_board;
+    engine::SmpSearch m_search;
+};
@@ -3,9 +3,13 @@
 #include <QPainter>
 #include <QPainterPath>
 #include <algorithm>
+#include <bit>
 #include <iostream>
+#include <optional>
 #include <random>
 
+#include "frameprofiler.hxx"
+#include "positiondiff.hxx"
 #include "types.hxx"
 
 BoardView::BoardView(QWidget *parent)
@@ -34,7 +38,6 @@ BoardView::BoardView(QWidget *parent)
     , m_shape_blue(QColor(0, 48, 136, 255))
     , m_shape_yellow(QColor(230, 143, 0, 255))
     , m_modifiers(Qt::NoModifier)
-    , m_fast_last_move(false)
 {
     m_pieces_svg[db::WHITE_PAWN].load(QStringLiteral(":/images/pieces/wP.svg"));
     m_pieces_svg[db::WHITE_KNIGHT].load(QStringLiteral(":/images/pieces/wN.svg"));
@@ -53,6 +56,20 @@ BoardView::BoardView(QWidget *parent)
 
     setMouseTracking(true);
 
+    // the animations are created once and restarted, allocating one per move leaked until the widget was destroyed
+    m_piece_move_animation = new QPropertyAnimation(this, "piece_move_animation", this);
+    m_piece_move_animation->setStartValue(0.0);
+    m_piece_move_animation->setEndValue(1.0);
+    m_piece_move_animation->setEasingCurve(QEasingCurve::InOutCubic);
+    m_piece_enlarge_animation = new QPropertyAnimation(this, "piece_enlarge_animation", this);
+    m_piece_enlarge_animation->setStartValue(0);
+    m_piece_enlarge_animation->setEndValue(1);
+    m_piece_enlarge_animation->setDuration(200);
+    m_piece_dwindle_animation = new QPropertyAnimation(this, "piece_dwindle_animation", this);
+    m_piece_dwindle_animation->setStartValue(1);
+    m_piece_dwindle_animation->setEndValue(0);
+    m_piece_dwindle_animation->setDuration(200);
+
     connect(this, &BoardView::move_made, this, [&](const db::Move &move) { m_last_move = move; });
 
     // for (db::Square square = db::A1; square <= db::H8; ++square) {
@@ -72,21 +89,47 @@ static std::random_device s_random_device;
 static std::mt19937_64 s_engine(s_random_device());
 void BoardView::paintEvent(QPaintEvent *event)
 {
+    FrameProfiler &profiler = FrameProfiler::instance();
+    profiler.begin_frame();
     if (!m_is_animating) {
         recalculate_figurines();
         process_animation_queue();
     }
-    draw_board(event);
-    draw_effects(event);
-    draw_coordinates(event);
-    draw_pieces(event);
-    draw_shapes(event);
-    if (m_is_promoting)
+    {
+        FrameProfiler::Scope scope(FrameProfiler::DRAW_BOARD);
+        draw_board(event);
+    }
+    {
+        FrameProfiler::Scope scope(FrameProfiler::DRAW_EFFECTS);
+        draw_effects(event);
+    }
+    {
+        FrameProfiler::Scope scope(FrameProfiler::DRAW_COORDINATES);
+        draw_coordinates(event);
+    }
+    {
+        FrameProfiler::Scope scope(FrameProfiler::DRAW_PIECES);
+        draw_pieces(event);
+    }
+    {
+        FrameProfiler::Scope scope(FrameProfiler::DRAW_SHAPES);
+        draw_shapes(event);
+    }
+    if (m_is_promoting) {
+        FrameProfiler::Scope scope(FrameProfiler::DRAW_PROMOTION);
         draw_promotion(event);
+    }
 
     QPainter painter(this);
     if (m_is_dragging && m_board.get_piece_at(m_selected_square) != db::PIECE_NONE)
         painter.drawPixmap(m_cursor_pos, m_pieces_pixmap[m_board.get_piece_at(m_selected_square)]);
+
+    // the counters run from one recorded frame to the next so that calls made by event handlers between two paints
+    // are attributed to the following frame
+    const db::Board::CallCounters counters = m_board.get_call_counters();
+    m_board.reset_call_counters();
+    profiler.end_frame(counters.is_piece_attack, counters.generate_moves);
+    profiler.draw_hud(painter, QPointF(4, 4));
 }
 
 void BoardView::repaint_pieces()
@@ -257,7 +300,7 @@ void BoardView::draw_pieces(QPaintEvent *event)
     QPainter painter(this);
     for (auto f : m_figurines) {
         QPointF pos = point_at(f.pos);
-        if (!f.dragged && !f.animating && !f.fade && !f.ghost)
+        if (!f.dragged && !f.animating && !f.fade && !f.ghost && !f.appear)
             painter.drawPixmap(pos, m_pieces_pixmap[f.piece]);
         else if (f.ghost) {
             painter.setOpacity(0.3);
@@ -274,6 +317,10 @@ void BoardView::draw_pieces(QPaintEvent *event)
             painter.setOpacity(1 - m_piece_move_animation_val);
             painter.drawPixmap(pos, m_pieces_pixmap[f.piece]);
             painter.setOpacity(1.0);
+        } else if (f.appear) {
+            painter.setOpacity(m_piece_move_animation_val);
+            painter.drawPixmap(pos, m_pieces_pixmap[f.piece]);
+            painter.setOpacity(1.0);
         }
     }
     if (m_piece_move_animation_val == 1.0) {
@@ -532,10 +579,7 @@ void BoardView::mousePressEvent(QMouseEvent *event)
                     m_is_promoting = true;
                     m_promotion_square = square;
                     m_promotion_chooser_cur_hovered_square = square_at(event->pos());
-                    m_piece_enlarge_animation = new QPropertyAnimation(this, "piece_enlarge_animation", this);
-                    m_piece_enlarge_animation->setStartValue(0);
-                    m_piece_enlarge_animation->setEndValue(1);
-                    m_piece_enlarge_animation->setDuration(200);
+                    m_piece_enlarge_animation->stop();
                     m_piece_enlarge_animation->start();
                     return;
                 }
@@ -665,17 +709,11 @@ void BoardView::mouseMoveEvent(QMouseEvent *event)
         if (square_at(event->position()) != m_promotion_chooser_cur_hovered_square) {
             m_promotion_chooser_last_hovered_square = m_promotion_chooser_cur_hovered_square;
             m_promotion_chooser_cur_hovered_square = square_at(event->position());
-            m_piece_enlarge_animation = new QPropertyAnimation(this, "piece_enlarge_animation", this);
-            m_piece_enlarge_animation->setStartValue(0);
-            m_piece_enlarge_animation->setEndValue(1);
-            m_piece_enlarge_animation->setDuration(200);
+            m_piece_enlarge_animation->stop();
             m_piece_enlarge_animation->start();
             if (m_promotion_chooser_cur_hovered_square != m_promotion_chooser_last_hovered_square &&
                 m_promotion_chooser_last_hovered_square != db::SQUARE_NONE) {
-                m_piece_dwindle_animation = new QPropertyAnimation(this, "piece_dwindle_animation", this);
-                m_piece_dwindle_animation->setStartValue(1);
-                m_piece_dwindle_animation->setEndValue(0);
-                m_piece_dwindle_animation->setDuration(200);
+                m_piece_dwindle_animation->stop();
                 m_piece_dwindle_animation->start();
             }
         }
@@ -698,10 +736,7 @@ void BoardView::mouseReleaseEvent(QMouseEvent *event)
                 m_promotion_square = square;
                 m_is_dragging = false;
                 m_promotion_chooser_cur_hovered_square = square_at(event->pos());
-                m_piece_enlarge_animation = new QPropertyAnimation(this, "piece_enlarge_animation", this);
-                m_piece_enlarge_animation->setStartValue(0);
-                m_piece_enlarge_animation->setEndValue(1);
-                m_piece_enlarge_animation->setDuration(200);
+                m_piece_enlarge_animation->stop();
                 m_piece_enlarge_animation->start();
                 update();
                 return;
@@ -781,7 +816,9 @@ void BoardView::keyPressEvent(QKeyEvent *event)
         bool legal = false;
         std::vector<db::Move> moves = m_board.generate_moves(m_board.get_position());
         db::Move move;
-        if (moves.size() != 0) {
+        if (std::optional<db::Move> book_move = m_book.pick(m_board, m_board.get_position(), s_engine)) {
+            move = *book_move;
+        } else if (moves.size() != 0) {
             std::uniform_int_distribution<uint> dist(0, moves.size() - 1);
             move = moves.at(dist(s_engine));
         } else
@@ -829,6 +866,35 @@ void BoardView::back_move(const db::MoveId id, const db::Move &move)
     queue_move_animation(id, move, true);
 }
 
+void BoardView::set_position(const db::Position &position, const db::Move &last_move)
+{
+    stop_piece_move_animation();
+    m_move_animation_queue.clear();
+
+    m_is_promoting = false;
+    m_promotion_square = db::SQUARE_NONE;
+    m_selected_square = db::SQUARE_NONE;
+    m_is_dragging = false;
+    m_arrows.clear();
+    m_circles.clear();
+
+    m_board.set_position(position);
+    m_last_move = last_move;
+    emit fen_changed(m_board.get_fen());
+    update();
+}
+
+QString BoardView::draw_reason()
+{
+    if (m_board.is_repetition(2))
+        return QStringLiteral("threefold repetition");
+    if (m_board.is_fifty_move_draw())
+        return QStringLiteral("the 50 move rule");
+    if (m_board.is_insufficient_material())
+        return QStringLiteral("insufficient material");
+    return QString();
+}
+
 db::Move BoardView::make_move(db::Square from, db::Square to, db::Piece promotion)
 {
     db::Move move;
@@ -843,68 +909,50 @@ db::Move BoardView::make_move(db::Square from, db::Square to, db::Piece promotio
     move.is_legal = false;
     move.prev_ep = m_board.get_ep_square();
     move.castling_rights = m_board.get_castling_rights();
-
-    if (move.piece_moved == db::WHITE_KING && move.from == db::E1 &&
-            (move.to == db::A1 || move.to == db::C1 || move.to == db::H1 || move.to == db::G1) ||
-        move.piece_moved == db::BLACK_KING && move.from == db::E8 &&
-            (move.to == db::A8 || move.to == db::C8 || move.to == db::H8 || move.to == db::G8))
+    // a king dragged onto its destination or its own rook castles, the move is put in the board's form
+    const db::Square rook = m_board.castling_rook(from, to);
+    if (rook != db::SQUARE_NONE) {
+        move.to = rook;
+        move.captured = db::PIECE_NONE;
         move.is_castling = true;
+    }
     return move;
 }
 
-void BoardView::start_animation(const db::Position &start, const db::Position &target)
+void BoardView::start_animation(const db::Position &start, const db::Position &target, int duration)
 {
-    if (m_is_animating)
-        return;
-    std::vector<Figurine> target_figurines;
-    target_figurines.reserve(12);
-    for (db::Square sq = db::A1; sq <= db::H8; ++sq) {
-        db::Piece piece = m_board.get_piece_at(sq, target);
-        if (piece != db::PIECE_NONE) {
-            Figurine fg = {piece, sq, db::SQUARE_NONE, false, m_is_dragging && m_selected_square == sq, false, false};
-            target_figurines.push_back(fg);
-        }
-    }
-    for (auto &m_figurine : m_figurines) {
-        for (auto i_targets = target_figurines.begin(); i_targets != target_figurines.end();) {
-            db::Square from = m_figurine.pos;
-            db::Square to = i_targets->pos;
-
-            if (m_figurine.piece == i_targets->piece &&
-                m_board.get_piece_at(from, start) != m_board.get_piece_at(to, start) &&
-                m_board.get_piece_at(from, start) != m_board.get_piece_at(from, target)) {
-                m_figurine.target = i_targets->pos;
-                m_figurine.animating = true;
-                i_targets = target_figurines.erase(i_targets);
-                break;
-            } else {
-                ++i_targets;
-            }
-        }
-    }
-    for (auto &m_figurine : m_figurines) {
-        db::Square sq = m_figurine.pos;
-        if (!m_figurine.animating && m_board.get_piece_at(sq, start) != m_board.get_piece_at(sq, target)) {
-            m_figurine.fade = true;
-        }
-    }
-    for (auto &target_figurine : target_figurines) {
-        m_figurines.push_back(target_figurine);
+    // whatever is in flight ends where the new animation begins
+    stop_piece_move_animation();
+    const db::PositionDiff diff = db::diff_positions(start, target);
+    m_figurines.clear();
+    for (db::Bitboard b = diff.unchanged; b; b &= b - 1) {
+        db::Square sq = db::Square(std::countr_zero(b));
+        m_figurines.push_back({start.board[sq], sq, db::SQUARE_NONE, false, m_is_dragging && m_selected_square == sq,
+                               false, false});
     }
-
-    m_is_animating = true;
-    m_piece_move_animation = new QPropertyAnimation(this, "piece_move_animation", this);
-    m_piece_move_animation->setStartValue(0.0);
-    m_piece_move_animation->setEndValue(1.0);
-    m_piece_move_animation->setDuration(600.0);
-    m_piece_move_animation->setEasingCurve(QEasingCurve::InOutCubic);
-    m_piece_move_animation->start();
+    for (const auto &motion : diff.moved)
+        m_figurines.push_back({motion.piece, motion.from, motion.to, false, false, true, false});
+    for (const auto &motion : diff.removed)
+        m_figurines.push_back({motion.piece, motion.from, db::SQUARE_NONE, true, false, false, false});
+    for (const auto &motion : diff.added)
+        m_figurines.push_back({motion.piece, motion.to, db::SQUARE_NONE, false, false, false, false, true});
+
+    start_piece_move_animation(duration);
 }
 
 void BoardView::start_move_animation(const db::Move &move)
 {
     for (auto i_figurines = m_figurines.begin(); i_figurines != m_figurines.end();) {
         db::Square sq = i_figurines->pos;
+        // castling is the king taking its own rook, both go to their castled squares instead
+        if (move.is_castling) {
+            if (sq == move.from || sq == move.to) {
+                i_figurines->target = sq == move.from ? move.castling_king_to() : move.castling_rook_to();
+                i_figurines->animating = true;
+            }
+            ++i_figurines;
+            continue;
+        }
         if (sq == move.from) {
             i_figurines->target = move.to;
             i_figurines->animating = true;
@@ -918,24 +966,21 @@ void BoardView::start_move_animation(const db::Move &move)
             ++i_figurines;
         }
     }
-    m_is_animating = true;
-    m_piece_move_animation = new QPropertyAnimation(this, "piece_move_animation", this);
-    m_piece_move_animation->setStartValue(0.0);
-    m_piece_move_animation->setEndValue(1.0);
-    if (m_move_animation_queue.size() > 1 || m_fast_last_move) {
-        m_piece_move_animation->setDuration(100.0 / m_move_animation_queue.size());
-        if (!(m_move_animation_queue.size() > 1) && m_fast_last_move)
-            m_fast_last_move = false;
-    } else
-        m_piece_move_animation->setDuration(200.0);
-    m_piece_move_animation->setEasingCurve(QEasingCurve::InOutCubic);
-    m_piece_move_animation->start();
+    // moves are played faster while more are waiting behind them
+    start_piece_move_animation(m_move_animation_queue.empty() ? 200 : 100);
 }
 
 void BoardView::start_move_undo_animation(const db::Move &move)
 {
     for (auto &m_figurine : m_figurines) {
         db::Square sq = m_figurine.pos;
+        if (move.is_castling) {
+            if (sq == move.castling_king_to() || sq == move.castling_rook_to()) {
+                m_figurine.target = sq == move.castling_king_to() ? move.from : move.to;
+                m_figurine.animating = true;
+            }
+            continue;
+        }
         if (sq == move.to) {
             if (move.promoted != db::PIECE_NONE) {
                 m_figurine.piece = move.color == db::BLACK ? db::BLACK_PAWN : db::WHITE_PAWN;
@@ -949,61 +994,87 @@ void BoardView::start_move_undo_animation(const db::Move &move)
     else if (move.is_enpassant)
         m_figurines.push_back(
             Figurine(move.captured, move.color == db::BLACK ? db::Square(move.to + 8) : db::Square(move.to - 8)));
+    // moves are played faster while more are waiting behind them
+    start_piece_move_animation(m_move_animation_queue.empty() ? 200 : 100);
+}
+
+void BoardView::start_piece_move_animation(int duration)
+{
+    m_piece_move_animation->stop();
+    m_piece_move_animation_val = 0;
+    m_piece_move_animation->setDuration(duration);
     m_is_animating = true;
-    m_piece_move_animation = new QPropertyAnimation(this, "piece_move_animation", this);
-    m_piece_move_animation->setStartValue(0.0);
-    m_piece_move_animation->setEndValue(1.0);
-    if (m_move_animation_queue.size() > 1 || m_fast_last_move) {
-        m_piece_move_animation->setDuration(100.0 / m_move_animation_queue.size());
-        if (!(m_move_animation_queue.size() > 1) && m_fast_last_move)
-            m_fast_last_move = false;
-    } else
-        m_piece_move_animation->setDuration(200.0);
-    m_piece_move_animation->setEasingCurve(QEasingCurve::InOutCubic);
     m_piece_move_animation->start();
 }
 
+void BoardView::stop_piece_move_animation()
+{
+    m_piece_move_animation->stop();
+    m_is_animating = false;
+    m_piece_move_animation_val = 0;
+}
+
 void BoardView::queue_move_animation(const db::MoveId id, const db::Move &move, bool undo)
 {
     if (move == db::Move())
         return;
 
-    m_move_animation_queue.emplace_back(id, move, undo);
-    if (!m_is_animating && !std::get<bool>(m_move_animation_queue[0])) {
-        m_board.do_move(std::get<db::Move>(m_move_animation_queue[0]));
-        m_last_move = std::get<db::Move>(m_move_animation_queue[0]);
-        start_move_animation(std::get<db::Move>(m_move_animation_queue[0]));
-        emit current_move(std::get<db::MoveId>(m_move_animation_queue[0]));
-        m_move_animation_queue.erase(m_move_animation_queue.begin());
-    } else if (!m_is_animating) {
-        m_board.undo_move(std::get<db::Move>(m_move_animation_queue[0]));
-        emit get_prev_move();
-        start_move_undo_animation(std::get<db::Move>(m_move_animation_queue[0]));
-        emit current_move(std::get<db::MoveId>(m_move_animation_queue[0]));
-        m_move_animation_queue.erase(m_move_animation_queue.begin());
-    }
+    if (m_move_animation_queue.full())
+        coalesce_animation_queue();
+    m_move_animation_queue.push_back({id, move, undo});
+    if (!m_is_animating)
+        process_animation_queue();
+    else if (m_move_animation_queue.size() > s_coalesce_threshold)
+        coalesce_animation_queue();
 }
 
 void BoardView::process_animation_queue()
 {
-    if (m_move_animation_queue.size() == 0)
+    if (m_move_animation_queue.empty())
         return;
 
-    if (m_move_animation_queue.size() > 1) {
-        m_fast_last_move = true;
-    }
-    if (!std::get<bool>(m_move_animation_queue[0])) {
-        m_board.do_move(std::get<db::Move>(m_move_animation_queue[0]));
-        m_last_move = std::get<db::Move>(m_move_animation_queue[0]);
-        start_move_animation(std::get<db::Move>(m_move_animation_queue[0]));
-    } else {
-        m_board.undo_move(std::get<db::Move>(m_move_animation_queue[0]));
-        emit get_prev_move();
-        start_move_undo_animation(std::get<db::Move>(m_move_animation_queue[0]));
+    QueuedMove queued = m_move_animation_queue.front();
+    m_move_animation_queue.pop_front();
+    apply_queued_move(queued);
+    announce_queued_move(queued);
+    if (!queued.undo)
+        start_move_animation(queued.move);
+    else
+        start_move_undo_animation(queued.move);
+}
+
+void BoardView::coalesce_animation_queue()
+{
+    // the board already holds the result of the animation in flight, so that is where the new animation starts
+    stop_piece_move_animation();
+    recalculate_figurines();
+    db::Position start = m_board.get_position();
+    // the listeners only need to hear about the position the board ends up in
+    std::optional<QueuedMove> last;
+    while (!m_move_animation_queue.empty()) {
+        last = m_move_animation_queue.front();
+        m_move_animation_queue.pop_front();
+        apply_queued_move(*last);
     }
+    if (last)
+        announce_queued_move(*last);
+    start_animation(start, m_board.get_position(), 150);
+}
 
-    emit current_move(std::get<db::MoveId>(m_move_animation_queue[0]));
-    m_move_animation_queue.erase(m_move_animation_queue.begin());
+void BoardView::apply_queued_move(const QueuedMove &queued)
+{
+    if (!queued.undo) {
+        m_board.do_move(queued.move);
+        m_last_move = queued.move;
+    } else
+        m_board.undo_move(queued.move);
+}
+
+void BoardView::announce_queued_move(const QueuedMove &queued)
+{
+    if (queued.undo)
+        emit get_prev_move();
+    emit current_move(queued.id);
 }
 
 void BoardView::move_added(const db::MoveId id, const db::Move &move, bool animated)
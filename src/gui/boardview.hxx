@@ -6,7 +6,9 @@
 #include <vector>
 
 #include "bitboard.hxx"
+#include "book.hxx"
 #include "movenode.hxx"
+#include "ringbuffer.hxx"
 struct Figurine
 {
     db::Piece piece;
@@ -16,6 +18,7 @@ struct Figurine
     bool dragged;
     bool animating;
     bool ghost;
+    bool appear{false}; // fading in, the counterpart of fade
 };
 
 class BoardView : public QWidget
@@ -28,6 +31,8 @@ public:
     {
         if (m_board.get_fen() == fen.toStdString())
             return;
+        // the board already holds the result of any animation in flight and queued moves belong to the old position
+        m_move_animation_queue.clear();
         db::Position from = m_board.get_position();
         m_board.set_fen(fen.toStdString());
         start_animation(from, m_board.get_position());
@@ -40,6 +45,19 @@ public:
     void back_move(const db::MoveId id, const db::Move &move);
     void move_added(const db::MoveId id, const db::Move &move, bool animated = true);
     void set_prev_move(const db::Move &move) { m_last_move = move; }
+    // jumps to a position without animating, used when switching between games
+    void set_position(const db::Position &position, const db::Move &last_move);
+    // Polyglot book the Space key plays from before falling back to a random move, false if it cannot be opened.
+    // The Random64 table is read from random64.txt next to the book.
+    bool open_book(const QString &path)
+    {
+        m_book.set_keys(db::polyglot::default_keys(path.toStdString()));
+        return m_book.open(path.toStdString());
+    }
+    bool book_has_start_position() const { return m_book.has_start_position(); }
+    // why the position on the board is drawn by rule, empty while play goes on. Repetitions only count positions
+    // reached by moves since the board was last set.
+    QString draw_reason();
 
 private:
     float m_square_size;
@@ -109,16 +127,32 @@ private:
     void keyPressEvent(QKeyEvent *event) override;
 
     db::Move make_move(db::Square from, db::Square to, db::Piece promotion);
-    void start_animation(const db::Position &start, const db::Position &target);
+    void start_animation(const db::Position &start, const db::Position &target, int duration = 600);
     void start_move_animation(const db::Move &move);
     void start_move_undo_animation(const db::Move &move);
+    void start_piece_move_animation(int duration);
+    void stop_piece_move_animation();
 
+    struct QueuedMove
+    {
+        db::MoveId id;
+        db::Move move;
+        bool undo;
+    };
     void queue_move_animation(const db::MoveId id, const db::Move &move, bool undo = false);
     void process_animation_queue();
+    // plays every queued move at once as a single position animation, used when input outruns playback
+    void coalesce_animation_queue();
+    // plays a queued move on the board only, announce_queued_move tells the notation and the last move highlight
+    void apply_queued_move(const QueuedMove &queued);
+    void announce_queued_move(const QueuedMove &queued);
 
-    std::vector<std::tuple<db::MoveId, db::Move, bool>> m_move_animation_queue;
+    // moves waiting for the running animation, more than s_coalesce_threshold of them get coalesced
+    static constexpr size_t s_coalesce_threshold = 2;
+    RingBuffer<QueuedMove, 64> m_move_animation_queue;
 
     db::Board m_board;
+    db::polyglot::Book m_book;
 
 private:
     struct Arrow
@@ -137,8 +171,6 @@ private:
     QColor m_shape_yellow;
     Qt::KeyboardModifiers m_modifiers;
 
-    bool m_fast_last_move;
-
 signals:
     void move_made(const db::Move &move, bool animated = true);
     void fen_changed(const std::string &fen);
@@ -0,0 +1,40 @@
+#include "enginemanager.hxx"
+
+#include <algorithm>
+
+#include "uciengine.hxx"
+
+EngineManager::EngineManager(QObject *parent)
+    : QObject{parent}
+{}
+
+UciEngine *EngineManager::add_engine(const QString &path)
+{
+    auto *engine = new UciEngine(path, this);
+    m_engines.push_back(engine);
+    emit engine_added(engine);
+    if (!m_fen.isEmpty())
+        engine->analyse(m_fen);
+    engine->start();
+    return engine;
+}
+
+void EngineManager::remove_engine(UciEngine *engine)
+{
+    auto it = std::find(m_engines.begin(), m_engines.end(), engine);
+    if (it == m_engines.end())
+        return;
+    m_engines.erase(it);
+    emit engine_removed(engine);
+    engine->stop();
+    engine->deleteLater();
+}
+
+void EngineManager::set_fen(const QString &fen)
+{
+    if (fen == m_fen)
+        return;
+    m_fen = fen;
+    for (auto *engine : m_engines)
+        engine->analyse(fen);
+}
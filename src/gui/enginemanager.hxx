@@ -0,0 +1,27 @@
+#pragma once
+#include <QObject>
+#include <QString>
+#include <vector>
+
+class UciEngine;
+
+// Owns the external engines that run side by side and keeps all of them on the position shown on the board.
+class EngineManager : public QObject
+{
+    Q_OBJECT
+public:
+    explicit EngineManager(QObject *parent = nullptr);
+
+    UciEngine *add_engine(const QString &path);
+    void remove_engine(UciEngine *engine);
+    void set_fen(const QString &fen);
+    [[nodiscard]] const std::vector<UciEngine *> &engines() const { return m_engines; }
+
+signals:
+    void engine_added(UciEngine *engine);
+    void engine_removed(UciEngine *engine);
+
+private:
+    std::vector<UciEngine *> m_engines;
+    QString m_fen;
+};
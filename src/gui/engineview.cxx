@@ -0,0 +1,126 @@
+#include "engineview.hxx"
+
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QSpinBox>
+#include <QToolButton>
+#include <QVBoxLayout>
+#include <algorithm>
+#include <string>
+
+#include "enginemanager.hxx"
+#include "game.hxx"
+#include "uciengine.hxx"
+
+EngineView::EngineView(EngineManager &manager, QWidget *parent)
+    : QWidget{parent}
+    , m_manager(manager)
+{
+    m_layout = new QVBoxLayout(this);
+    m_layout->setContentsMargins(0, 0, 0, 0);
+    for (auto *engine : m_manager.engines())
+        add_panel(engine);
+    connect(&m_manager, &EngineManager::engine_added, this, &EngineView::add_panel);
+    connect(&m_manager, &EngineManager::engine_removed, this, &EngineView::remove_panel);
+}
+
+void EngineView::add_panel(UciEngine *engine)
+{
+    Panel panel;
+    panel.widget = new QWidget(this);
+    panel.header = new QLabel(engine->name(), panel.widget);
+    panel.lines = new QLabel(panel.widget);
+    panel.lines->setWordWrap(true);
+    panel.lines->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    auto *multipv = new QSpinBox(panel.widget);
+    multipv->setRange(1, UciEngine::s_max_multipv);
+    multipv->setValue(engine->multipv());
+    multipv->setPrefix(QStringLiteral("lines "));
+    auto *close = new QToolButton(panel.widget);
+    close->setText(QStringLiteral("x"));
+
+    auto *header_layout = new QHBoxLayout();
+    header_layout->addWidget(panel.header, 1);
+    header_layout->addWidget(multipv);
+    header_layout->addWidget(close);
+    auto *panel_layout = new QVBoxLayout(panel.widget);
+    panel_layout->setContentsMargins(0, 0, 0, 0);
+    panel_layout->addLayout(header_layout);
+    panel_layout->addWidget(panel.lines);
+    m_layout->addWidget(panel.widget);
+    m_panels.emplace(engine, panel);
+
+    connect(multipv, &QSpinBox::valueChanged, engine, &UciEngine::set_multipv);
+    connect(close, &QToolButton::clicked, this, [this, engine]() { m_manager.remove_engine(engine); });
+    connect(engine, &UciEngine::updated, this, [this, engine]() { refresh(engine); });
+    connect(engine, &UciEngine::ready, this, [this, engine]() { refresh(engine); });
+    connect(engine, &UciEngine::error, this, [this, engine](const QString &message) {
+        auto panel = m_panels.find(engine);
+        if (panel != m_panels.end())
+            panel->second.lines->setText(message);
+    });
+}
+
+void EngineView::remove_panel(UciEngine *engine)
+{
+    auto panel = m_panels.find(engine);
+    if (panel == m_panels.end())
+        return;
+    panel->second.widget->deleteLater();
+    m_panels.erase(panel);
+}
+
+void EngineView::refresh(UciEngine *engine)
+{
+    auto panel = m_panels.find(engine);
+    if (panel == m_panels.end())
+        return;
+    if (engine->fen().isEmpty() || !m_board.set_fen(engine->fen().toStdString())) {
+        panel->second.header->setText(engine->name());
+        return;
+    }
+    const db::Position root = m_board.get_position();
+    const int sign = root.stm == db::WHITE ? 1 : -1;
+
+    QString text;
+    const auto &lines = engine->lines();
+    int depth = 0;
+    uint64_t nps = 0;
+    for (int i = 0; i < engine->multipv(); ++i) {
+        const UciEngine::Line &line = lines[i];
+        if (line.depth == 0)
+            continue;
+        depth = std::max(depth, line.depth);
+        nps = std::max(nps, line.nps);
+
+        QString score = line.is_mate ? QStringLiteral("#%1").arg(sign * line.score)
+                                     : QStringLiteral("%1%2")
+                                           .arg(sign * line.score >= 0 ? "+" : "")
+                                           .arg(sign * line.score / 100.0, 0, 'f', 2);
+        std::string san;
+        std::string_view pv = line.pv;
+        for (int ply = 0; ply < s_max_pv_plies; ++ply) {
+            std::string_view token = engine::uci::next_token(pv);
+            if (token.empty())
+                break;
+            db::Move move = engine::uci::move_from_uci(m_board, token);
+            if (!move.is_legal)
+                break;
+            db::Move printed = move;
+            m_board.prepare_for_print(printed);
+            if (!san.empty())
+                san += ' ';
+            san += db::Game::move_number_text(printed, ply == 0);
+            san += printed.to_san();
+            m_board.do_move(move);
+        }
+        // the line was played on the scratch board, back to the root for the next one
+        m_board.set_position(root);
+        if (!text.isEmpty())
+            text += '\n';
+        text += QStringLiteral("%1  %2").arg(score, QString::fromStdString(san));
+    }
+    panel->second.header->setText(
+        QStringLiteral("%1   depth %2   %3 kN/s").arg(engine->name()).arg(depth).arg(nps / 1000));
+    panel->second.lines->setText(text);
+}
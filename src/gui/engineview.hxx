@@ -0,0 +1,39 @@
+#pragma once
+#include <QWidget>
+#include <unordered_map>
+
+#include "bitboard.hxx"
+
+class QLabel;
+class QVBoxLayout;
+class EngineManager;
+class UciEngine;
+
+// One panel per running engine with its MultiPV lines in SAN. Panels are refreshed on the engine's throttled
+// updated signal only.
+class EngineView : public QWidget
+{
+    Q_OBJECT
+public:
+    // number of plies of every line that are converted to SAN and shown
+    static constexpr int s_max_pv_plies = 12;
+
+    explicit EngineView(EngineManager &manager, QWidget *parent = nullptr);
+
+private:
+    struct Panel
+    {
+        QWidget *widget;
+        QLabel *header;
+        QLabel *lines;
+    };
+
+    void add_panel(UciEngine *engine);
+    void remove_panel(UciEngine *engine);
+    void refresh(UciEngine *engine);
+
+    EngineManager &m_manager;
+    QVBoxLayout *m_layout;
+    std::unordered_map<UciEngine *, Panel> m_panels;
+    db::Board m_board; // scratch board to turn engine lines into SAN
+};
@@ -0,0 +1,129 @@
+#include "frameprofiler.hxx"
+
+#include <QStringList>
+#include <QTextStream>
+#include <QtGlobal>
+#include <algorithm>
+
+static const std::array<const char *, FrameProfiler::PHASE_COUNT> s_phase_names = {
+    "draw_board", "draw_effects", "draw_coordinates", "draw_pieces",
+    "draw_shapes", "draw_promotion", "notation_layout", "notation_paint",
+};
+
+FrameProfiler::FrameProfiler()
+    : m_enabled(false)
+    , m_frame_number(0)
+    , m_history_count(0)
+{
+    if (qEnvironmentVariableIsSet("CHESSGUI_PROFILE"))
+        set_enabled(true);
+}
+
+FrameProfiler &FrameProfiler::instance()
+{
+    static FrameProfiler s_profiler;
+    return s_profiler;
+}
+
+void FrameProfiler::set_enabled(bool enabled)
+{
+    if (enabled == m_enabled)
+        return;
+    m_enabled = enabled;
+    m_current = {};
+    m_history_count = 0;
+    if (!enabled) {
+        m_trace.close();
+        return;
+    }
+    QString path = qEnvironmentVariable("CHESSGUI_PROFILE");
+    if (path.isEmpty() || path == QStringLiteral("1"))
+        path = QStringLiteral("frame_trace.csv");
+    m_trace.setFileName(path);
+    if (m_trace.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+        write_csv_header();
+    m_frame_number = 0;
+    m_session_timer.start();
+}
+
+void FrameProfiler::begin_frame()
+{
+    if (!m_enabled)
+        return;
+    m_frame_timer.start();
+}
+
+void FrameProfiler::end_frame(uint64_t is_piece_attack_calls, uint64_t generate_moves_calls)
+{
+    if (!m_enabled)
+        return;
+    m_current.total_ns = m_frame_timer.nsecsElapsed();
+    m_current.is_piece_attack_calls = is_piece_attack_calls;
+    m_current.generate_moves_calls = generate_moves_calls;
+    m_history[m_frame_number % s_history_size] = m_current;
+    m_history_count = std::min(m_history_count + 1, s_history_size);
+    if (m_trace.isOpen())
+        write_csv_row(m_current);
+    ++m_frame_number;
+    // notation timings recorded between two board frames are attributed to the following frame
+    m_current = {};
+}
+
+void FrameProfiler::draw_hud(QPainter &painter, QPointF pos) const
+{
+    if (!m_enabled || m_history_count == 0)
+        return;
+    const Frame &last = m_history[(m_frame_number - 1) % s_history_size];
+    Frame average;
+    qint64 worst_ns = 0;
+    for (size_t i = 0; i < m_history_count; ++i) {
+        for (int phase = 0; phase < PHASE_COUNT; ++phase)
+            average.phase_ns[phase] += m_history[i].phase_ns[phase];
+        average.total_ns += m_history[i].total_ns;
+        worst_ns = std::max(worst_ns, m_history[i].total_ns);
+    }
+
+    auto ms = [](qint64 ns) { return QString::number(ns / 1e6, 'f', 2); };
+    QStringList lines;
+    lines << QStringLiteral("frame %1   %2 ms  (avg %3, worst %4)")
+                 .arg(m_frame_number)
+                 .arg(ms(last.total_ns), ms(average.total_ns / qint64(m_history_count)), ms(worst_ns));
+    for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+        lines << QStringLiteral("%1  %2 ms  (avg %3)")
+                     .arg(QString::fromLatin1(s_phase_names[phase]), -17)
+                     .arg(ms(last.phase_ns[phase]), ms(average.phase_ns[phase] / qint64(m_history_count)));
+    }
+    lines << QStringLiteral("is_piece_attack   %1 calls").arg(last.is_piece_attack_calls);
+    lines << QStringLiteral("generate_moves    %1 calls").arg(last.generate_moves_calls);
+
+    painter.save();
+    QFont font(QStringLiteral("monospace"));
+    font.setStyleHint(QFont::Monospace);
+    font.setPixelSize(11);
+    painter.setFont(font);
+    const int line_height = painter.fontMetrics().height();
+    QRectF background(pos, QSizeF(300, line_height * lines.size() + 8));
+    painter.fillRect(background, QColor(0, 0, 0, 170));
+    painter.setPen(QColor(230, 230, 230));
+    for (int i = 0; i < lines.size(); ++i)
+        painter.drawText(pos + QPointF(6, 4 + line_height * (i + 1) - painter.fontMetrics().descent()), lines[i]);
+    painter.restore();
+}
+
+void FrameProfiler::write_csv_header()
+{
+    QTextStream out(&m_trace);
+    out << "frame,time_ms,total_us";
+    for (const char *name : s_phase_names)
+        out << ',' << name << "_us";
+    out << ",is_piece_attack_calls,generate_moves_calls\n";
+}
+
+void FrameProfiler::write_csv_row(const Frame &frame)
+{
+    QTextStream out(&m_trace);
+    out << m_frame_number << ',' << m_session_timer.elapsed() << ',' << frame.total_ns / 1000;
+    for (qint64 ns : frame.phase_ns)
+        out << ',' << ns / 1000;
+    out << ',' << frame.is_piece_attack_calls << ',' << frame.generate_moves_calls << '\n';
+}
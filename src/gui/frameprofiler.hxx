@@ -0,0 +1,87 @@
+#pragma once
+#include <QElapsedTimer>
+#include <QFile>
+#include <QPainter>
+#include <array>
+#include <cstdint>
+
+// Optional per-frame instrumentation for BoardView and NotationView. Disabled by default, toggled with F12 (View menu)
+// or by starting with CHESSGUI_PROFILE set. When enabled it draws a HUD on the board and appends one CSV row per
+// board frame to the file named by CHESSGUI_PROFILE (frame_trace.csv if the variable is empty or unset).
+class FrameProfiler
+{
+public:
+    enum Phase
+    {
+        DRAW_BOARD,
+        DRAW_EFFECTS,
+        DRAW_COORDINATES,
+        DRAW_PIECES,
+        DRAW_SHAPES,
+        DRAW_PROMOTION,
+        NOTATION_LAYOUT,
+        NOTATION_PAINT,
+        PHASE_COUNT
+    };
+
+    struct Frame
+    {
+        std::array<qint64, PHASE_COUNT> phase_ns{};
+        qint64 total_ns{0};
+        uint64_t is_piece_attack_calls{0};
+        uint64_t generate_moves_calls{0};
+    };
+
+    // times the enclosing block and adds it to the current frame
+    class Scope
+    {
+    public:
+        explicit Scope(Phase phase)
+            : m_phase(phase)
+            , m_active(instance().enabled())
+        {
+            if (m_active)
+                m_timer.start();
+        }
+        ~Scope()
+        {
+            if (m_active)
+                instance().record(m_phase, m_timer.nsecsElapsed());
+        }
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        Phase m_phase;
+        bool m_active;
+        QElapsedTimer m_timer;
+    };
+
+    static FrameProfiler &instance();
+
+    [[nodiscard]] bool enabled() const { return m_enabled; }
+    void set_enabled(bool enabled);
+
+    void begin_frame();
+    void record(Phase phase, qint64 nsecs) { m_current.phase_ns[phase] += nsecs; }
+    void end_frame(uint64_t is_piece_attack_calls, uint64_t generate_moves_calls);
+
+    void draw_hud(QPainter &painter, QPointF pos) const;
+
+private:
+    FrameProfiler();
+
+    void write_csv_header();
+    void write_csv_row(const Frame &frame);
+
+    static constexpr size_t s_history_size = 120;
+
+    bool m_enabled;
+    uint64_t m_frame_number;
+    QElapsedTimer m_frame_timer;
+    QElapsedTimer m_session_timer;
+    Frame m_current;
+    std::array<Frame, s_history_size> m_history;
+    size_t m_history_count;
+    QFile m_trace;
+};
@@ -0,0 +1,137 @@
+#include "gametextview.hxx"
+
+#include <QTextCursor>
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace {
+// Game::text counts bytes of UTF-8, QTextDocument positions count UTF-16 units. Moves utf8 from byte to end and
+// returns the UTF-16 units passed: every byte but continuation bytes starts a character, four byte sequences take a
+// surrogate pair.
+size_t advance_utf16(const std::string &utf8, size_t &byte, size_t end)
+{
+    size_t units = 0;
+    for (; byte < end; ++byte) {
+        const auto c = uint8_t(utf8[byte]);
+        if ((c & 0xc0) != 0x80)
+            units += c >= 0xf0 ? 2 : 1;
+    }
+    return units;
+}
+} // namespace
+
+GameTextView::GameTextView(const db::Game &game, QWidget *parent)
+    : QTextEdit{parent}
+    , m_game(game)
+    , m_current_move_id(0)
+{
+    setReadOnly(true);
+    m_current_move_format.setFontWeight(QFont::Bold);
+    m_current_move_format.setBackground(QColor(198, 221, 243));
+    m_move_format.setFontWeight(QFont::Normal);
+    m_move_format.setBackground(Qt::transparent);
+    // the editor deletes a document of its own when another one is set, this one has to survive being swapped out
+    setDocument(new_document());
+    rebuild();
+}
+
+QTextDocument *GameTextView::new_document()
+{
+    auto *document = new QTextDocument(this);
+    document->setUndoRedoEnabled(false);
+    document->setDefaultFont(font());
+    return document;
+}
+
+void GameTextView::swap_text(Text &text)
+{
+    QTextDocument *shown = document();
+    setDocument(text.document ? text.document : new_document());
+    text.document = shown;
+    std::swap(m_spans, text.spans);
+    std::swap(m_current_move_id, text.current_move_id);
+}
+
+void GameTextView::drop_text(Text &text)
+{
+    delete text.document;
+    text.document = nullptr;
+}
+
+void GameTextView::rebuild()
+{
+    std::vector<db::Game::TextSpan> spans;
+    const std::string text = m_game.text(spans);
+    setPlainText(QString::fromStdString(text));
+    m_spans.clear();
+    m_spans.reserve(spans.size());
+    // one pass over the text converts the spans to document positions
+    std::sort(spans.begin(), spans.end(), [](const auto &lhs, const auto &rhs) { return lhs.begin < rhs.begin; });
+    size_t byte = 0, position = 0;
+    for (const auto &span : spans) {
+        position += advance_utf16(text, byte, span.begin);
+        const size_t length = advance_utf16(text, byte, span.begin + span.length);
+        m_spans.emplace(span.move_id, db::Game::TextSpan{span.move_id, position, length});
+        position += length;
+    }
+    m_current_move_id = 0;
+    set_current_move(m_game.current_move());
+}
+
+void GameTextView::move_added(const db::MoveId id)
+{
+    if (m_spans.find(id) != m_spans.end()) {
+        // the move already existed and the game only navigated to it
+        set_current_move(id);
+        return;
+    }
+    const auto &moves = m_game.get_moves();
+    const db::MoveNode &last = moves.back();
+    const db::MoveNode &previous = moves[moves.size() - 2];
+    if (last.move_id != id || last.variation_level != 0 || previous.variation_level != 0) {
+        rebuild();
+        return;
+    }
+
+    std::string fragment = previous.move_id == 0 ? std::string() : std::string(" ");
+    fragment += db::Game::move_number_text(last.move, false);
+    std::string san = last.move.to_san();
+
+    QTextCursor cursor(document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(QString::fromStdString(fragment), m_move_format);
+    const QString san_text = QString::fromStdString(san);
+    m_spans.emplace(id, db::Game::TextSpan{id, size_t(cursor.position()), size_t(san_text.size())});
+    cursor.insertText(san_text, m_move_format);
+    set_current_move(id);
+}
+
+void GameTextView::set_current_move(const db::MoveId id)
+{
+    if (id == m_current_move_id)
+        return;
+    apply_format(m_current_move_id, m_move_format);
+    apply_format(id, m_current_move_format);
+    m_current_move_id = id;
+
+    auto span = m_spans.find(id);
+    if (span == m_spans.end())
+        return;
+    QTextCursor cursor(document());
+    cursor.setPosition(int(span->second.begin));
+    setTextCursor(cursor);
+    ensureCursorVisible();
+}
+
+void GameTextView::apply_format(const db::MoveId id, const QTextCharFormat &format)
+{
+    auto span = m_spans.find(id);
+    if (span == m_spans.end())
+        return;
+    QTextCursor cursor(document());
+    cursor.setPosition(int(span->second.begin));
+    cursor.setPosition(int(span->second.begin + span->second.length), QTextCursor::KeepAnchor);
+    cursor.setCharFormat(format);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <QTextCharFormat>
+#include <QTextDocument>
+#include <QTextEdit>
+#include <unordered_map>
+
+#include "game.hxx"
+
+// Read only movetext of a game. The text is built once when a game is loaded and then kept up to date in place:
+// navigating restyles only the previous and the new current move, and moves appended to the end of the mainline are
+// inserted as a fragment. Anything else (new variations) falls back to a rebuild. The documents of suspended games
+// are kept and swapped back in with their game.
+class GameTextView : public QTextEdit
+{
+    Q_OBJECT
+public:
+    explicit GameTextView(const db::Game &game, QWidget *parent = nullptr);
+
+    // the movetext of a game while another one is shown. A Text without a document belongs to a new, empty game.
+    // Documents are owned by the view, drop_text frees the one of a closed game.
+    struct Text
+    {
+        QTextDocument *document{nullptr};
+        std::unordered_map<db::MoveId, db::Game::TextSpan> spans;
+        db::MoveId current_move_id{0};
+    };
+    // exchanges the displayed text with the given one, call it together with NotationView::swap_game
+    void swap_text(Text &text);
+    void drop_text(Text &text);
+
+    void rebuild();
+    void move_added(const db::MoveId id);
+    void set_current_move(const db::MoveId id);
+
+private:
+    [[nodiscard]] QTextDocument *new_document();
+    void apply_format(const db::MoveId id, const QTextCharFormat &format);
+
+    const db::Game &m_game;
+    // in document positions (UTF-16 units), not the byte offsets Game::text returns
+    std::unordered_map<db::MoveId, db::Game::TextSpan> m_spans;
+    db::MoveId m_current_move_id;
+
+    QTextCharFormat m_move_format;
+    QTextCharFormat m_current_move_format;
+};
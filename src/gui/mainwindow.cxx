@@ -1,12 +1,17 @@
 #include "mainwindow.hxx"
 
 #include <QHBoxLayout>
+#include <QFileDialog>
 #include <QLabel>
 #include <QLineEdit>
+#include <QMenu>
+#include <QMenuBar>
 #include <QPushButton>
 #include <QScrollArea>
 #include <QSplitter>
+#include <QStatusBar>
 #include <QString>
+#include <QTabBar>
 #include <QTextEdit>
 #include <QVBoxLayout>
 #include <qboxlayout.h>
@@ -16,22 +21,38 @@
 #include <string>
 
 #include "./ui_mainwindow.h"
+#include "analysisview.hxx"
 #include "boardview.hxx"
+#include "enginemanager.hxx"
+#include "engineview.hxx"
+#include "frameprofiler.hxx"
+#include "gametextview.hxx"
 #include "notationview.hxx"
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
+    , m_active_game(-1)
+    , m_games_created(0)
 {
+    auto *workspace = new QWidget(this);
+    auto *workspace_layout = new QVBoxLayout(workspace);
+    m_tabs = new QTabBar(this);
     auto *parent_layout = new QSplitter(this);
     auto *board = new QWidget(this);
     auto *vlayout = new QVBoxLayout(this);
-    auto *boardview = new BoardView(this);
-    auto *notationview = new NotationView(this);
+    m_boardview = new BoardView(this);
+    m_notationview = new NotationView(this);
+    auto *boardview = m_boardview;
+    auto *notationview = m_notationview;
     auto *notation_scroll = new QScrollArea(this);
     auto *notation_vlayout = new QVBoxLayout(this);
     auto *fen_edit = new QLineEdit(this);
-    auto *game_text = new QTextEdit(this);
+    m_game_text = new GameTextView(notationview->game(), this);
+    auto *game_text = m_game_text;
+    auto *analysis = new AnalysisView(this);
+    m_engines = new EngineManager(this);
+    auto *engine_view = new EngineView(*m_engines, this);
     notation_scroll->setWidget(notationview);
     notation_scroll->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
     notation_scroll->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
@@ -39,6 +60,8 @@ MainWindow::MainWindow(QWidget *parent)
     notation_scroll->setMinimumWidth(250);
     notation_vlayout->addWidget(notation_scroll);
     notation_vlayout->addWidget(game_text);
+    notation_vlayout->addWidget(analysis);
+    notation_vlayout->addWidget(engine_view);
     auto *notation = new QWidget();
     notation->setLayout(notation_vlayout);
     ui->setupUi(this);
@@ -49,7 +72,53 @@ MainWindow::MainWindow(QWidget *parent)
     parent_layout->addWidget(board);
     parent_layout->setContentsMargins(0, 0, 0, 0);
     parent_layout->addWidget(notation);
-    setCentralWidget(parent_layout);
+    m_tabs->setTabsClosable(true);
+    m_tabs->setExpanding(false);
+    m_tabs->setDocumentMode(true);
+    workspace_layout->setContentsMargins(0, 0, 0, 0);
+    workspace_layout->setSpacing(0);
+    workspace_layout->addWidget(m_tabs);
+    workspace_layout->addWidget(parent_layout);
+    setCentralWidget(workspace);
+
+    QMenu *game_menu = menuBar()->addMenu(QStringLiteral("&Game"));
+    QAction *new_action = game_menu->addAction(QStringLiteral("&New board"), this, &MainWindow::new_game);
+    new_action->setShortcut(QKeySequence::AddTab);
+    QAction *close_action =
+        game_menu->addAction(QStringLiteral("&Close board"), this, [this]() { close_game(m_tabs->currentIndex()); });
+    close_action->setShortcut(QKeySequence::Close);
+    game_menu->addAction(QStringLiteral("Opening &book..."), this, [this, boardview]() {
+        QString path = QFileDialog::getOpenFileName(this, QStringLiteral("Open Polyglot book"), QString(),
+                                                    QStringLiteral("Polyglot books (*.bin);;All files (*)"));
+        if (path.isEmpty())
+            return;
+        if (!boardview->open_book(path))
+            statusBar()->showMessage(QStringLiteral("%1 is not a Polyglot book").arg(path), 5000);
+        else if (!boardview->book_has_start_position())
+            statusBar()->showMessage(
+                QStringLiteral("%1 does not hold the start position, it may need the Random64 table in %2 next to it")
+                    .arg(path, QString::fromLatin1(db::polyglot::KEYS_FILE)),
+                5000);
+    });
+    QMenu *view_menu = menuBar()->addMenu(QStringLiteral("&View"));
+    // a window wide shortcut works whichever view has the focus, both views repaint so the HUD shows or hides at once
+    QAction *profiler_action = view_menu->addAction(QStringLiteral("Frame &profiler"), this, [=]() {
+        FrameProfiler::instance().set_enabled(!FrameProfiler::instance().enabled());
+        boardview->update();
+        notationview->update();
+    });
+    profiler_action->setShortcut(QKeySequence(Qt::Key_F12));
+    QMenu *engine_menu = menuBar()->addMenu(QStringLiteral("&Engines"));
+    engine_menu->addAction(QStringLiteral("&Add engine..."), this, [this]() {
+        QString path = QFileDialog::getOpenFileName(this, QStringLiteral("Add UCI engine"));
+        if (!path.isEmpty())
+            m_engines->add_engine(path);
+    });
+    engine_menu->addAction(QStringLiteral("&Tablebases..."), this, [this, analysis]() {
+        QString directory = QFileDialog::getExistingDirectory(this, QStringLiteral("Tablebase directory"));
+        if (!directory.isEmpty())
+            analysis->set_tablebase_directory(directory);
+    });
 
     connect(fen_edit, &QLineEdit::editingFinished, boardview, [=]() { boardview->set_fen(fen_edit->text()); });
     connect(boardview, &BoardView::fen_changed, fen_edit,
@@ -63,12 +132,71 @@ MainWindow::MainWindow(QWidget *parent)
     connect(boardview, &BoardView::current_move, notationview, &NotationView::set_current_move);
     connect(boardview, &BoardView::get_prev_move, notationview, &NotationView::get_prev_move);
     connect(notationview, &NotationView::prev_move, boardview, &BoardView::set_prev_move);
-    connect(notationview, &NotationView::text_changed, game_text,
-            [=](const std::string &text) { game_text->setText(QString::fromStdString(text)); });
-    boardview->set_fen(QStringLiteral("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR/ w KQkq - 0 1"));
+    connect(notationview, &NotationView::game_changed, boardview, &BoardView::set_position);
+    connect(notationview, &NotationView::move_added, game_text, &GameTextView::move_added);
+    connect(boardview, &BoardView::current_move, game_text, &GameTextView::set_current_move);
+    connect(boardview, &BoardView::fen_changed, analysis,
+            [=](const std::string &fen) { analysis->set_fen(QString::fromStdString(fen)); });
+    connect(boardview, &BoardView::current_move, analysis, [=]() { analysis->set_fen(boardview->get_fen()); });
+    connect(boardview, &BoardView::fen_changed, m_engines,
+            [this](const std::string &fen) { m_engines->set_fen(QString::fromStdString(fen)); });
+    connect(boardview, &BoardView::current_move, m_engines, [=]() { m_engines->set_fen(boardview->get_fen()); });
+    connect(boardview, &BoardView::current_move, this, [=]() {
+        const QString reason = boardview->draw_reason();
+        if (!reason.isEmpty())
+            statusBar()->showMessage(QStringLiteral("Draw by %1").arg(reason), 5000);
+    });
+    connect(m_tabs, &QTabBar::currentChanged, this, &MainWindow::switch_game);
+    connect(m_tabs, &QTabBar::tabCloseRequested, this, &MainWindow::close_game);
+    boardview->set_fen(QStringLiteral("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"));
+
+    // the views start out with an empty game which becomes the first tab
+    m_games.emplace_back();
+    m_active_game = 0;
+    m_tabs->addTab(QStringLiteral("Game %1").arg(++m_games_created));
 }
 
 MainWindow::~MainWindow()
 {
     delete ui;
 }
+
+void MainWindow::new_game()
+{
+    m_games.emplace_back();
+    m_tabs->addTab(QStringLiteral("Game %1").arg(++m_games_created));
+    m_tabs->setCurrentIndex(m_tabs->count() - 1);
+}
+
+void MainWindow::switch_game(int index)
+{
+    if (index < 0 || index == m_active_game)
+        return;
+    // park the active game in its slot and take the requested one, both are plain swaps of the game tree, its
+    // layout and its document
+    if (m_active_game >= 0) {
+        m_notationview->swap_game(m_games[m_active_game].notation);
+        m_game_text->swap_text(m_games[m_active_game].text);
+    }
+    m_notationview->swap_game(m_games[index].notation);
+    m_game_text->swap_text(m_games[index].text);
+    m_active_game = index;
+    m_boardview->setFocus();
+}
+
+void MainWindow::close_game(int index)
+{
+    if (index < 0 || m_tabs->count() == 1)
+        return;
+    if (index == m_active_game) {
+        // hand the game back to its slot so the views pick up a neighbour on the following currentChanged
+        m_notationview->swap_game(m_games[m_active_game].notation);
+        m_game_text->swap_text(m_games[m_active_game].text);
+        m_active_game = -1;
+    } else if (index < m_active_game) {
+        --m_active_game;
+    }
+    m_game_text->drop_text(m_games[index].text);
+    m_games.erase(m_games.begin() + index);
+    m_tabs->removeTab(index);
+}
@@ -1,14 +1,21 @@
 #pragma once
 #include <QMainWindow>
+#include <vector>
 
 #include "game.hxx"
+#include "gametextview.hxx"
 #include "move.hxx"
+#include "notationview.hxx"
 QT_BEGIN_NAMESPACE
 namespace Ui {
 class MainWindow;
 }
 QT_END_NAMESPACE
 
+class QTabBar;
+class BoardView;
+class EngineManager;
+
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -18,5 +25,27 @@ public:
     ~MainWindow();
 
 private:
+    void new_game();
+    void switch_game(int index);
+    void close_game(int index);
+
     Ui::MainWindow *ui;
+
+    QTabBar *m_tabs;
+    BoardView *m_boardview;
+    NotationView *m_notationview;
+    GameTextView *m_game_text;
+    EngineManager *m_engines;
+
+    // Only the active game is loaded into the views. Every other tab is suspended with its game tree, the layout of
+    // its notation and its movetext document, so switching tabs swaps them back in without laying anything out. The
+    // slot of the active game holds whatever the views handed back on the last swap.
+    struct SuspendedGame
+    {
+        NotationView::Document notation;
+        GameTextView::Text text;
+    };
+    std::vector<SuspendedGame> m_games;
+    int m_active_game;
+    int m_games_created;
 };
@@ -1,9 +1,14 @@
 #include "notationview.hxx"
 
 #include <QFontDatabase>
+#include <QPaintEvent>
 #include <QPainter>
+#include <algorithm>
 #include <cstdint>
 #include <qnamespace.h>
+#include <utility>
+
+#include "frameprofiler.hxx"
 NotationView::NotationView(QWidget *parent)
     : QWidget{parent}
     , m_move_height(30)
@@ -12,6 +17,14 @@ NotationView::NotationView(QWidget *parent)
 {
     int success = QFontDatabase::addApplicationFont(QStringLiteral(":/fonts/NotoChess.ttf"));
     QFontDatabase::applicationFontFamilies(0);
+    m_number_font = QFont(QStringLiteral("Noto Chess"));
+    m_number_font.setPointSize(12);
+    m_san_font = m_number_font;
+    m_san_bold_font = m_san_font;
+    m_san_bold_font.setBold(true);
+    m_move_id_font = m_number_font;
+    m_move_id_font.setPointSize(7);
+    m_move_id_font.setItalic(true);
     setFocusPolicy(Qt::StrongFocus);
 
     QPalette pal = QPalette();
@@ -24,7 +37,6 @@ void NotationView::back()
 {
     db::Move move = m_game.back();
     emit back_move(m_game.current_move(), move);
-    emit text_changed(m_game.text());
     // set_current_move(m_game.current_move());
     update();
 }
@@ -33,7 +45,6 @@ void NotationView::forward()
 {
     db::Move move = m_game.forward();
     emit forward_move(m_game.current_move(), move);
-    emit text_changed(m_game.text());
     // set_current_move(m_game.current_move());
     update();
 }
@@ -41,7 +52,7 @@ void NotationView::forward()
 void NotationView::add_move(const db::Move &move, bool animated)
 {
     m_game.add_move(move);
-    emit text_changed(m_game.text());
+    add_movebox(m_game.current_node());
     if (height() < move.full_move * 30)
         setMinimumSize(QSize(width(), move.full_move * 30));
     if (!animated)
@@ -57,72 +68,124 @@ void NotationView::set_current_move(const db::MoveId id)
     update();
 }
 
-void NotationView::recalculate_moveboxes()
+void NotationView::swap_game(Document &document)
+{
+    std::swap(m_game, document.game);
+    std::swap(m_move_boxes, document.move_boxes);
+    m_current_move_id = m_game.current_move();
+    int full_moves = m_game.get_moves().back().move.full_move;
+    setMinimumSize(QSize(width(), full_moves * m_move_height));
+    emit game_changed(m_game.get_position(), m_game.current_node().move);
+    update();
+}
+
+void NotationView::add_movebox(const db::MoveNode &node)
+{
+    // mainline moves can only be appended to the end of the mainline, anything else is a variation or a move that
+    // already has a box, e.g. a mainline move replayed after stepping back. The boxes stay in mainline order, which
+    // paintEvent relies on.
+    if (node.variation_level > 0 || node.move_id == 0)
+        return;
+    if (!m_move_boxes.empty() &&
+        m_game.find_move(node.move_id) <= m_game.find_move(m_move_boxes.back().node.move_id))
+        return;
+    m_move_boxes.push_back(make_movebox(node));
+}
+
+NotationView::MoveBox NotationView::make_movebox(const db::MoveNode &node) const
 {
-    m_move_boxes.clear();
-    auto move_nodes = m_game.get_moves();
-    m_move_boxes.reserve(move_nodes.size());
     const int move_box_width = 100;
-    const int move_box_height = m_move_height;
     const int move_number_width = 40;
-    for (auto &move_node : move_nodes) {
-        if (move_node.variation_level > 0)
-            continue;
-        MoveBox move_box;
-        QPointF pos(move_node.move.color == db::BLACK ? move_box_width + move_number_width : move_number_width,
-                    (move_node.move.full_move - 1) * move_box_height);
-        move_box.node = move_node;
-        move_box.hitbox = QRectF(pos, QSizeF(move_box_width, m_move_height));
-        m_move_boxes.push_back(move_box);
+    MoveBox move_box;
+    QPointF pos(node.move.color == db::BLACK ? move_box_width + move_number_width : move_number_width,
+                (node.move.full_move - 1) * m_move_height);
+    move_box.node = node;
+    move_box.hitbox = QRectF(pos, QSizeF(move_box_width, m_move_height));
+
+    QString san = QString::fromStdString(node.move.to_san());
+    move_box.san.setText(san);
+    move_box.san.setTextFormat(Qt::PlainText);
+    move_box.san.prepare(QTransform(), m_san_font);
+    move_box.san_bold.setText(san);
+    move_box.san_bold.setTextFormat(Qt::PlainText);
+    move_box.san_bold.prepare(QTransform(), m_san_bold_font);
+    move_box.move_id.setText(QString::number(node.move_id).left(3));
+    move_box.move_id.setTextFormat(Qt::PlainText);
+    move_box.move_id.prepare(QTransform(), m_move_id_font);
+    if (node.move.color == db::WHITE) {
+        move_box.move_number.setText(QString::number(node.move.full_move));
+        move_box.move_number.setTextFormat(Qt::PlainText);
+        move_box.move_number.prepare(QTransform(), m_number_font);
     }
+    return move_box;
 }
 
 void NotationView::paintEvent(QPaintEvent *event)
 {
     QPainter painter(this);
-    painter.setPen(QColor(77, 77, 77));
     painter.setBrush(QColor(247, 246, 245));
-    QFont font(QStringLiteral("Noto Chess"));
-    font.setPointSize(12);
-    painter.setFont(font);
-
-    recalculate_moveboxes();
-    for (MoveBox move_box : m_move_boxes) {
-        if (move_box.node.move.color == db::WHITE) {
-            painter.setPen(Qt::transparent);
-            painter.drawRect(
-                QRectF(QPointF(0, (move_box.node.move.full_move - 1) * m_move_height), QSizeF(40, m_move_height)));
-            painter.setPen(QColor(179, 179, 179));
-            painter.drawText(
-                QRectF(QPointF(0, (move_box.node.move.full_move - 1) * m_move_height), QSizeF(40, m_move_height)),
-                Qt::AlignCenter, QString::number(move_box.node.move.full_move));
-            painter.setPen(QColor(77, 77, 77));
-        }
-        if (move_box.node.move_id == m_current_move_id) {
-            painter.fillRect(move_box.hitbox, QColor(198, 221, 243));
-            font.setBold(true);
-            painter.setFont(font);
-            painter.setPen(QColor(31, 31, 31));
 
-        } else {
+    // the layout is kept up to date by add_move, painting only has to find the rows inside the exposed rectangle
+    auto first = m_move_boxes.cend();
+    auto last = m_move_boxes.cend();
+    {
+        FrameProfiler::Scope scope(FrameProfiler::NOTATION_LAYOUT);
+        const QRect exposed = event->rect();
+        first = std::partition_point(m_move_boxes.cbegin(), m_move_boxes.cend(), [&](const MoveBox &move_box) {
+            return move_box.hitbox.bottom() < exposed.top();
+        });
+        last = std::partition_point(first, m_move_boxes.cend(), [&](const MoveBox &move_box) {
+            return move_box.hitbox.top() <= exposed.bottom();
+        });
+    }
+    FrameProfiler::Scope scope(FrameProfiler::NOTATION_PAINT);
+    // draw in passes so that fonts and pens only change a handful of times per paint instead of per box
+    painter.setFont(m_number_font);
+    for (auto it = first; it != last; ++it) {
+        const MoveBox &move_box = *it;
+        if (move_box.node.move_id == m_current_move_id)
+            painter.fillRect(move_box.hitbox, QColor(198, 221, 243));
+        else
             painter.fillRect(move_box.hitbox, Qt::white);
-        }
-        painter.drawText(move_box.hitbox.translated(10, 0), Qt::AlignLeft | Qt::AlignVCenter,
-                         QString::fromStdString(move_box.node.move.to_san()));
-
-        font.setPointSize(7);
-        font.setItalic(true);
-        font.setBold(false);
-        painter.setFont(font);
-        painter.setPen(Qt::red);
-        painter.drawText(move_box.hitbox.translated(10, 0), Qt::AlignLeft | Qt::AlignBottom,
-                         QString::number(move_box.node.move_id).left(3));
-
-        font.setBold(false);
-        font.setItalic(false);
-        font.setPointSize(12);
-        painter.setFont(font);
-        painter.setPen(QColor(77, 77, 77));
+        if (move_box.node.move.color != db::WHITE)
+            continue;
+        QRectF number_rect(QPointF(0, move_box.hitbox.top()), QSizeF(40, m_move_height));
+        painter.setPen(Qt::transparent);
+        painter.drawRect(number_rect);
+        painter.setPen(QColor(179, 179, 179));
+        QSizeF size = move_box.move_number.size();
+        painter.drawStaticText(number_rect.center() - QPointF(size.width() / 2, size.height() / 2),
+                               move_box.move_number);
+    }
+
+    painter.setFont(m_san_font);
+    painter.setPen(QColor(77, 77, 77));
+    for (auto it = first; it != last; ++it) {
+        const MoveBox &move_box = *it;
+        if (move_box.node.move_id == m_current_move_id)
+            continue;
+        QPointF pos(move_box.hitbox.left() + 10,
+                    move_box.hitbox.center().y() - move_box.san.size().height() / 2);
+        painter.drawStaticText(pos, move_box.san);
+    }
+    for (auto it = first; it != last; ++it) {
+        const MoveBox &move_box = *it;
+        if (move_box.node.move_id != m_current_move_id)
+            continue;
+        painter.setFont(m_san_bold_font);
+        painter.setPen(QColor(31, 31, 31));
+        QPointF pos(move_box.hitbox.left() + 10,
+                    move_box.hitbox.center().y() - move_box.san_bold.size().height() / 2);
+        painter.drawStaticText(pos, move_box.san_bold);
+        break;
+    }
+
+    painter.setFont(m_move_id_font);
+    painter.setPen(Qt::red);
+    for (auto it = first; it != last; ++it) {
+        const MoveBox &move_box = *it;
+        QPointF pos(move_box.hitbox.left() + 10, move_box.hitbox.bottom() - move_box.move_id.size().height());
+        painter.drawStaticText(pos, move_box.move_id);
     }
 }
 
@@ -1,25 +1,43 @@
 #pragma once
+#include <QFont>
 #include <QKeyEvent>
+#include <QStaticText>
 #include <QWidget>
 
 #include "game.hxx"
 class NotationView : public QWidget
 {
+    // text layouts are prepared once per node when the box is created and reused by every paint
     struct MoveBox
     {
         db::MoveNode node;
         QRectF hitbox;
+        QStaticText san;
+        QStaticText san_bold; // used while the move is the current one
+        QStaticText move_id;
+        QStaticText move_number; // only set for white moves, which start a row
     };
 
     Q_OBJECT
 public:
     explicit NotationView(QWidget *parent = nullptr);
 
+    // a game with the layout of its moves, what the workspace keeps of a game while another one is shown
+    struct Document
+    {
+        db::Game game;
+        std::vector<MoveBox> move_boxes;
+    };
+
     void forward();
     void back();
 
     void add_move(const db::Move &move, bool animated = true);
     void set_current_move(const db::MoveId id);
+    // exchanges the displayed game and its layout with the given ones, used to suspend and resume games in the
+    // workspace. Both are swapped as they are, nothing is laid out again.
+    void swap_game(Document &document);
+    [[nodiscard]] const db::Game &game() const { return m_game; }
     void get_prev_move()
     {
         size_t index = m_game.find_move(m_current_move_id);
@@ -27,7 +45,7 @@ public:
             emit prev_move(db::Move());
             return;
         }
-        auto moves = m_game.get_moves();
+        const auto &moves = m_game.get_moves();
         if (moves[index - 1].variation_id == moves[index].variation_id) {
             emit prev_move(moves[index - 1].move);
             return;
@@ -42,7 +60,9 @@ public:
     }
 
 private:
-    void recalculate_moveboxes();
+    // lays out a single mainline node, called whenever a move is added
+    void add_movebox(const db::MoveNode &node);
+    [[nodiscard]] MoveBox make_movebox(const db::MoveNode &node) const;
 
     void paintEvent(QPaintEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
@@ -51,6 +71,10 @@ private:
     db::Game m_game;
 
     int m_move_height;
+    QFont m_number_font;
+    QFont m_san_font;
+    QFont m_san_bold_font;
+    QFont m_move_id_font;
     db::MoveId m_current_move_id;
     size_t m_current_move_index;
     std::vector<MoveBox> m_move_boxes;
@@ -59,5 +83,5 @@ signals:
     void back_move(const db::MoveId id, const db::Move &move);
     void move_added(const db::MoveId id, const db::Move &move, bool animated = true);
     void prev_move(const db::Move &move);
-    void text_changed(const std::string text);
+    void game_changed(const db::Position &position, const db::Move &last_move);
 };
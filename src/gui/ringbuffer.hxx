@@ -0,0 +1,43 @@
+#pragma once
+#include <array>
+#include <cassert>
+#include <cstddef>
+
+// Fixed capacity FIFO that never allocates. push_back fails instead of growing when the buffer is full.
+template <typename T, size_t Capacity>
+class RingBuffer
+{
+public:
+    bool push_back(const T &value)
+    {
+        if (full())
+            return false;
+        m_items[(m_head + m_size) % Capacity] = value;
+        ++m_size;
+        return true;
+    }
+    void pop_front()
+    {
+        assert(!empty());
+        m_head = (m_head + 1) % Capacity;
+        --m_size;
+    }
+    [[nodiscard]] const T &front() const
+    {
+        assert(!empty());
+        return m_items[m_head];
+    }
+    void clear()
+    {
+        m_head = 0;
+        m_size = 0;
+    }
+    [[nodiscard]] size_t size() const { return m_size; }
+    [[nodiscard]] bool empty() const { return m_size == 0; }
+    [[nodiscard]] bool full() const { return m_size == Capacity; }
+
+private:
+    std::array<T, Capacity> m_items{};
+    size_t m_head{0};
+    size_t m_size{0};
+};
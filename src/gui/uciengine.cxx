@@ -0,0 +1,194 @@
+#include "uciengine.hxx"
+
+#include <QFileInfo>
+#include <algorithm>
+
+UciEngine::UciEngine(const QString &path, QObject *parent)
+    : QObject{parent}
+    , m_path(path)
+    , m_name(QFileInfo(path).fileName())
+    , m_state(State::NOT_STARTED)
+    , m_dirty(false)
+    , m_search_pending(false)
+    , m_multipv(1)
+    , m_engine_multipv(1)
+    , m_lines(s_max_multipv)
+{
+    m_update_timer.setInterval(s_update_interval_ms);
+    connect(&m_update_timer, &QTimer::timeout, this, &UciEngine::flush_updates);
+    connect(&m_process, &QProcess::readyReadStandardOutput, this, &UciEngine::read_output);
+    connect(&m_process, &QProcess::started, this, [this]() {
+        m_state = State::WAITING_UCIOK;
+        send("uci");
+    });
+    connect(&m_process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError) {
+        m_update_timer.stop();
+        emit error(m_process.errorString());
+    });
+}
+
+UciEngine::~UciEngine()
+{
+    if (m_process.state() == QProcess::NotRunning)
+        return;
+    // engines get a moment to quit on their own, the process is killed if it does not
+    send("quit");
+    m_process.closeWriteChannel();
+    if (!m_process.waitForFinished(200))
+        m_process.kill();
+}
+
+void UciEngine::start()
+{
+    m_process.setReadChannel(QProcess::StandardOutput);
+    m_process.start(m_path, QStringList());
+}
+
+void UciEngine::analyse(const QString &fen)
+{
+    m_fen = fen;
+    m_search_pending = true;
+    if (m_state == State::SEARCHING) {
+        // UCI forbids new commands during a search, the new one is started once the bestmove arrives
+        send("stop");
+        m_state = State::STOPPING;
+    } else if (m_state == State::IDLE) {
+        start_pending_search();
+    }
+}
+
+void UciEngine::stop()
+{
+    m_search_pending = false;
+    if (m_state == State::SEARCHING) {
+        send("stop");
+        m_state = State::STOPPING;
+    }
+    m_update_timer.stop();
+}
+
+void UciEngine::set_multipv(int multipv)
+{
+    multipv = std::clamp(multipv, 1, s_max_multipv);
+    if (multipv == m_multipv)
+        return;
+    m_multipv = multipv;
+    // restart the search so that the new setting takes effect
+    if (m_state == State::SEARCHING || m_state == State::STOPPING)
+        analyse(m_fen);
+}
+
+void UciEngine::set_option(const QString &name, const QString &value)
+{
+    m_pending_options.emplace_back(name, value);
+    if (m_state == State::SEARCHING || m_state == State::STOPPING)
+        analyse(m_fen);
+    else if (m_state == State::IDLE && m_search_pending)
+        start_pending_search();
+}
+
+bool UciEngine::has_option(const QString &name) const
+{
+    return std::any_of(m_option_names.begin(), m_option_names.end(),
+                       [&](const QString &option) { return option.compare(name, Qt::CaseInsensitive) == 0; });
+}
+
+void UciEngine::read_output()
+{
+    // everything available is handled in one go, partial lines wait in the buffer for the next chunk
+    m_buffer.append(m_process.readAllStandardOutput());
+    qsizetype begin = 0;
+    for (qsizetype end = m_buffer.indexOf('\n'); end >= 0; end = m_buffer.indexOf('\n', begin)) {
+        handle_line(std::string_view(m_buffer.constData() + begin, size_t(end - begin)));
+        begin = end + 1;
+    }
+    m_buffer.remove(0, begin);
+}
+
+void UciEngine::handle_line(std::string_view line)
+{
+    std::string_view rest = line;
+    std::string_view command = engine::uci::next_token(rest);
+    if (command == "info") {
+        // infos still in the pipe from a stopped search belong to the previous position
+        if (m_state != State::SEARCHING)
+            return;
+        engine::uci::Info info;
+        if (!engine::uci::parse_info(line, info) || info.multipv < 1 || info.multipv > m_multipv)
+            return;
+        Line &target = m_lines[info.multipv - 1];
+        target.depth = info.depth;
+        target.seldepth = info.seldepth;
+        target.score = info.score;
+        target.is_mate = info.is_mate;
+        target.is_bound = info.lowerbound || info.upperbound;
+        target.nodes = info.nodes;
+        target.nps = info.nps;
+        target.pv.assign(info.pv);
+        m_dirty = true;
+    } else if (command == "bestmove") {
+        if (m_state == State::SEARCHING || m_state == State::STOPPING) {
+            m_state = State::IDLE;
+            flush_updates();
+            start_pending_search();
+        }
+    } else if (command == "id") {
+        if (engine::uci::next_token(rest) == "name") {
+            size_t begin = rest.find_first_not_of(' ');
+            if (begin != std::string_view::npos)
+                m_name = QString::fromUtf8(rest.data() + begin, qsizetype(rest.size() - begin)).trimmed();
+        }
+    } else if (command == "option") {
+        engine::uci::Option option;
+        if (engine::uci::parse_option(line, option))
+            m_option_names.push_back(QString::fromUtf8(option.name.data(), qsizetype(option.name.size())));
+    } else if (command == "uciok") {
+        if (m_state == State::WAITING_UCIOK) {
+            m_state = State::WAITING_READYOK;
+            send("isready");
+        }
+    } else if (command == "readyok") {
+        if (m_state == State::WAITING_READYOK) {
+            m_state = State::IDLE;
+            emit ready();
+            start_pending_search();
+        }
+    }
+}
+
+void UciEngine::start_pending_search()
+{
+    if (m_state != State::IDLE || !m_search_pending)
+        return;
+    m_search_pending = false;
+    for (const auto &[name, value] : m_pending_options) {
+        if (has_option(name))
+            send(QStringLiteral("setoption name %1 value %2").arg(name, value).toUtf8());
+    }
+    m_pending_options.clear();
+    if (m_multipv != m_engine_multipv && has_option(QStringLiteral("MultiPV"))) {
+        send(QStringLiteral("setoption name MultiPV value %1").arg(m_multipv).toUtf8());
+        m_engine_multipv = m_multipv;
+    }
+    for (auto &line : m_lines)
+        line.depth = 0;
+    send("position fen " + m_fen.toUtf8());
+    send("go infinite");
+    m_state = State::SEARCHING;
+    m_dirty = true;
+    m_update_timer.start();
+}
+
+void UciEngine::send(const QByteArray &command)
+{
+    m_process.write(command);
+    m_process.write("\n");
+}
+
+void UciEngine::flush_updates()
+{
+    if (!m_dirty)
+        return;
+    m_dirty = false;
+    emit updated();
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <QByteArray>
+#include <QObject>
+#include <QProcess>
+#include <QString>
+#include <QTimer>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "uci.hxx"
+
+// A local UCI executable running as a child process. Output is consumed in whole chunks as it arrives and only the
+// latest info of every MultiPV line is kept; the GUI is told about changes by a timer, so an engine printing
+// thousands of lines per second costs one repaint per interval rather than one per line.
+class UciEngine : public QObject
+{
+    Q_OBJECT
+public:
+    // latest state of one MultiPV line, pv is reused between updates so steady state parsing does not allocate
+    struct Line
+    {
+        int depth{0};
+        int seldepth{0};
+        int score{0}; // from the engine's side to move
+        bool is_mate{false};
+        bool is_bound{false};
+        uint64_t nodes{0};
+        uint64_t nps{0};
+        std::string pv;
+    };
+
+    static constexpr int s_update_interval_ms = 100;
+    static constexpr int s_max_multipv = 8;
+
+    explicit UciEngine(const QString &path, QObject *parent = nullptr);
+    ~UciEngine() override;
+
+    void start();
+    // analyses fen with go infinite, a running search is stopped first
+    void analyse(const QString &fen);
+    void stop();
+    void set_multipv(int multipv);
+    void set_option(const QString &name, const QString &value);
+
+    [[nodiscard]] const QString &name() const { return m_name; }
+    [[nodiscard]] const QString &path() const { return m_path; }
+    [[nodiscard]] const QString &fen() const { return m_fen; }
+    [[nodiscard]] int multipv() const { return m_multipv; }
+    [[nodiscard]] bool is_ready() const { return m_state == State::IDLE || m_state == State::SEARCHING; }
+    [[nodiscard]] bool has_option(const QString &name) const;
+    // valid lines, the first multipv() of them
+    [[nodiscard]] const std::vector<Line> &lines() const { return m_lines; }
+
+signals:
+    void ready();
+    void updated();
+    void error(const QString &message);
+
+private:
+    enum class State
+    {
+        NOT_STARTED,
+        WAITING_UCIOK,
+        WAITING_READYOK,
+        IDLE,
+        SEARCHING,
+        STOPPING, // stop was sent and the bestmove has not arrived yet
+    };
+
+    void read_output();
+    void handle_line(std::string_view line);
+    void start_pending_search();
+    void send(const QByteArray &command);
+    void flush_updates();
+
+    QString m_path;
+    QString m_name;
+    QProcess m_process;
+    QByteArray m_buffer;
+    QTimer m_update_timer;
+    State m_state;
+    bool m_dirty;
+
+    std::vector<QString> m_option_names;
+    std::vector<std::pair<QString, QString>> m_pending_options;
+
+    QString m_fen;
+    bool m_search_pending;
+    int m_multipv;
+    int m_engine_multipv;
+    std::vector<Line> m_lines;
+};